@@ -0,0 +1,60 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_AFFINITY_H
+#define __MLN_AFFINITY_H
+
+#include "mln_types.h"
+#include "mln_string.h"
+
+/*
+ * CPU and NUMA node placement of threads and processes.
+ * Only Linux is supported now, mln_affinity_bind() returns -1
+ * with errno set to ENOSYS on other systems.
+ */
+#define M_AFFINITY_CPU_MAX  1024
+#define M_AFFINITY_NODE_MAX 64
+#define M_AFFINITY_NO_NODE  -1
+
+typedef struct {
+    mln_u64_t                bits[M_AFFINITY_CPU_MAX / 64];
+    int                      node;/*M_AFFINITY_NO_NODE if not bound to a NUMA node*/
+} mln_affinity_t;
+
+#define mln_affinity_cpu_set(aff,cpu)   ((aff)->bits[(cpu) >> 6] |= ((mln_u64_t)1 << ((cpu) & 63)))
+#define mln_affinity_cpu_isset(aff,cpu) (!!((aff)->bits[(cpu) >> 6] & ((mln_u64_t)1 << ((cpu) & 63))))
+
+extern int mln_affinity_cpu_num(void);
+extern void mln_affinity_zero(mln_affinity_t *aff) __NONNULL1(1);
+/*
+ * mln_affinity_parse():
+ * s is a CPU list like "0-3,8,10-11", or a NUMA node like "node1".
+ * return value: 0 - succeed   -1 - invalid s or no such NUMA node
+ */
+extern int mln_affinity_parse(mln_affinity_t *aff, mln_string_t *s) __NONNULL2(1,2);
+/*
+ * mln_affinity_bind():
+ * Pin the calling thread to the CPUs in aff. If aff is bound to a NUMA
+ * node, memory of the calling thread is preferred to be allocated from
+ * that node. Threads and processes created by the calling thread
+ * inherit both of them.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_affinity_bind(mln_affinity_t *aff) __NONNULL1(1);
+/*
+ * mln_affinity_conf_load():
+ * Load the command cmd_name in domain 'main', whose arguments are
+ *     on             - the i-th one is pinned to CPU i % number of CPUs
+ *     off            - no affinity
+ *     integers       - CPU numbers
+ *     strings        - CPU lists or NUMA nodes, see mln_affinity_parse()
+ * *affs is NULL and *n is 0 if the command is missing or off,
+ * otherwise *affs should be freed by free().
+ * return value: 0 - succeed   -1 - invalid configuration or no memory
+ */
+extern int mln_affinity_conf_load(char *cmd_name, mln_affinity_t **affs, mln_u32_t *n) __NONNULL3(1,2,3);
+
+#endif
+
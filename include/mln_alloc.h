@@ -23,6 +23,8 @@ typedef int (*mln_alloc_shm_lock_cb_t)(void *);
 #define M_ALLOC_MGR_GRAIN_SIZE   2
 #define M_ALLOC_MGR_LEN          18*M_ALLOC_MGR_GRAIN_SIZE-(M_ALLOC_MGR_GRAIN_SIZE-1)
 #define M_ALLOC_BLK_NUM          4
+#define M_ALLOC_BLK_NUM_MAX      256
+#define M_ALLOC_CHUNK_GROW_SIZE  64*1024
 #define M_ALLOC_CHUNK_COUNT      1023
 
 #define M_ALLOC_SHM_BITMAP_LEN   4096
@@ -33,6 +35,7 @@ typedef int (*mln_alloc_shm_lock_cb_t)(void *);
 typedef struct mln_alloc_s       mln_alloc_t;
 typedef struct mln_alloc_mgr_s   mln_alloc_mgr_t;
 typedef struct mln_alloc_chunk_s mln_alloc_chunk_t;
+typedef struct mln_alloc_prof_s  mln_alloc_prof_t;
 
 struct mln_alloc_shm_attr_s {
     mln_size_t                size;
@@ -54,9 +57,11 @@ typedef struct mln_alloc_blk_s {
     void                     *data;
     mln_alloc_chunk_t        *chunk;
     mln_size_t                blk_size;
+    void                     *caller;
     mln_size_t                is_large:1;
     mln_size_t                in_used:1;
-    mln_size_t                padding:30;
+    mln_size_t                is_aligned:1;
+    mln_size_t                padding:29;
     struct mln_alloc_blk_s   *prev;
     struct mln_alloc_blk_s   *next;
 } mln_alloc_blk_t __cacheline_aligned;
@@ -67,11 +72,13 @@ struct mln_alloc_chunk_s {
     mln_size_t                refer;
     mln_size_t                count;
     mln_alloc_mgr_t          *mgr;
-    mln_alloc_blk_t          *blks[M_ALLOC_BLK_NUM+1];
-};
+    mln_size_t                blk_num;
+    mln_size_t                idle_epoch;
+} __cacheline_aligned;
 
 struct mln_alloc_mgr_s {
     mln_size_t                blk_size;
+    mln_size_t                blk_num;
     mln_alloc_blk_t          *free_head;
     mln_alloc_blk_t          *free_tail;
     mln_alloc_blk_t          *used_head;
@@ -92,6 +99,31 @@ typedef struct mln_alloc_shm_s {
     struct mln_alloc_shm_s   *next;
 } mln_alloc_shm_t;
 
+/*
+ * Profiling counters, one slot per size class.
+ * The last slot (M_ALLOC_MGR_LEN) accounts for large blocks.
+ */
+typedef struct {
+    mln_size_t                blk_size;
+    mln_u64_t                 nalloc;
+    mln_u64_t                 nfree;
+    mln_size_t                live_blks;
+    mln_size_t                live_bytes;
+    mln_size_t                peak_bytes;
+    mln_u64_t                 nchunk_alloc;
+    mln_u64_t                 nchunk_free;
+} mln_alloc_prof_class_t;
+
+struct mln_alloc_prof_s {
+    mln_u32_t                 sample;
+    mln_u32_t                 counter;
+    mln_size_t                live_bytes;
+    mln_size_t                peak_bytes;
+    mln_alloc_prof_class_t    classes[M_ALLOC_MGR_LEN+1];
+};
+
+typedef int (*mln_alloc_prof_scan_cb_t)(void *ptr, mln_size_t blk_size, void *caller, void *data);
+
 struct mln_alloc_s {
     mln_alloc_mgr_t           mgr_tbl[M_ALLOC_MGR_LEN];
     struct mln_alloc_s       *parent;
@@ -104,6 +136,8 @@ struct mln_alloc_s {
     void                     *locker;
     mln_alloc_shm_lock_cb_t   lock;
     mln_alloc_shm_lock_cb_t   unlock;
+    mln_alloc_prof_t         *prof;
+    mln_size_t                trim_epoch;
 #if defined(WIN32)
     HANDLE                    map_handle;
 #endif
@@ -111,6 +145,8 @@ struct mln_alloc_s {
 
 
 #define mln_alloc_is_shm(pool) (pool->mem != NULL)
+#define mln_alloc_chunk_first_blk(ch) \
+    ((mln_alloc_blk_t *)((mln_u8ptr_t)(ch) + sizeof(mln_alloc_chunk_t)))
 
 extern mln_alloc_t *mln_alloc_shm_init(struct mln_alloc_shm_attr_s *attr);
 extern mln_alloc_t *mln_alloc_init(mln_alloc_t *parent);
@@ -118,7 +154,20 @@ extern void mln_alloc_destroy(mln_alloc_t *pool);
 extern void *mln_alloc_m(mln_alloc_t *pool, mln_size_t size);
 extern void *mln_alloc_c(mln_alloc_t *pool, mln_size_t size);
 extern void *mln_alloc_re(mln_alloc_t *pool, void *ptr, mln_size_t size);
+extern void *mln_alloc_aligned(mln_alloc_t *pool, mln_size_t size, mln_size_t align);
 extern void mln_alloc_free(void *ptr);
+/*
+ * mln_alloc_free_sized():
+ * size must be the size given to mln_alloc_m() or mln_alloc_c() which returned ptr,
+ * memory from mln_alloc_re() should be freed by mln_alloc_free().
+ */
+extern void mln_alloc_free_sized(mln_alloc_t *pool, void *ptr, mln_size_t size);
+extern mln_size_t mln_alloc_trim(mln_alloc_t *pool, mln_size_t decay);
+extern int mln_alloc_prof_enable(mln_alloc_t *pool, mln_u32_t sample);
+extern void mln_alloc_prof_disable(mln_alloc_t *pool);
+extern const mln_alloc_prof_t *mln_alloc_prof_stat(mln_alloc_t *pool);
+extern int mln_alloc_prof_scan(mln_alloc_t *pool, mln_alloc_prof_scan_cb_t cb, void *data);
+extern void mln_alloc_prof_dump(mln_alloc_t *pool, FILE *fp);
 
 #endif
 
@@ -0,0 +1,143 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_BTREE_H
+#define __MLN_BTREE_H
+
+#include "mln_types.h"
+
+/*
+ * B+tree.
+ * All elements are stored in leaves, leaves are linked in order.
+ * Each inner node keeps the minimum element and the number of
+ * elements of every child, so it supports rank and select too.
+ */
+#define M_BTREE_NODE_SIZE 32
+#define M_BTREE_NODE_MIN  (M_BTREE_NODE_SIZE >> 1)
+#define M_BTREE_LOAD_FILL (M_BTREE_NODE_SIZE - (M_BTREE_NODE_SIZE >> 2))
+#define M_BTREE_MAX_DEPTH 32
+
+/*
+ * >0 -- the first argument greater than the second.
+ * ==0 -- equal.
+ * <0 -- less.
+ */
+typedef int (*btree_cmp)(const void *, const void *);
+typedef void (*btree_free_data)(void *);
+typedef int (*btree_act)(void * /*data*/, void *);
+typedef void *(*btree_pool_alloc_handler)(void *, mln_size_t);
+typedef void (*btree_pool_free_handler)(void *);
+
+struct mln_btree_attr {
+    void                      *pool;
+    btree_pool_alloc_handler   pool_alloc;
+    btree_pool_free_handler    pool_free;
+    btree_cmp                  cmp;
+    btree_free_data            data_free;
+};
+
+typedef struct mln_btree_node_s {
+    mln_u32_t                  nr;
+    mln_u32_t                  leaf;
+    void                      *keys[M_BTREE_NODE_SIZE];
+} mln_btree_node_t;
+
+typedef struct {
+    mln_btree_node_t           node;
+    mln_btree_node_t          *prev;
+    mln_btree_node_t          *next;
+} mln_btree_leaf_t;
+
+typedef struct {
+    mln_btree_node_t           node;
+    mln_btree_node_t          *children[M_BTREE_NODE_SIZE];
+    mln_uauto_t                counts[M_BTREE_NODE_SIZE];
+} mln_btree_inner_t;
+
+typedef struct {
+    mln_btree_node_t          *leaf;
+    mln_u32_t                  index;
+} mln_btree_iter_t;
+
+typedef struct mln_btree_s {
+    void                      *pool;
+    btree_pool_alloc_handler   pool_alloc;
+    btree_pool_free_handler    pool_free;
+    btree_cmp                  cmp;
+    btree_free_data            data_free;
+    mln_btree_node_t          *root;
+    mln_btree_node_t          *head;
+    mln_btree_node_t          *tail;
+    mln_uauto_t                nr_node;
+} mln_btree_t;
+
+#define mln_btree_nr_node(t) ((t)->nr_node)
+
+extern mln_btree_t *
+mln_btree_init(struct mln_btree_attr *attr) __NONNULL1(1);
+extern void
+mln_btree_destroy(mln_btree_t *t);
+extern void
+mln_btree_reset(mln_btree_t *t) __NONNULL1(1);
+/*
+ * Elements equal to existent ones are inserted after them.
+ * data must not be NULL.
+ */
+extern int
+mln_btree_insert(mln_btree_t *t, void *data) __NONNULL2(1,2);
+/*
+ * mln_btree_remove():
+ * Remove an element equal to key and return it, it will not be freed.
+ */
+extern void *
+mln_btree_remove(mln_btree_t *t, const void *key) __NONNULL2(1,2);
+extern void *
+mln_btree_search(mln_btree_t *t, const void *key) __NONNULL2(1,2);
+/*
+ * mln_btree_load():
+ * Build the tree from the sorted array data in O(n), t must be empty.
+ */
+extern int
+mln_btree_load(mln_btree_t *t, void **data, mln_uauto_t n) __NONNULL2(1,2);
+/*
+ * Iterator functions return the element iter points to,
+ * or NULL if iter goes out of the tree.
+ */
+extern void *
+mln_btree_first(mln_btree_t *t, mln_btree_iter_t *iter) __NONNULL2(1,2);
+extern void *
+mln_btree_last(mln_btree_t *t, mln_btree_iter_t *iter) __NONNULL2(1,2);
+extern void *
+mln_btree_lower_bound(mln_btree_t *t, const void *key, mln_btree_iter_t *iter) __NONNULL3(1,2,3);
+extern void *
+mln_btree_upper_bound(mln_btree_t *t, const void *key, mln_btree_iter_t *iter) __NONNULL3(1,2,3);
+extern void *
+mln_btree_next(mln_btree_iter_t *iter) __NONNULL1(1);
+extern void *
+mln_btree_prev(mln_btree_iter_t *iter) __NONNULL1(1);
+/*
+ * mln_btree_select():
+ * Get the element at position k (from 0).
+ */
+extern void *
+mln_btree_select(mln_btree_t *t, mln_uauto_t k, mln_btree_iter_t *iter) __NONNULL1(1);
+/*
+ * mln_btree_rank():
+ * Return the number of elements less than key.
+ */
+extern mln_uauto_t
+mln_btree_rank(mln_btree_t *t, const void *key) __NONNULL2(1,2);
+/*
+ * mln_btree_range_scan():
+ * Call act on elements in [low, high) in order, NULL means unbounded.
+ * Return -1 if act returns a negative value, otherwise 0.
+ */
+extern int
+mln_btree_range_scan(mln_btree_t *t, const void *low, const void *high, btree_act act, void *udata) __NONNULL2(1,4);
+extern int
+mln_btree_scan_all(mln_btree_t *t, btree_act act, void *udata) __NONNULL2(1,2);
+
+#endif
+
@@ -0,0 +1,129 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_CHASH_H
+#define __MLN_CHASH_H
+
+#ifdef MLN_USE_UNIX98
+  #ifndef __USE_UNIX98
+  #define __USE_UNIX98
+  #endif
+#endif
+#include <pthread.h>
+#include "mln_types.h"
+#include "mln_hash.h"
+
+/*
+ * Concurrent hash table.
+ * Keys are spread over M_CHASH_DFL_SHARDS (or attr->nr_shards) shards,
+ * each shard is a progressive mln_hash_t protected by its own
+ * read-write lock, so threads working on different shards
+ * never wait for each other.
+ */
+#define M_CHASH_DFL_SHARDS 64
+#define M_CHASH_MAX_SHARDS 65536
+
+typedef struct mln_chash_s mln_chash_t;
+
+/*
+ * compute_handler:
+ * old_val is NULL if key not existent.
+ * The returned value will be set as the new value of key,
+ * and NULL means removing key from the table.
+ */
+typedef void *(*chash_compute_handler)(void * /*key*/, void * /*old_val*/, void *);
+
+struct mln_chash_attr {
+    hash_calc_handler        hash;
+    hash_cmp_handler         cmp;
+    hash_free_handler        free_key;
+    hash_free_handler        free_val;
+    mln_u64_t                len_base;
+    mln_u32_t                nr_shards;
+    mln_u32_t                cache:1;
+    mln_u32_t                key_type:2;
+    mln_u32_t                nocase:1;
+};
+
+/*
+ * Each shard takes whole cachelines, so that the locks of neighbouring
+ * shards are never in the same cacheline.
+ */
+#define M_CHASH_SHARD_SIZE \
+    ((sizeof(pthread_rwlock_t) + sizeof(mln_hash_t *) + M_CACHELINE_SIZE - 1) & ~(M_CACHELINE_SIZE - 1))
+
+typedef union {
+    struct {
+        pthread_rwlock_t     lock;
+        mln_hash_t          *tbl;
+    };
+    char                     pad[M_CHASH_SHARD_SIZE];
+#ifdef __GNUC__
+} mln_chash_shard_t __attribute__((__aligned__(M_CACHELINE_SIZE)));
+#else
+} mln_chash_shard_t;
+#endif
+
+struct mln_chash_s {
+    hash_calc_handler        hash;
+    mln_chash_shard_t       *shards;
+    mln_u32_t                mask;
+    mln_u32_t                key_type:2;
+    mln_u32_t                nocase:1;
+};
+
+extern mln_chash_t *
+mln_chash_init(struct mln_chash_attr *attr) __NONNULL1(1);
+extern void
+mln_chash_destroy(mln_chash_t *ch, mln_hash_flag_t flg) __NONNULL1(1);
+/*
+ * mln_chash_search():
+ * The returned value may be removed and freed by other threads at any time,
+ * use mln_chash_read() if value's lifetime is not managed by the caller.
+ */
+extern void *
+mln_chash_search(mln_chash_t *ch, void *key) __NONNULL2(1,2);
+/*
+ * mln_chash_read():
+ * handler is called with key's shard read locked.
+ * Return -1 if key not existent, otherwise handler's return value.
+ */
+extern int
+mln_chash_read(mln_chash_t *ch, void *key, hash_scan_handler handler, void *udata) __NONNULL3(1,2,3);
+extern int
+mln_chash_insert(mln_chash_t *ch, void *key, void *val) __NONNULL2(1,2);
+/*
+ * mln_chash_replace():
+ * key and val are second rank pointers like mln_hash_replace's.
+ */
+extern int
+mln_chash_replace(mln_chash_t *ch, void *key, void *val) __NONNULL3(1,2,3);
+extern void
+mln_chash_remove(mln_chash_t *ch, void *key, mln_hash_flag_t flg) __NONNULL2(1,2);
+/*
+ * mln_chash_get_or_insert():
+ * Return the existent value of key, or insert key and val and return val.
+ * If the returned value is not val, key and val are not stored.
+ * NULL returned on failure.
+ */
+extern void *
+mln_chash_get_or_insert(mln_chash_t *ch, void *key, void *val) __NONNULL3(1,2,3);
+extern int
+mln_chash_compute(mln_chash_t *ch, void *key, chash_compute_handler handler, void *udata) __NONNULL3(1,2,3);
+extern int
+mln_chash_key_exist(mln_chash_t *ch, void *key) __NONNULL2(1,2);
+/*
+ * mln_chash_scan_all():
+ * Shards are read locked one by one, so the handler can not modify the table.
+ */
+extern int
+mln_chash_scan_all(mln_chash_t *ch, hash_scan_handler handler, void *udata) __NONNULL2(1,2);
+extern mln_u64_t
+mln_chash_nr_nodes(mln_chash_t *ch) __NONNULL1(1);
+extern void
+mln_chash_reset(mln_chash_t *ch, mln_hash_flag_t flg) __NONNULL1(1);
+
+#endif
+
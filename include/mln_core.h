@@ -6,6 +6,15 @@
 #define __MLN_CORE_H
 
 #include "mln_event.h"
+#include "mln_ipc.h"
+#if !defined(WIN32)
+#include <sys/socket.h>
+#endif
+
+#define M_CORE_INHERIT_ENV   "MELON_INHERIT_FDS"
+#define M_CORE_UPGRADE_ENV   "MELON_UPGRADE_PID"
+#define M_CORE_LISTEN_MAX    64
+#define M_CORE_TIMER_MS      100 /*checks if all child processes exited while quitting*/
 
 typedef int (*mln_core_init_t)(void);
 #if !defined(WIN32)
@@ -23,4 +32,18 @@ struct mln_core_attr {
 };
 
 extern int mln_core_init(struct mln_core_attr *attr) __NONNULL1(1);
+#if !defined(WIN32)
+/*
+ * Listening sockets are passed to the new master process in hot upgrade.
+ * mln_core_listen_register() registers a listening socket fd.
+ * return value: 0 - succeed   -1 - too many sockets
+ *
+ * mln_core_listen_inherited() returns the socket bound to addr inherited
+ * from the old master process and registers it, or -1 if not existent.
+ * It should be called in global_init, the inherited sockets not claimed
+ * there are closed after global_init returned.
+ */
+extern int mln_core_listen_register(int fd);
+extern int mln_core_listen_inherited(struct sockaddr *addr, socklen_t addrlen) __NONNULL1(1);
+#endif
 #endif
@@ -0,0 +1,93 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_DHEAP_H
+#define __MLN_DHEAP_H
+
+#include "mln_types.h"
+
+/*
+ * Array-backed d-ary min heap.
+ * The heap only keeps an array of node pointers, every node records
+ * its position in the array, so a node can be deleted or re-positioned
+ * in O(log n) without any search.
+ */
+#define M_DHEAP_ARITY    4
+#define M_DHEAP_LEN_BASE 64
+#define M_DHEAP_NOT_IN   ((mln_size_t)-1)
+
+/*
+ * return value: 0 - p1 < p2   !0 - p1 >= p2
+ */
+typedef int (*dheap_cmp)(const void *, const void *);
+typedef void (*dheap_key_free)(void *);
+typedef void *(*dheap_pool_alloc_handler)(void *, mln_size_t);
+typedef void (*dheap_pool_free_handler)(void *);
+
+struct mln_dheap_attr {
+    void                     *pool;
+    dheap_pool_alloc_handler  pool_alloc;
+    dheap_pool_free_handler   pool_free;
+    dheap_cmp                 cmp;
+    dheap_key_free            key_free;    /*can be NULL*/
+    mln_size_t                len_base;    /*0 means M_DHEAP_LEN_BASE*/
+};
+
+typedef struct {
+    void                     *key;
+    mln_size_t                index;
+} mln_dheap_node_t;
+
+typedef struct {
+    void                     *pool;
+    dheap_pool_alloc_handler  pool_alloc;
+    dheap_pool_free_handler   pool_free;
+    dheap_cmp                 cmp;
+    dheap_key_free            key_free;
+    mln_dheap_node_t        **tbl;
+    mln_size_t                len;
+    mln_size_t                num;
+} mln_dheap_t;
+
+#define mln_dheap_num(dh)          ((dh)->num)
+#define mln_dheap_minimum(dh)      ((dh)->num? (dh)->tbl[0]: NULL)
+#define mln_dheap_node_in_heap(fn) ((fn)->index != M_DHEAP_NOT_IN)
+
+extern mln_dheap_t *
+mln_dheap_init(struct mln_dheap_attr *attr) __NONNULL1(1);
+/*
+ * mln_dheap_destroy():
+ * Nodes still in the heap are freed by mln_dheap_node_destroy().
+ */
+extern void
+mln_dheap_destroy(mln_dheap_t *dh);
+/*
+ * return value: -1 - no memory   0 - succeed
+ */
+extern int
+mln_dheap_insert(mln_dheap_t *dh, mln_dheap_node_t *fn) __NONNULL2(1,2);
+extern mln_dheap_node_t *
+mln_dheap_extract_min(mln_dheap_t *dh) __NONNULL1(1);
+/*
+ * mln_dheap_update():
+ * Re-position fn after its key has been modified in any direction.
+ */
+extern void
+mln_dheap_update(mln_dheap_t *dh, mln_dheap_node_t *fn) __NONNULL2(1,2);
+/*
+ * mln_dheap_delete():
+ * Remove fn from the heap, fn will not be freed.
+ */
+extern void
+mln_dheap_delete(mln_dheap_t *dh, mln_dheap_node_t *fn) __NONNULL2(1,2);
+
+/*mln_dheap_node_t*/
+extern mln_dheap_node_t *
+mln_dheap_node_init(mln_dheap_t *dh, void *key) __NONNULL1(1);
+extern void
+mln_dheap_node_destroy(mln_dheap_t *dh, mln_dheap_node_t *fn) __NONNULL1(1);
+
+#endif
+
@@ -22,7 +22,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include "mln_rbtree.h"
-#include "mln_fheap.h"
+#include "mln_dheap.h"
 
 /*common*/
 #define M_EV_HASH_LEN 64
@@ -72,7 +72,7 @@ typedef struct mln_event_fd_s {
     ev_fd_handler            err_handler;
     void                    *timeout_data;
     ev_fd_handler            timeout_handler;
-    mln_fheap_node_t        *timeout_node;
+    mln_dheap_node_t        *timeout_node;
     mln_u64_t                end_us;
     int                      fd;
     mln_u32_t                active_flag;
@@ -112,8 +112,8 @@ struct mln_event_s {
     mln_event_desc_t        *ev_fd_wait_tail;
     mln_event_desc_t        *ev_fd_active_head;
     mln_event_desc_t        *ev_fd_active_tail;
-    mln_fheap_t             *ev_fd_timeout_heap;
-    mln_fheap_t             *ev_timer_heap;
+    mln_dheap_t             *ev_fd_timeout_heap;
+    mln_dheap_t             *ev_timer_heap;
     mln_u32_t                is_break:1;
     mln_u32_t                padding:31;
     int                      rd_fd;
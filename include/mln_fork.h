@@ -9,17 +9,21 @@
 #include "mln_types.h"
 #include "mln_event.h"
 #include "mln_connection.h"
+#include "mln_alloc.h"
 
 #define STATE_IDLE    0
 #define STATE_LENGTH  1
 #define M_F_TYPELEN   sizeof(mln_u32_t)
 #define M_F_LENLEN    sizeof(mln_u32_t)
+#define M_F_SHM_QLEN  1024 /*must be a power of 2*/
 
 typedef struct mln_fork_s mln_fork_t;
 
 typedef void (*clr_handler)(void *);
 
 typedef int (*scan_handler)(mln_event_t *, mln_fork_t *, void *);
+/*connection distribution handler of worker process*/
+typedef void (*dist_handler)(mln_event_t *, int, void *);
 /*ipc handler*/
 typedef void (*ipc_handler)(mln_event_t *, \
                             void *, /*mln_fork_t or mln_tcp_conn_t*/\
@@ -32,6 +36,36 @@ typedef struct {
     mln_u32_t                type;
 } mln_ipc_handler_t;
 
+/*
+ * Shared memory transport between master and a worker process.
+ * Messages are allocated from pool and passed by pointer through
+ * a single producer single consumer ring in each direction,
+ * the socketpair only carries M_IPC_TYPE_SHM_WAKEUP messages.
+ * It is mapped before fork, so pointers are valid in both processes.
+ */
+typedef struct {
+    void                    *buf;
+    mln_u32_t                type;
+    mln_u32_t                len;
+} mln_ipc_shm_msg_t;
+
+typedef struct {
+    mln_u32_t                head;
+    mln_u8_t                 pad0[M_CACHELINE_SIZE - sizeof(mln_u32_t)];
+    mln_u32_t                tail;
+    mln_u8_t                 pad1[M_CACHELINE_SIZE - sizeof(mln_u32_t)];
+    mln_u32_t                notified;
+    mln_u8_t                 pad2[M_CACHELINE_SIZE - sizeof(mln_u32_t)];
+    mln_ipc_shm_msg_t        msgs[M_F_SHM_QLEN];
+} mln_ipc_shm_ring_t;
+
+typedef struct {
+    pthread_mutex_t          lock;
+    mln_alloc_t             *pool;
+    mln_ipc_shm_ring_t       to_worker;
+    mln_ipc_shm_ring_t       to_master;
+} mln_ipc_shm_t;
+
 enum proc_state_type {
     M_PST_DFL,
     M_PST_SUP /*supervise*/
@@ -47,6 +81,9 @@ struct mln_fork_attr {
     mln_u32_t                n_args;
     int                      fd;
     pid_t                    pid;
+    mln_sauto_t              worker_id;/*-1 if not a worker process*/
+    mln_ipc_shm_t           *shm;
+    int                      dist_fd;
     enum proc_exec_type      etype;
     enum proc_state_type     stype;
 };
@@ -57,6 +94,10 @@ struct mln_fork_s {
     mln_s8ptr_t             *args;
     mln_tcp_conn_t           conn;
     pid_t                    pid;
+    mln_sauto_t              worker_id;
+    mln_ipc_shm_t           *shm;/*NULL if shared memory transport is off*/
+    int                      dist_fd;/*-1 if connection distribution is off*/
+    mln_u32_t                load;/*reported by worker process*/
     mln_u32_t                n_args;
     mln_u32_t                state;
     mln_u32_t                msg_len;
@@ -109,6 +150,39 @@ mln_ipc_worker_send_prepare(mln_event_t *ev, \
                             mln_u32_t type, \
                             void *msg, \
                             mln_size_t len) __NONNULL2(1,3);
+/*
+ * Zero-copy IPC over shared memory, only for worker processes and
+ * only if 'worker_ipc_shm' is set. f_child is NULL in worker process.
+ * mln_ipc_shm_alloc() returns NULL if no shared memory transport
+ * or no enough shared memory, then use mln_ipc_*_send_prepare() instead.
+ * The buffer is owned by the receiver after sent, and is freed after
+ * the ipc handler returned.
+ */
+extern void *mln_ipc_shm_alloc(mln_fork_t *f_child, mln_size_t len);
+extern void mln_ipc_shm_free(mln_fork_t *f_child, void *buf);
+extern int
+mln_ipc_master_send_shm(mln_event_t *ev, \
+                        mln_u32_t type, \
+                        void *buf, \
+                        mln_u32_t len, \
+                        mln_fork_t *f_child) __NONNULL3(1,3,5);
+extern int
+mln_ipc_worker_send_shm(mln_event_t *ev, \
+                        mln_u32_t type, \
+                        void *buf, \
+                        mln_u32_t len) __NONNULL2(1,3);
+
+/*
+ * Connection distribution, only if 'worker_conn_dist' is on.
+ * Master process accepts connections of listen_fd and passes each one
+ * to the least loaded worker process, whose handler is called with it.
+ * Worker processes report their loads (e.g. number of connections)
+ * by mln_fork_dist_load_report().
+ */
+extern int mln_fork_dist_listen(mln_event_t *ev, int listen_fd) __NONNULL1(1);
+extern int
+mln_set_worker_dist_handler(mln_event_t *ev, dist_handler handler, void *data) __NONNULL2(1,2);
+extern int mln_fork_dist_load_report(mln_event_t *ev, mln_u32_t load) __NONNULL1(1);
 
 #endif
 #endif
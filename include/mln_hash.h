@@ -20,6 +20,17 @@ typedef void (*hash_free_handler)(void *);
 typedef void *(*hash_pool_alloc_handler)(void *, mln_size_t);
 typedef void (*hash_pool_free_handler)(void *);
 
+/*
+ * key_type:
+ * M_HASH_KEY_CUSTOM -- keys are hashed and compared by hash and cmp handlers.
+ * M_HASH_KEY_STRING -- keys are mln_string_t pointers.
+ * M_HASH_KEY_CSTR   -- keys are NUL-terminated C strings.
+ * String keys are hashed by mln_hash_string_calc and hash and cmp are ignored.
+ */
+#define M_HASH_KEY_CUSTOM 0
+#define M_HASH_KEY_STRING 1
+#define M_HASH_KEY_CSTR   2
+
 typedef enum mln_hash_flag {
     M_HASH_F_NONE,
     M_HASH_F_VAL,
@@ -39,12 +50,16 @@ struct mln_hash_attr {
     mln_u32_t                expandable:1;
     mln_u32_t                calc_prime:1;
     mln_u32_t                cache:1;
+    mln_u32_t                progressive:1;
+    mln_u32_t                key_type:2;
+    mln_u32_t                nocase:1;
 };
 
 typedef struct mln_hash_entry_s {
     mln_hash_t              *hash;
     void                    *val;
     void                    *key;
+    mln_u64_t                hval;
     struct mln_hash_entry_s *prev;
     struct mln_hash_entry_s *next;
     struct mln_hash_entry_s *cache_prev;
@@ -65,16 +80,31 @@ struct mln_hash_s {
     hash_free_handler        free_key;
     hash_free_handler        free_val;
     mln_hash_mgr_t          *tbl;
+    mln_hash_mgr_t          *old_tbl;
     mln_hash_entry_t        *cache_head;
     mln_hash_entry_t        *cache_tail;
     mln_u64_t                len;
+    mln_u64_t                old_len;
+    mln_u64_t                rehash_pos;
     mln_u32_t                nr_nodes;
     mln_u32_t                threshold;
     mln_u32_t                expandable:1;
     mln_u32_t                calc_prime:1;
     mln_u32_t                cache:1;
+    mln_u32_t                progressive:1;
+    mln_u32_t                key_type:2;
+    mln_u32_t                nocase:1;
 };
 
+/*
+ * In progressive mode, at most M_HASH_REHASH_STEP non-empty buckets
+ * (and M_HASH_REHASH_STEP*10 buckets in total) of the old table
+ * are migrated by each insert, replace and remove.
+ */
+#define M_HASH_REHASH_STEP 4
+
+#define mln_hash_rehashing(h) ((h)->old_tbl != NULL)
+
 
 extern mln_hash_t *
 mln_hash_init(struct mln_hash_attr *attr) __NONNULL1(1);
@@ -101,7 +131,27 @@ mln_hash_scan_all(mln_hash_t *h, hash_scan_handler handler, void *udata) __NONNU
 extern void *
 mln_hash_change_value(mln_hash_t *h, void *key, void *new_value) __NONNULL2(1,2);
 extern int mln_hash_key_exist(mln_hash_t *h, void *key) __NONNULL2(1,2);
+extern mln_u64_t mln_hash_string_calc(mln_u8ptr_t data, mln_u64_t len, int nocase);
 extern void mln_hash_reset(mln_hash_t *h, mln_hash_flag_t flg) __NONNULL1(1);
+/*
+ * mln_hash_*_hv():
+ * The same as the functions above, but hv is given by the caller,
+ * so the key is not hashed again. hv must be the value the table would
+ * compute itself, i.e. mln_hash_string_calc() for string keys or the
+ * return value of the hash handler for custom keys.
+ */
+extern void *
+mln_hash_search_hv(mln_hash_t *h, void *key, mln_u64_t hv) __NONNULL2(1,2);
+extern int
+mln_hash_replace_hv(mln_hash_t *h, void *key, void *val, mln_u64_t hv) __NONNULL3(1,2,3);
+extern int
+mln_hash_insert_hv(mln_hash_t *h, void *key, void *val, mln_u64_t hv) __NONNULL2(1,2);
+extern void
+mln_hash_remove_hv(mln_hash_t *h, void *key, mln_hash_flag_t flg, mln_u64_t hv) __NONNULL2(1,2);
+extern void *
+mln_hash_change_value_hv(mln_hash_t *h, void *key, void *new_value, mln_u64_t hv) __NONNULL2(1,2);
+extern int
+mln_hash_key_exist_hv(mln_hash_t *h, void *key, mln_u64_t hv) __NONNULL2(1,2);
 
 #endif
 
@@ -6,8 +6,18 @@
 #define __MLN_IOTHREAD_H
 
 #include "mln_types.h"
+#include "mln_queue.h"
 #include <pthread.h>
 
+/*
+ * Messages are taken from a preallocated pool and passed through
+ * lock-free rings. The other end is notified through an eventfd
+ * (a socketpair if eventfd is not supported) only when it may be
+ * asleep, so a burst of messages costs only one notification.
+ */
+#define M_IOTHREAD_QLEN 1024
+#define M_IOTHREAD_SPIN 1024
+
 typedef struct mln_iothread_msg_s mln_iothread_msg_t;
 typedef struct mln_iothread_s     mln_iothread_t;
 
@@ -22,12 +32,11 @@ typedef void (*mln_iothread_msg_process_t)(mln_iothread_t *, mln_iothread_ep_typ
 struct mln_iothread_msg_s {
     mln_u32_t                   feedback:1;
     mln_u32_t                   hold:1;
-    mln_u32_t                   padding:30;
+    mln_u32_t                   pooled:1;
+    mln_u32_t                   padding:29;
     mln_u32_t                   type;
     void                       *data;
-    pthread_mutex_t             mutex;
-    struct mln_iothread_msg_s  *prev;
-    struct mln_iothread_msg_s  *next;
+    mln_u32_t                   done;/*0 - pending, 1 - done, 2 - sender is sleeping*/
 };
 
 struct mln_iothread_attr {
@@ -35,27 +44,33 @@ struct mln_iothread_attr {
     mln_iothread_entry_t        entry;
     void                       *args;
     mln_iothread_msg_process_t  handler;
+    mln_u32_t                   qlen;/*0 means M_IOTHREAD_QLEN*/
+    mln_u32_t                   spsc;/*only one user thread and one I/O thread*/
 };
 
 struct mln_iothread_s {
     pthread_t                  *tids;
-    pthread_mutex_t             io_lock;
-    pthread_mutex_t             user_lock;
-    int                         io_fd;
-    int                         user_fd;
+    int                         io_fd;/*readable if there are messages to I/O threads*/
+    int                         user_fd;/*readable if there are messages to user thread*/
+    int                         io_wfd;
+    int                         user_wfd;
     mln_iothread_entry_t        entry;
     void                       *args;
     mln_iothread_msg_process_t  handler;
-    mln_iothread_msg_t         *io_head;
-    mln_iothread_msg_t         *io_tail;
-    mln_iothread_msg_t         *user_head;
-    mln_iothread_msg_t         *user_tail;
+    mln_queue_ring_t           *io_ring;
+    mln_queue_ring_t           *user_ring;
+    mln_queue_ring_t           *free_ring;
+    mln_iothread_msg_t         *msgs;
     mln_u32_t                   nthread;
+    char                        pad0[M_CACHELINE_SIZE];
+    mln_u32_t                   io_notified;
+    char                        pad1[M_CACHELINE_SIZE - sizeof(mln_u32_t)];
+    mln_u32_t                   user_notified;
+    char                        pad2[M_CACHELINE_SIZE - sizeof(mln_u32_t)];
 };
 
 #define mln_iothread_sockfd_get(p,t)   ((t) == io_thread? (p)->io_fd: (p)->user_fd)
 #define mln_iothread_msg_hold(m)       ((m)->hold = 1)
-#define mln_iothread_msg_release(m)    pthread_mutex_unlock(&(m)->mutex)
 #define mln_iothread_msg_type(m)       ((m)->type)
 #define mln_iothread_msg_data(m)       ((m)->data)
 
@@ -63,5 +78,6 @@ extern int mln_iothread_init(mln_iothread_t *t, struct mln_iothread_attr *attr);
 extern void mln_iothread_destroy(mln_iothread_t *t);
 extern int mln_iothread_send(mln_iothread_t *t, mln_u32_t type, void *data, mln_iothread_ep_type_t to, mln_u32_t feedback);
 extern int mln_iothread_recv(mln_iothread_t *t, mln_iothread_ep_type_t from);
+extern void mln_iothread_msg_release(mln_iothread_msg_t *m);
 
 #endif
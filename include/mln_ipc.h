@@ -5,6 +5,14 @@
 #ifndef __MLN_IPC_H
 #define __MLN_IPC_H
 
+/*
+ * Message types 0~1024 are reserved by melon, all of them are defined here.
+ */
+#define M_IPC_TYPE_CONF        1
+#define M_IPC_TYPE_QUIT        2
+#define M_IPC_TYPE_LOAD        3
+#define M_IPC_TYPE_SHM_WAKEUP  4 /*wakes up the receiver of a shared memory ring*/
+
 #if !defined(WIN32)
 
 #include "mln_types.h"
@@ -10,6 +10,11 @@
 #include "mln_types.h"
 
 #define M_LOG_PATH_LEN 1024
+#define M_LOG_LINE_LEN 4096/*longer lines are formatted in heap*/
+#define M_LOG_BUF_LEN  65536/*per thread in async mode, a power of 2*/
+#define M_LOG_FLUSH_MS 100
+#define M_LOG_IOV_MAX  64
+#define M_LOG_SHM_LEN  (1 << 20)/*per worker process in shm mode, a power of 2*/
 
 typedef enum {
     none,
@@ -25,11 +30,43 @@ typedef struct {
     char            log_path[M_LOG_PATH_LEN];
     int             fd;
     int             in_daemon;
+    int             async;
     mln_log_level_t level;
     mln_spin_t      thread_lock;
 } mln_log_t;
     
 
+/*
+ * Async mode:
+ * Each thread appends formatted lines to its own buffer without any lock,
+ * a background thread writes all buffers every M_LOG_FLUSH_MS by one writev().
+ * Only the owner thread moves head, only the flushing thread moves tail.
+ */
+typedef struct mln_log_buf_s {
+    mln_u64_t             head;
+    char                  pad0[M_CACHELINE_SIZE - sizeof(mln_u64_t)];
+    mln_u64_t             tail;
+    char                  pad1[M_CACHELINE_SIZE - sizeof(mln_u64_t)];
+    mln_u32_t             dead;/*owner thread exited*/
+    struct mln_log_buf_s *prev;
+    struct mln_log_buf_s *next;
+    char                  data[M_LOG_BUF_LEN];
+} mln_log_buf_t;
+
+/*
+ * Shm mode:
+ * Async mode across processes. The flusher of each worker process moves
+ * lines from the buffers of its threads to its own ring in shared memory,
+ * and only the flusher of the master process writes the log file.
+ */
+typedef struct {
+    mln_u64_t             head;
+    char                  pad0[M_CACHELINE_SIZE - sizeof(mln_u64_t)];
+    mln_u64_t             tail;
+    char                  pad1[M_CACHELINE_SIZE - sizeof(mln_u64_t)];
+    char                  data[M_LOG_SHM_LEN];
+} mln_log_shm_t;
+
 typedef void (*mln_logger_t)(mln_log_t *, mln_log_level_t, const char *, const char *, int, char *, va_list);
 
 extern void mln_log_set_logger(mln_logger_t logger);
@@ -45,6 +82,26 @@ extern void _mln_sys_log(mln_log_level_t level, \
 #define mln_log(err_lv,msg,...) \
     _mln_sys_log(err_lv, __FILE__, __FUNCTION__, __LINE__, msg, ## __VA_ARGS__)
 extern ssize_t mln_log_writen(void *buf, mln_size_t size);
+/*
+ * mln_log_flush():
+ * Write all buffered lines in async mode, do nothing in sync mode.
+ */
+extern void mln_log_flush(void);
+/*
+ * mln_log_shm_init():
+ * Create rings for n_workers worker processes if 'log_shm' is on.
+ * It is called by the multi-process framework before worker processes are forked.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_log_shm_init(mln_u32_t n_workers);
+/*
+ * mln_log_shm_worker_set():
+ * Called in a worker process by the framework, then the worker process
+ * puts its lines to ring worker_id. A worker process whose
+ * worker_id >= n_workers, e.g. one forked by mln_fork_restart(),
+ * has no ring and writes the file directly.
+ */
+extern void mln_log_shm_worker_set(mln_sauto_t worker_id);
 extern int mln_log_get_fd(void);
 extern char *mln_log_get_dir_path(void);
 extern char *mln_log_get_log_path(void);
@@ -0,0 +1,54 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+#ifndef __MLN_NOTIFIER_H
+#define __MLN_NOTIFIER_H
+
+#include "mln_types.h"
+
+/*
+ * Notifier:
+ * Used internally to wake up the consumer of a lock-free ring.
+ * The consumer waits on rfd, an eventfd (a nonblocking socketpair if
+ * eventfd is not supported). The flag notified is kept by the caller,
+ * so that it can be put in its own cacheline or in shared memory, and
+ * only the first sender after the consumer cleared it writes wfd.
+ */
+/*
+ * mln_notifier_init():
+ * rfd and wfd are the same fd if eventfd is used.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_notifier_init(int *rfd, int *wfd) __NONNULL2(1,2);
+extern void mln_notifier_destroy(int rfd, int wfd);
+/*
+ * mln_notifier_arm():
+ * Called by a sender after its message is visible to the consumer.
+ * return value: 1 - the caller should wake the consumer up, and call
+ *                   mln_notifier_disarm() if it failed
+ *               0 - the consumer is already notified
+ */
+extern int mln_notifier_arm(mln_u32_t *notified) __NONNULL1(1);
+extern void mln_notifier_disarm(mln_u32_t *notified) __NONNULL1(1);
+/*
+ * mln_notifier_wake():
+ * Write wfd without checking the flag.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_notifier_wake(int wfd);
+/*
+ * mln_notifier_notify():
+ * mln_notifier_arm(), then mln_notifier_wake() if needed.
+ */
+extern void mln_notifier_notify(mln_u32_t *notified, int wfd) __NONNULL1(1);
+/*
+ * mln_notifier_drain():
+ * Called by the consumer before it takes messages from the ring.
+ * The notification on rfd is consumed, then the flag is cleared.
+ * rfd is -1 if the notification is consumed by the caller itself,
+ * and notified is NULL if there is no flag, e.g. notified only once.
+ */
+extern void mln_notifier_drain(mln_u32_t *notified, int rfd);
+
+#endif
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_OHASH_H
+#define __MLN_OHASH_H
+
+#include "mln_types.h"
+#include "mln_hash.h"
+
+/*
+ * Open addressing hash table.
+ * Slots are grouped by M_OHASH_GROUP_SIZE control bytes,
+ * each control byte holds 7 bits of the hash value of its slot,
+ * so a lookup compares a whole group at once and only calls
+ * cmp for slots whose control byte matched.
+ */
+#define M_OHASH_GROUP_SIZE  16
+#define M_OHASH_MIN_LEN     16
+#define M_OHASH_CTRL_EMPTY  ((mln_u8_t)0x80)
+#define M_OHASH_CTRL_DEL    ((mln_u8_t)0xfe)
+
+typedef struct mln_ohash_s mln_ohash_t;
+
+/*
+ * The hash handler should return a well-mixed 64-bit value,
+ * not a bucket index like hash_calc_handler.
+ */
+typedef mln_u64_t (*ohash_calc_handler)(mln_ohash_t *, void *);
+/*
+ * cmp_handler's return value: 0 -- not matched, !0 -- matched.
+ */
+typedef int (*ohash_cmp_handler)(mln_ohash_t *, void *, void *);
+
+struct mln_ohash_attr {
+    void                    *pool;
+    hash_pool_alloc_handler  pool_alloc;
+    hash_pool_free_handler   pool_free;
+    ohash_calc_handler       hash;
+    ohash_cmp_handler        cmp;
+    hash_free_handler        free_key;
+    hash_free_handler        free_val;
+    mln_u64_t                len_base;
+    mln_u32_t                expandable:1;
+};
+
+typedef struct {
+    void                    *key;
+    void                    *val;
+} mln_ohash_slot_t;
+
+struct mln_ohash_s {
+    void                    *pool;
+    hash_pool_alloc_handler  pool_alloc;
+    hash_pool_free_handler   pool_free;
+    ohash_calc_handler       hash;
+    ohash_cmp_handler        cmp;
+    hash_free_handler        free_key;
+    hash_free_handler        free_val;
+    mln_u8ptr_t              ctrl;
+    mln_ohash_slot_t        *slots;
+    mln_u64_t                len;
+    mln_u64_t                nr_nodes;
+    mln_u64_t                nr_deleted;
+    mln_u64_t                growth_left;
+    mln_u32_t                expandable:1;
+};
+
+#define mln_ohash_nr_nodes(h) ((h)->nr_nodes)
+
+extern mln_ohash_t *
+mln_ohash_init(struct mln_ohash_attr *attr) __NONNULL1(1);
+extern void
+mln_ohash_destroy(mln_ohash_t *h, mln_hash_flag_t flg) __NONNULL1(1);
+extern void *
+mln_ohash_search(mln_ohash_t *h, void *key) __NONNULL2(1,2);
+/*
+ * mln_ohash_replace():
+ * key and val are second rank pointers like mln_hash_replace's.
+ */
+extern int
+mln_ohash_replace(mln_ohash_t *h, void *key, void *val) __NONNULL3(1,2,3);
+extern int
+mln_ohash_insert(mln_ohash_t *h, void *key, void *val) __NONNULL2(1,2);
+extern void
+mln_ohash_remove(mln_ohash_t *h, void *key, mln_hash_flag_t flg) __NONNULL2(1,2);
+extern int
+mln_ohash_scan_all(mln_ohash_t *h, hash_scan_handler handler, void *udata) __NONNULL1(1);
+extern void *
+mln_ohash_change_value(mln_ohash_t *h, void *key, void *new_value) __NONNULL2(1,2);
+extern int mln_ohash_key_exist(mln_ohash_t *h, void *key) __NONNULL2(1,2);
+extern void mln_ohash_reset(mln_ohash_t *h, mln_hash_flag_t flg) __NONNULL1(1);
+
+#endif
+
@@ -172,8 +172,6 @@ extern void mln_pg_item_free(mln_pg_item_t *item);
 extern mln_pg_state_t *mln_pg_state_new(void);
 extern void mln_pg_state_free(mln_pg_state_t *s);
 extern int mln_pg_token_rbtree_cmp(const void *data1, const void *data2);
-extern mln_u64_t mln_pg_map_hash_calc(mln_hash_t *h, void *key);
-extern int mln_pg_map_hash_cmp(mln_hash_t *h, void *key1, void *key2);
 extern void mln_pg_map_hash_free(void *data);
 extern int
 mln_pg_calc_info_init(struct mln_pg_calc_info_s *pci, \
@@ -513,14 +511,17 @@ SCOPE int PREFIX_NAME##_preprocess(struct PREFIX_NAME##_preprocess_attr *attr)\
     hattr.pool = NULL;\
     hattr.pool_alloc = NULL;\
     hattr.pool_free = NULL;\
-    hattr.hash = mln_pg_map_hash_calc;\
-    hattr.cmp = mln_pg_map_hash_cmp;\
+    hattr.hash = NULL;\
+    hattr.cmp = NULL;\
     hattr.free_key = mln_pg_map_hash_free;\
     hattr.free_val = mln_pg_map_hash_free;\
     hattr.len_base = M_PG_DFL_HASHLEN;\
     hattr.expandable = 1;\
     hattr.calc_prime = 0;\
     hattr.cache = 0;\
+    hattr.progressive = 0;\
+    hattr.key_type = M_HASH_KEY_CSTR;\
+    hattr.nocase = 0;\
     attr->map_tbl = mln_hash_init(&hattr);\
     if (attr->map_tbl == NULL) {\
         mln_log(error, "No memory.\n");\
@@ -767,6 +768,9 @@ SCOPE mln_parser_t *PREFIX_NAME##_parser_init(void)\
     mln_parser_t *p = (mln_parser_t *)malloc(sizeof(mln_parser_t));\
     if (p == NULL) return NULL;\
     struct mln_stack_attr sattr;\
+    sattr.pool = NULL;\
+    sattr.pool_alloc = NULL;\
+    sattr.pool_free = NULL;\
     sattr.free_handler = PREFIX_NAME##_factor_destroy;\
     sattr.copy_handler = PREFIX_NAME##_factor_copy;\
     sattr.cache = 0;\
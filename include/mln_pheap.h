@@ -0,0 +1,86 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_PHEAP_H
+#define __MLN_PHEAP_H
+
+#include "mln_types.h"
+
+/*
+ * Pairing min heap.
+ * Insert and decrease key are O(1), extract min is amortized O(log n).
+ */
+
+/*
+ * return value: 0 - p1 < p2   !0 - p1 >= p2
+ */
+typedef int (*pheap_cmp)(const void *, const void *);
+/*
+ * the left argument is the destination and the right
+ * one is the source.
+ */
+typedef void (*pheap_copy)(void *, void *);
+typedef void (*pheap_key_free)(void *);
+typedef void *(*pheap_pool_alloc_handler)(void *, mln_size_t);
+typedef void (*pheap_pool_free_handler)(void *);
+
+struct mln_pheap_attr {
+    void                     *pool;
+    pheap_pool_alloc_handler  pool_alloc;
+    pheap_pool_free_handler   pool_free;
+    pheap_cmp                 cmp;
+    pheap_copy                copy;
+    pheap_key_free            key_free;    /*can be NULL*/
+};
+
+typedef struct mln_pheap_node_s {
+    void                     *key;
+    struct mln_pheap_node_s  *prev;/*parent if this is the first child*/
+    struct mln_pheap_node_s  *next;
+    struct mln_pheap_node_s  *child;
+} mln_pheap_node_t;
+
+typedef struct {
+    void                     *pool;
+    pheap_pool_alloc_handler  pool_alloc;
+    pheap_pool_free_handler   pool_free;
+    pheap_cmp                 cmp;
+    pheap_copy                copy;
+    pheap_key_free            key_free;
+    mln_pheap_node_t         *root;
+    mln_size_t                num;
+} mln_pheap_t;
+
+#define mln_pheap_num(ph)     ((ph)->num)
+#define mln_pheap_minimum(ph) ((ph)->root)
+
+extern mln_pheap_t *
+mln_pheap_init(struct mln_pheap_attr *attr) __NONNULL1(1);
+extern void
+mln_pheap_destroy(mln_pheap_t *ph);
+extern void
+mln_pheap_insert(mln_pheap_t *ph, mln_pheap_node_t *pn) __NONNULL2(1,2);
+extern mln_pheap_node_t *
+mln_pheap_extract_min(mln_pheap_t *ph) __NONNULL1(1);
+/*
+ * return value: -1 - key error   0 - succeed
+ */
+extern int
+mln_pheap_decrease_key(mln_pheap_t *ph, mln_pheap_node_t *pn, void *key) __NONNULL3(1,2,3);
+/*
+ * mln_pheap_delete():
+ * Remove pn from the heap, pn will not be freed.
+ */
+extern void
+mln_pheap_delete(mln_pheap_t *ph, mln_pheap_node_t *pn) __NONNULL2(1,2);
+
+/*mln_pheap_node_t*/
+extern mln_pheap_node_t *
+mln_pheap_node_init(mln_pheap_t *ph, void *key) __NONNULL1(1);
+extern void
+mln_pheap_node_destroy(mln_pheap_t *ph, mln_pheap_node_t *pn) __NONNULL1(1);
+
+#endif
+
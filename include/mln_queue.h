@@ -27,6 +27,39 @@ struct mln_queue_attr {
     queue_free             free_handler;
 };
 
+/*
+ * Lock-free bounded ring.
+ * Every cell carries a sequence number telling producers and consumers
+ * which lap it belongs to, so threads only contend on head or tail.
+ * M_QUEUE_RING_SPSC skips the CAS on head and tail, it must have only
+ * one producer thread and one consumer thread.
+ */
+#define M_QUEUE_RING_MPMC      0
+#define M_QUEUE_RING_SPSC      1
+
+typedef struct {
+    mln_uauto_t            seq;
+    void                  *data;
+} mln_queue_cell_t;
+
+typedef struct {
+    mln_queue_cell_t      *cells;
+    mln_uauto_t            mask;
+    queue_free             free_handler;
+    mln_u32_t              mode;
+    char                   pad0[M_CACHELINE_SIZE];
+    mln_uauto_t            tail;
+    char                   pad1[M_CACHELINE_SIZE - sizeof(mln_uauto_t)];
+    mln_uauto_t            head;
+    char                   pad2[M_CACHELINE_SIZE - sizeof(mln_uauto_t)];
+} mln_queue_ring_t;
+
+struct mln_queue_ring_attr {
+    mln_uauto_t            qlen;/*rounded up to a power of 2*/
+    queue_free             free_handler;
+    mln_u32_t              mode;
+};
+
 
 #define mln_queue_empty(q) (!((q)->nr_element))
 #define mln_queue_full(q) ((q)->nr_element >= (q)->qlen)
@@ -42,5 +75,34 @@ extern void *mln_queue_search(mln_queue_t *q, mln_uauto_t index) __NONNULL1(1);
 extern void mln_queue_free_index(mln_queue_t *q, mln_uauto_t index) __NONNULL1(1);
 extern int mln_queue_scan_all(mln_queue_t *q, queue_scan scan_handler, void *udata) __NONNULL1(1);
 
+#define mln_queue_ring_length(r) ((r)->mask + 1)
+/*
+ * mln_queue_ring_element():
+ * Only a snapshot if other threads are working on the ring.
+ */
+#define mln_queue_ring_element(r) \
+    (__atomic_load_n(&((r)->tail), __ATOMIC_ACQUIRE) - __atomic_load_n(&((r)->head), __ATOMIC_ACQUIRE))
+extern mln_queue_ring_t *mln_queue_ring_init(struct mln_queue_ring_attr *attr) __NONNULL1(1);
+/*
+ * mln_queue_ring_destroy():
+ * No other thread could work on the ring.
+ */
+extern void mln_queue_ring_destroy(mln_queue_ring_t *r);
+/*
+ * data must not be NULL.
+ * return value: -1 - full   0 - succeed
+ */
+extern int mln_queue_ring_push(mln_queue_ring_t *r, void *data) __NONNULL2(1,2);
+/*
+ * return value: NULL - empty   otherwise the element removed from ring
+ */
+extern void *mln_queue_ring_pop(mln_queue_ring_t *r) __NONNULL1(1);
+/*
+ * Batch functions push or pop at most n continuous elements
+ * with only one CAS, and return the number of elements handled.
+ */
+extern mln_uauto_t mln_queue_ring_push_batch(mln_queue_ring_t *r, void **data, mln_uauto_t n) __NONNULL2(1,2);
+extern mln_uauto_t mln_queue_ring_pop_batch(mln_queue_ring_t *r, void **data, mln_uauto_t n) __NONNULL2(1,2);
+
 #endif
 
@@ -5,6 +5,7 @@
 
 #ifndef __MLN_RBTREE_H
 #define __MLN_RBTREE_H
+#include <stddef.h>
 #include "mln_types.h"
 
 typedef struct mln_rbtree_node_s mln_rbtree_node_t;
@@ -40,6 +41,7 @@ struct mln_rbtree_node_s {
     struct mln_rbtree_node_s  *parent;
     struct mln_rbtree_node_s  *left;
     struct mln_rbtree_node_s  *right;
+    mln_uauto_t                size;/*number of nodes in this subtree*/
     enum rbtree_color          color;
 };
 
@@ -87,5 +89,137 @@ mln_rbtree_node_free(mln_rbtree_t *t, mln_rbtree_node_t *n) __NONNULL2(1,2);
 extern int
 mln_rbtree_scan_all(mln_rbtree_t *t, rbtree_act act, void *udata) __NONNULL2(1,2);
 extern void mln_rbtree_reset(mln_rbtree_t *t) __NONNULL1(1);
+/*
+ * Order statistics.
+ * select, lower_bound and upper_bound return &(t->nil) if not found.
+ */
+extern mln_rbtree_node_t *
+mln_rbtree_select(mln_rbtree_t *t, mln_uauto_t k) __NONNULL1(1);
+extern mln_uauto_t
+mln_rbtree_rank(mln_rbtree_t *t, const void *key) __NONNULL2(1,2);
+extern mln_rbtree_node_t *
+mln_rbtree_lower_bound(mln_rbtree_t *t, const void *key) __NONNULL2(1,2);
+extern mln_rbtree_node_t *
+mln_rbtree_upper_bound(mln_rbtree_t *t, const void *key) __NONNULL2(1,2);
+/*
+ * mln_rbtree_range_scan():
+ * Call act on nodes whose data is in [low, high) in order, NULL means unbounded.
+ * act can not delete nodes.
+ */
+extern int
+mln_rbtree_range_scan(mln_rbtree_t *t, const void *low, const void *high, rbtree_act act, void *udata) __NONNULL2(1,4);
+
+/*
+ * Intrusive rbtree.
+ * mln_rbtree_inode_t is embedded in user's structure, so there is no
+ * node allocation, and the typed functions generated by
+ * MLN_RBTREE_FUNC_DEFINE call the comparison function directly.
+ * Empty links are NULL.
+ */
+typedef struct mln_rbtree_inode_s {
+    struct mln_rbtree_inode_s *parent;
+    struct mln_rbtree_inode_s *left;
+    struct mln_rbtree_inode_s *right;
+    enum rbtree_color          color;
+} mln_rbtree_inode_t;
+
+typedef struct {
+    mln_rbtree_inode_t        *root;
+    mln_rbtree_inode_t        *min;
+    mln_uauto_t                nr_node;
+} mln_rbtree_iroot_t;
+
+#define mln_rbtree_iroot_init(r) ((r)->root = (r)->min = NULL, (r)->nr_node = 0)
+#define mln_rbtree_ientry(ptr,type,member) \
+    ((type *)((mln_u8ptr_t)(ptr) - offsetof(type, member)))
+
+/*
+ * mln_rbtree_inode_link():
+ * Attach n to parent at link, link is &(root->root), &(parent->left)
+ * or &(parent->right) found by searching down from the root, then rebalance.
+ */
+extern void
+mln_rbtree_inode_link(mln_rbtree_iroot_t *r, \
+                      mln_rbtree_inode_t *parent, \
+                      mln_rbtree_inode_t **link, \
+                      mln_rbtree_inode_t *n) __NONNULL3(1,3,4);
+extern void
+mln_rbtree_inode_erase(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n) __NONNULL2(1,2);
+extern mln_rbtree_inode_t *
+mln_rbtree_inode_next(mln_rbtree_inode_t *n) __NONNULL1(1);
+extern mln_rbtree_inode_t *
+mln_rbtree_inode_prev(mln_rbtree_inode_t *n) __NONNULL1(1);
+extern mln_rbtree_inode_t *
+mln_rbtree_inode_last(mln_rbtree_iroot_t *r) __NONNULL1(1);
+
+/*
+ * Typed intrusive rbtree functions.
+ * cmp is a function or macro: int cmp(const type *, const type *),
+ * returns the same as rbtree_cmp.
+ * member is the name of the mln_rbtree_inode_t field in type.
+ * Nodes with equal keys are inserted after the existent ones.
+ * search takes a type pointer with key fields set.
+ */
+#define MLN_RBTREE_FUNC_DECLARE(prefix,type,scope,func_attr); \
+    scope void prefix##_rbtree_insert(mln_rbtree_iroot_t *root, type *data) func_attr;\
+    scope void prefix##_rbtree_delete(mln_rbtree_iroot_t *root, type *data) func_attr;\
+    scope type *prefix##_rbtree_search(mln_rbtree_iroot_t *root, const type *key) func_attr;\
+    scope type *prefix##_rbtree_min(mln_rbtree_iroot_t *root) func_attr;\
+    scope type *prefix##_rbtree_max(mln_rbtree_iroot_t *root) func_attr;\
+    scope type *prefix##_rbtree_next(type *data) func_attr;\
+    scope type *prefix##_rbtree_prev(type *data) func_attr;
+
+#define MLN_RBTREE_FUNC_DEFINE(prefix,type,scope,cmp,member); \
+    scope void prefix##_rbtree_insert(mln_rbtree_iroot_t *root, type *data) \
+    {\
+        mln_rbtree_inode_t *parent = NULL, **link = &(root->root);\
+        while (*link != NULL) {\
+            parent = *link;\
+            if (cmp(data, mln_rbtree_ientry(parent, type, member)) < 0) link = &(parent->left);\
+            else link = &(parent->right);\
+        }\
+        mln_rbtree_inode_link(root, parent, link, &(data->member));\
+    }\
+    \
+    scope void prefix##_rbtree_delete(mln_rbtree_iroot_t *root, type *data) \
+    {\
+        mln_rbtree_inode_erase(root, &(data->member));\
+    }\
+    \
+    scope type *prefix##_rbtree_search(mln_rbtree_iroot_t *root, const type *key) \
+    {\
+        int ret;\
+        mln_rbtree_inode_t *n = root->root;\
+        while (n != NULL) {\
+            ret = cmp(key, mln_rbtree_ientry(n, type, member));\
+            if (ret == 0) return mln_rbtree_ientry(n, type, member);\
+            n = ret < 0? n->left: n->right;\
+        }\
+        return NULL;\
+    }\
+    \
+    scope type *prefix##_rbtree_min(mln_rbtree_iroot_t *root) \
+    {\
+        return root->min == NULL? NULL: mln_rbtree_ientry(root->min, type, member);\
+    }\
+    \
+    scope type *prefix##_rbtree_max(mln_rbtree_iroot_t *root) \
+    {\
+        mln_rbtree_inode_t *n = mln_rbtree_inode_last(root);\
+        return n == NULL? NULL: mln_rbtree_ientry(n, type, member);\
+    }\
+    \
+    scope type *prefix##_rbtree_next(type *data) \
+    {\
+        mln_rbtree_inode_t *n = mln_rbtree_inode_next(&(data->member));\
+        return n == NULL? NULL: mln_rbtree_ientry(n, type, member);\
+    }\
+    \
+    scope type *prefix##_rbtree_prev(type *data) \
+    {\
+        mln_rbtree_inode_t *n = mln_rbtree_inode_prev(&(data->member));\
+        return n == NULL? NULL: mln_rbtree_ientry(n, type, member);\
+    }
+
 #endif
 
@@ -8,28 +8,35 @@
 
 #include "mln_types.h"
 
+/*
+ * Elements are kept in a continuous array which grows twice as large
+ * when it is full. If cache is not set, the array shrinks to half
+ * when less than a quarter of it is used.
+ */
+#define M_STACK_LEN_BASE 16
+
 typedef void (*stack_free)(void *);
 typedef void *(*stack_copy)(void *, void *);
 typedef int (*stack_scan)(void *, void *);
-
-typedef struct mln_stack_node_s {
-    void                    *data;
-    struct mln_stack_node_s *prev;
-    struct mln_stack_node_s *next;
-} mln_stack_node_t;
+typedef void *(*stack_pool_alloc_handler)(void *, mln_size_t);
+typedef void (*stack_pool_free_handler)(void *);
 
 typedef struct {
-    mln_stack_node_t        *bottom;
-    mln_stack_node_t        *top;
-    mln_stack_node_t        *free_head;
-    mln_stack_node_t        *free_tail;
+    void                   **elems;
     mln_uauto_t              nr_node;
+    mln_uauto_t              len;
+    void                    *pool;
+    stack_pool_alloc_handler pool_alloc;
+    stack_pool_free_handler  pool_free;
     stack_free               free_handler;
     stack_copy               copy_handler;
     mln_u32_t                cache:1;
 } mln_stack_t;
 
 struct mln_stack_attr {
+    void                    *pool;
+    stack_pool_alloc_handler pool_alloc;
+    stack_pool_free_handler  pool_free;
     stack_free               free_handler;
     stack_copy               copy_handler;
     mln_u32_t                cache:1;
@@ -37,7 +44,8 @@ struct mln_stack_attr {
 
 
 #define mln_stack_empty(s) (!(s)->nr_node)
-#define mln_stack_top(st) ((st)->top == NULL? NULL: (st)->top->data)
+#define mln_stack_top(st) ((st)->nr_node? (st)->elems[(st)->nr_node - 1]: NULL)
+#define mln_stack_element(st) ((st)->nr_node)
 extern mln_stack_t *
 mln_stack_init(struct mln_stack_attr *attr) __NONNULL1(1);
 extern void
@@ -45,6 +53,11 @@ mln_stack_destroy(mln_stack_t *st);
 extern int
 mln_stack_push(mln_stack_t *st, void *data) __NONNULL2(1,2);
 extern void *mln_stack_pop(mln_stack_t *st) __NONNULL1(1);
+/*
+ * mln_stack_reserve():
+ * Make sure that n elements can be pushed without allocation.
+ */
+extern int mln_stack_reserve(mln_stack_t *st, mln_uauto_t n) __NONNULL1(1);
 /*
  * mln_stack_dup():should be attention memory leak.
  */
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#ifndef __MLN_STATS_H
+#define __MLN_STATS_H
+
+#include "mln_types.h"
+
+/*
+ * Statistics shared by the master process and worker processes.
+ * Counters and histograms are registered before the segment is
+ * created, then each process (the master and every worker) updates
+ * its own cacheline aligned slot with relaxed atomics, and the master
+ * sums all slots up when it reads them.
+ */
+#define M_STATS_BUCKET_MAX  64
+#define M_STATS_NAME_MAX    128
+
+enum mln_stats_type {
+    M_STATS_COUNTER,
+    M_STATS_GAUGE,/*reset when a worker process (re)starts*/
+    M_STATS_HISTOGRAM,
+};
+
+typedef struct {
+    char                    *name;
+    enum mln_stats_type      type;
+    mln_u32_t                off;/*index of the first value in a slot*/
+    mln_u32_t                n_bounds;
+    mln_u64_t               *bounds;/*upper bounds of buckets, ascending*/
+} mln_stats_item_t;
+
+extern mln_u64_t *mln_stats_cur;
+extern mln_stats_item_t *mln_stats_items;
+
+#define mln_stats_add(id,n) do {\
+    if (mln_stats_cur != NULL) \
+        __atomic_add_fetch(&mln_stats_cur[mln_stats_items[(id)].off], (mln_u64_t)(n), __ATOMIC_RELAXED);\
+} while (0)
+#define mln_stats_sub(id,n) do {\
+    if (mln_stats_cur != NULL) \
+        __atomic_sub_fetch(&mln_stats_cur[mln_stats_items[(id)].off], (mln_u64_t)(n), __ATOMIC_RELAXED);\
+} while (0)
+#define mln_stats_inc(id) mln_stats_add(id, 1)
+#define mln_stats_dec(id) mln_stats_sub(id, 1)
+
+/*
+ * mln_stats_*_register():
+ * Should be called before mln_stats_init(), e.g. in global_init of mln_core_init().
+ * bounds of a histogram are copied, a value v is counted in the first bucket
+ * whose bound >= v, or in the last bucket if v is greater than all of them.
+ * return value: id on success, -1 on failure
+ */
+extern int mln_stats_counter_register(char *name) __NONNULL1(1);
+extern int mln_stats_gauge_register(char *name) __NONNULL1(1);
+extern int mln_stats_histogram_register(char *name, mln_u64_t *bounds, mln_u32_t n) __NONNULL2(1,2);
+/*
+ * mln_stats_init():
+ * Create the shared segment with n_workers slots for worker processes
+ * and one for the master. It is called by the multi-process framework
+ * before worker processes are forked. Nothing is created if nothing is
+ * registered.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_stats_init(mln_u32_t n_workers);
+extern void mln_stats_destroy(void);
+/*
+ * mln_stats_worker_set():
+ * Called in a worker process by the framework, then the worker process
+ * updates slot worker_id. A worker process whose worker_id >= n_workers,
+ * e.g. one forked by mln_fork_restart(), has no slot and updates nothing.
+ */
+extern void mln_stats_worker_set(mln_sauto_t worker_id);
+/*
+ * mln_stats_observe():
+ * Record v in the histogram id, ids of other types are ignored.
+ */
+extern void mln_stats_observe(int id, mln_u64_t v);
+/*
+ * mln_stats_get():
+ * slot is worker_id for a worker process, n_workers for
+ * the master process, or -1 for the sum of all slots.
+ * For a histogram, the count of all observed values is returned.
+ */
+extern mln_u64_t mln_stats_get(int id, mln_sauto_t slot);
+/*
+ * mln_stats_dump():
+ * Write the sums of all registered items to fd as text lines.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_stats_dump(int fd);
+
+#endif
+
@@ -9,8 +9,10 @@
 #include "mln_string.h"
 #include "mln_event.h"
 #include "mln_rbtree.h"
+#include "mln_queue.h"
 
 #define THREAD_SOCKFD_LEN 128
+#define M_THREAD_CHAN_QLEN 1024
 
 typedef int (*tentrance)(int, char **);
 
@@ -33,6 +35,7 @@ struct mln_thread_attr {
     int                        argc;
     int                        peerfd;
     int                        sockfd;
+    mln_u32_t                  id;/*used to choose CPU affinity*/
     enum thread_stype          stype;
 };
 
@@ -68,6 +71,7 @@ struct mln_thread_s {
     char                     **argv;
     int                        argc;
     int                        peerfd;
+    mln_u32_t                  id;
     int                        is_created;
     enum thread_stype          stype;
     pthread_t                  tid;
@@ -79,6 +83,27 @@ struct mln_thread_s {
     mln_rbtree_node_t         *node;
 };
 
+/*
+ * Channel, a named bounded queue used to send pointers to a thread
+ * directly. Senders never block and the main thread is not involved.
+ */
+typedef struct mln_thread_chan_s mln_thread_chan_t;
+typedef void (*mln_thread_chan_handler)(mln_event_t *, mln_thread_chan_t *, void *, void *);
+
+struct mln_thread_chan_s {
+    mln_string_t              *name;
+    mln_queue_ring_t          *ring;
+    int                        rfd;
+    int                        wfd;
+    mln_event_t               *ev;
+    mln_thread_chan_handler    handler;
+    void                      *data;
+    struct mln_thread_chan_s  *prev;
+    struct mln_thread_chan_s  *next;
+    char                       pad[M_CACHELINE_SIZE];
+    mln_u32_t                  notified;/*written by all senders*/
+};
+
 extern void mln_thread_clear_msg(mln_thread_msg_t *msg);
 extern int mln_load_thread(mln_event_t *ev) __NONNULL1(1);
 extern int mln_thread_create(mln_thread_t *t, mln_event_t *ev) __NONNULL2(1,2);
@@ -92,5 +117,36 @@ extern void mln_thread_exit(int exit_code);
 extern void mln_thread_kill(mln_string_t *alias);
 extern void mln_thread_cleanup_set(void (*tcleanup)(void *), void *data);
 extern void mln_thread_module_set(mln_thread_module_t *modules, mln_size_t num);
+/*
+ * mln_thread_chan_open() returns the channel named 'name', and creates it
+ * with qlen slots (0 for M_THREAD_CHAN_QLEN) if it does not exist.
+ * mln_thread_chan_get() only looks it up, returns NULL if not existent.
+ * Both can be called in any thread.
+ */
+extern mln_thread_chan_t *mln_thread_chan_open(mln_string_t *name, mln_u32_t qlen) __NONNULL1(1);
+extern mln_thread_chan_t *mln_thread_chan_get(mln_string_t *name) __NONNULL1(1);
+/*
+ * mln_thread_chan_close() should be called after no thread uses chan,
+ * and after the receiver called mln_thread_chan_unset_event().
+ */
+extern void mln_thread_chan_close(mln_thread_chan_t *chan);
+/*
+ * Called by the receiver thread to handle messages in its own event.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int
+mln_thread_chan_set_event(mln_thread_chan_t *chan, \
+                          mln_event_t *ev, \
+                          mln_thread_chan_handler handler, \
+                          void *data) __NONNULL3(1,2,3);
+/*
+ * Called by the receiver thread on its own event before the event is freed
+ * or the thread exits, then another thread can take chan over.
+ */
+extern void mln_thread_chan_unset_event(mln_thread_chan_t *chan, mln_event_t *ev) __NONNULL2(1,2);
+/*
+ * return value: 0 - succeed   -1 - chan is full
+ */
+extern int mln_thread_chan_send(mln_thread_chan_t *chan, void *msg) __NONNULL2(1,2);
 #endif
 
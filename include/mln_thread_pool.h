@@ -13,6 +13,19 @@
 #include <pthread.h>
 #include "mln_types.h"
 #include "mln_string.h"
+#include "mln_event.h"
+#include "mln_affinity.h"
+
+/*
+ * Work stealing mode:
+ * Every thread owns a Chase-Lev deque, resources added by a thread
+ * go to its own deque. A child thread takes resources from the bottom
+ * of its own deque, and steals from the top of others' deques if its
+ * own is empty. Idle child threads spin for M_THREAD_POOL_SPIN rounds,
+ * then park until new resources are added.
+ */
+#define M_THREAD_POOL_DEQUE_LEN      256
+#define M_THREAD_POOL_SPIN           64
 
 typedef struct mln_thread_pool_s mln_thread_pool_t;
 
@@ -21,12 +34,30 @@ typedef void (*mln_thread_data_free)(void *);
 
 typedef struct mln_thread_pool_resource_s {
     void                              *data;
+    mln_u64_t                          tm;/*us, only set if latency is set*/
     struct mln_thread_pool_resource_s *next;
 } mln_thread_pool_resource_t;
 
+typedef struct mln_thread_pool_array_s {
+    mln_sauto_t                        mask;
+    struct mln_thread_pool_array_s    *retired;
+    void                              *buf[];
+} mln_thread_pool_array_t;
+
+typedef struct {
+    mln_sauto_t                        top;
+    char                               pad0[M_CACHELINE_SIZE - sizeof(mln_sauto_t)];
+    mln_sauto_t                        bottom;
+    mln_thread_pool_array_t           *array;
+    char                               pad1[M_CACHELINE_SIZE - sizeof(mln_sauto_t) - sizeof(void *)];
+} mln_thread_pool_deque_t;
+
 typedef struct mln_thread_pool_member_s {
     void                              *data;
     mln_thread_pool_t                 *pool;
+    mln_thread_pool_deque_t           *deque;
+    mln_affinity_t                    *affinity;
+    mln_u32_t                          seed;
     mln_u32_t                          idle:1;
     mln_u32_t                          locked:1;
     mln_u32_t                          forked:1;
@@ -38,18 +69,28 @@ typedef struct mln_thread_pool_member_s {
 struct mln_thread_pool_s {
     pthread_mutex_t                    mutex;
     pthread_cond_t                     cond;
+    pthread_cond_t                     exit_cond;
     pthread_attr_t                     attr;
     mln_thread_pool_resource_t        *res_chain_head;
     mln_thread_pool_resource_t        *res_chain_tail;
     mln_thread_pool_member_t          *child_head;
     mln_thread_pool_member_t          *child_tail;
     mln_u32_t                          max;
+    mln_u32_t                          min;
     mln_u32_t                          idle;
     mln_u32_t                          counter;
-    mln_u32_t                          quit:1;
+    mln_u32_t                          quit;
+    mln_u32_t                          work_stealing:1;
     mln_u32_t                          padding:31;
+    mln_u32_t                          sleepers;
     mln_u64_t                          cond_timeout;/*ms*/
+    mln_u64_t                          latency;/*us*/
+    mln_u64_t                          shrink_tm;/*us, the last time a child thread exited for idle*/
     mln_size_t                         n_res;
+    mln_thread_pool_deque_t           *deques;/*max+1 deques, the last one is main thread's*/
+    mln_affinity_t                    *affinity;
+    mln_u32_t                          n_affinity;
+    mln_u32_t                          affinity_seq;
     mln_thread_process                 process_handler;
     mln_thread_data_free               free_handler;
 };
@@ -60,8 +101,35 @@ struct mln_thread_pool_attr {
     mln_thread_process                 main_process_handler;
     mln_thread_data_free               free_handler;
     mln_u64_t                          cond_timeout; /*ms*/
+    mln_u64_t                          latency; /*ms, 0 means no latency based spawning*/
     mln_u32_t                          max;
+    mln_u32_t                          min;/*child threads created at the beginning and kept until the pool quits*/
     mln_u32_t                          concurrency;
+    mln_u32_t                          work_stealing;
+    mln_affinity_t                    *affinity;/*child threads are pinned to them in turn, can be NULL*/
+    mln_u32_t                          n_affinity;
+};
+
+/*
+ * Future:
+ * A join counter of a group of resources. Child threads call
+ * mln_thread_pool_future_done() once a resource is processed,
+ * the last one wakes up the waiters and notifies the event loop
+ * through an eventfd (a socketpair if eventfd is not supported).
+ */
+typedef struct mln_thread_pool_future_s mln_thread_pool_future_t;
+typedef void (*mln_thread_pool_future_handler)(mln_event_t *, mln_thread_pool_future_t *, void *);
+
+struct mln_thread_pool_future_s {
+    mln_u32_t                          pending;
+    mln_u32_t                          completed;
+    int                                rfd;
+    int                                wfd;
+    pthread_mutex_t                    lock;
+    pthread_cond_t                     cond;
+    mln_event_t                       *ev;
+    mln_thread_pool_future_handler     handler;
+    void                              *data;
 };
 
 struct mln_thread_pool_info {
@@ -72,7 +140,37 @@ struct mln_thread_pool_info {
 };
 
 extern int mln_thread_pool_run(struct mln_thread_pool_attr *tpattr) __NONNULL1(1);
+/*
+ * mln_thread_pool_resource_add():
+ * In work stealing mode, all threads in the pool can call it.
+ */
 extern int mln_thread_pool_resource_add(void *data) __NONNULL1(1);
+/*
+ * mln_thread_pool_resource_add_batch():
+ * Add n resources with only one lock acquisition.
+ * Either all of them are added, or none of them.
+ */
+extern int mln_thread_pool_resource_add_batch(void **data, mln_size_t n) __NONNULL1(1);
 extern void mln_thread_quit(void);
 extern void mln_thread_resource_info(struct mln_thread_pool_info *info);
+
+#define mln_thread_pool_future_pending(f) (__atomic_load_n(&((f)->pending), __ATOMIC_ACQUIRE))
+extern mln_thread_pool_future_t *mln_thread_pool_future_new(mln_u32_t n);
+extern void mln_thread_pool_future_free(mln_thread_pool_future_t *f);
+/*
+ * mln_thread_pool_future_add():
+ * Should be called before the future is completed.
+ */
+extern void mln_thread_pool_future_add(mln_thread_pool_future_t *f, mln_u32_t n) __NONNULL1(1);
+extern void mln_thread_pool_future_done(mln_thread_pool_future_t *f) __NONNULL1(1);
+extern void mln_thread_pool_future_wait(mln_thread_pool_future_t *f) __NONNULL1(1);
+/*
+ * mln_thread_pool_future_set_event():
+ * The handler will be called in the event loop once the future is completed.
+ * return value: 0 - succeed   -1 - failed
+ */
+extern int mln_thread_pool_future_set_event(mln_thread_pool_future_t *f, \
+                                            mln_event_t *ev, \
+                                            mln_thread_pool_future_handler handler, \
+                                            void *data) __NONNULL3(1,2,3);
 #endif
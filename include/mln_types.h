@@ -65,5 +65,12 @@ typedef long                  mln_sauto_t;
 typedef unsigned long         mln_uauto_t;
 #endif
 
+#define M_CACHELINE_SIZE 64
+#if defined(__x86_64__) || defined(__i386__)
+#define mln_cpu_pause() __asm__ __volatile__("pause")
+#else
+#define mln_cpu_pause()
+#endif
+
 #endif
 
@@ -0,0 +1,211 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mln_affinity.h"
+#include "mln_conf.h"
+#include "mln_log.h"
+
+#define M_AFFINITY_MPOL_PREFERRED 1
+#define M_AFFINITY_NODE_PATH      "/sys/devices/system/node/node%d/cpulist"
+#define mln_affinity_isdigit(c)   ((c) >= '0' && (c) <= '9')
+
+static int mln_affinity_cpulist_parse(mln_affinity_t *aff, char *p, char *end) __NONNULL3(1,2,3);
+static int mln_affinity_node_parse(mln_affinity_t *aff, int node) __NONNULL1(1);
+
+
+int mln_affinity_cpu_num(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return n > M_AFFINITY_CPU_MAX? M_AFFINITY_CPU_MAX: (int)n;
+#endif
+    return 1;
+}
+
+void mln_affinity_zero(mln_affinity_t *aff)
+{
+    memset(aff->bits, 0, sizeof(aff->bits));
+    aff->node = M_AFFINITY_NO_NODE;
+}
+
+/*
+ * Both configuration and sysfs use the format "0-3,8,10-11".
+ */
+static int mln_affinity_cpulist_parse(mln_affinity_t *aff, char *p, char *end)
+{
+    int lo, hi, n = 0;
+
+    while (p < end && (*p == ' ' || *p == '\n')) ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\n')) --end;
+
+    while (p < end) {
+        if (!mln_affinity_isdigit(*p)) return -1;
+        for (lo = 0; p < end && mln_affinity_isdigit(*p); ++p) {
+            if ((lo = lo * 10 + (*p - '0')) >= M_AFFINITY_CPU_MAX) return -1;
+        }
+        hi = lo;
+        if (p < end && *p == '-') {
+            if (++p >= end || !mln_affinity_isdigit(*p)) return -1;
+            for (hi = 0; p < end && mln_affinity_isdigit(*p); ++p) {
+                if ((hi = hi * 10 + (*p - '0')) >= M_AFFINITY_CPU_MAX) return -1;
+            }
+            if (hi < lo) return -1;
+        }
+        for (; lo <= hi; ++lo, ++n) mln_affinity_cpu_set(aff, lo);
+        if (p < end && (*p++ != ',' || p >= end)) return -1;
+    }
+    return n? 0: -1;
+}
+
+static int mln_affinity_node_parse(mln_affinity_t *aff, int node)
+{
+    FILE *fp;
+    mln_size_t len;
+    char path[128], buf[1024];
+
+    snprintf(path, sizeof(path), M_AFFINITY_NODE_PATH, node);
+    if ((fp = fopen(path, "r")) == NULL) return -1;
+    len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if (!len || len >= sizeof(buf)) return -1;
+
+    if (mln_affinity_cpulist_parse(aff, buf, buf + len) < 0) return -1;
+    aff->node = node;
+    return 0;
+}
+
+int mln_affinity_parse(mln_affinity_t *aff, mln_string_t *s)
+{
+    int node = 0;
+    char *p = (char *)(s->data), *end = p + s->len;
+
+    mln_affinity_zero(aff);
+
+    if (s->len > 4 && !strncmp(p, "node", 4)) {
+        for (p += 4; p < end; ++p) {
+            if (!mln_affinity_isdigit(*p)) return -1;
+            if ((node = node * 10 + (*p - '0')) >= M_AFFINITY_NODE_MAX) return -1;
+        }
+        return mln_affinity_node_parse(aff, node);
+    }
+    return mln_affinity_cpulist_parse(aff, p, end);
+}
+
+int mln_affinity_bind(mln_affinity_t *aff)
+{
+#if defined(__linux__)
+    int i, rc;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < M_AFFINITY_CPU_MAX && i < CPU_SETSIZE; ++i) {
+        if (mln_affinity_cpu_isset(aff, i)) CPU_SET(i, &set);
+    }
+    if (!CPU_COUNT(&set)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+        errno = rc;
+        return -1;
+    }
+#if defined(SYS_set_mempolicy)
+    if (aff->node != M_AFFINITY_NO_NODE) {
+        /*
+         * Memory is allocated from the local node of the CPU that touches it
+         * at first by default, preferring the node also covers the memory
+         * touched before the thread is migrated.
+         */
+        unsigned long mask[M_AFFINITY_NODE_MAX / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[aff->node / (8 * sizeof(unsigned long))] |= 1UL << (aff->node % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_set_mempolicy, M_AFFINITY_MPOL_PREFERRED, mask, M_AFFINITY_NODE_MAX + 1) < 0)
+            return -1;
+    }
+#endif
+    return 0;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int mln_affinity_conf_load(char *cmd_name, mln_affinity_t **affs, mln_u32_t *n)
+{
+    mln_u32_t i, nargs;
+    mln_affinity_t *a;
+    mln_conf_item_t *ci;
+    mln_conf_cmd_t *cc;
+    mln_conf_domain_t *cd;
+    mln_conf_t *cf = mln_get_conf();
+
+    *affs = NULL;
+    *n = 0;
+    if (cf == NULL) {
+        mln_log(error, "configuration messed up!\n");
+        return -1;
+    }
+    if ((cd = cf->search(cf, "main")) == NULL) {
+        mln_log(error, "Domain 'main' NOT existed.\n");
+        return -1;
+    }
+    if ((cc = cd->search(cd, cmd_name)) == NULL) return 0;
+
+    if (!(nargs = mln_conf_get_narg(cc))) {
+        mln_log(error, "'%s' need arguments.\n", cmd_name);
+        return -1;
+    }
+    ci = cc->search(cc, 1);
+    if (ci->type == CONF_BOOL) {
+        if (nargs > 1) {
+            mln_log(error, "Too many arguments follow '%s'.\n", cmd_name);
+            return -1;
+        }
+        if (!ci->val.b) return 0;
+        nargs = mln_affinity_cpu_num();
+    }
+
+    if ((a = (mln_affinity_t *)malloc(nargs * sizeof(mln_affinity_t))) == NULL) {
+        mln_log(error, "No memory.\n");
+        return -1;
+    }
+    for (i = 0; i < nargs; ++i) {
+        mln_affinity_zero(&a[i]);
+        if (ci->type == CONF_BOOL) {
+            mln_affinity_cpu_set(&a[i], i);
+            continue;
+        }
+        ci = cc->search(cc, i + 1);
+        if (ci->type == CONF_INT) {
+            if (ci->val.i < 0 || ci->val.i >= M_AFFINITY_CPU_MAX) goto err;
+            mln_affinity_cpu_set(&a[i], ci->val.i);
+        } else if (ci->type == CONF_STR) {
+            if (mln_affinity_parse(&a[i], ci->val.s) < 0) goto err;
+        } else {
+            goto err;
+        }
+    }
+    *affs = a;
+    *n = nargs;
+    return 0;
+
+err:
+    mln_log(error, "Invalid argument No.%u of '%s'.\n", i + 1, cmd_name);
+    free(a);
+    return -1;
+}
+
@@ -6,6 +6,10 @@
 #include "mln_alloc.h"
 #include "mln_defs.h"
 #include "mln_log.h"
+#include <assert.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 
 MLN_CHAIN_FUNC_DECLARE(mln_blk, \
@@ -27,6 +31,25 @@ static inline int mln_alloc_shm_allowed(mln_alloc_shm_t *as, mln_off_t *Boff, ml
 static inline void *mln_alloc_shm_set_bitmap(mln_alloc_shm_t *as, mln_off_t Boff, mln_off_t boff, mln_size_t size);
 static inline mln_alloc_shm_t *mln_alloc_shm_new_block(mln_alloc_t *pool, mln_off_t *Boff, mln_off_t *boff, mln_size_t size);
 static inline void mln_alloc_free_shm(void *ptr);
+static inline void mln_alloc_free_blk(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_alloc_mgr_t *am);
+static inline mln_size_t mln_alloc_chunk_release(mln_alloc_t *pool, mln_alloc_mgr_t *am, mln_alloc_chunk_t *ch);
+static inline void *mln_alloc_m_inner(mln_alloc_t *pool, mln_size_t size, void *caller);
+static inline void mln_alloc_prof_alloc(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_size_t idx, void *caller);
+static inline void mln_alloc_prof_free(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_size_t idx);
+static int mln_alloc_prof_leak_report(void *ptr, mln_size_t blk_size, void *caller, void *data);
+
+#if defined(__GNUC__)
+#define mln_alloc_caller() __builtin_return_address(0)
+#else
+#define mln_alloc_caller() NULL
+#endif
+
+/*
+ * Blocks in a chunk are placed at multiples of the alignment of
+ * mln_alloc_blk_t, the compiler may use aligned stores on the header.
+ */
+#define mln_alloc_blk_stride(bs) \
+    ((sizeof(mln_alloc_blk_t) + (bs) + __alignof__(mln_alloc_blk_t) - 1) & ~((mln_size_t)__alignof__(mln_alloc_blk_t) - 1))
 
 static inline mln_alloc_shm_t *mln_alloc_shm_new(mln_alloc_t *pool, mln_size_t size, int is_large)
 {
@@ -122,7 +145,7 @@ mln_alloc_t *mln_alloc_shm_init(struct mln_alloc_shm_attr_s *attr)
 #else
 
     pool = (mln_alloc_t *)mmap(NULL, attr->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
-    if (pool == NULL) return NULL;
+    if (pool == MAP_FAILED) return NULL;
 #endif
     pool->parent = NULL;
     pool->large_used_head = pool->large_used_tail = NULL;
@@ -132,6 +155,8 @@ mln_alloc_t *mln_alloc_shm_init(struct mln_alloc_shm_attr_s *attr)
     pool->locker = attr->locker;
     pool->lock = attr->lock;
     pool->unlock = attr->unlock;
+    pool->prof = NULL;
+    pool->trim_epoch = 0;
     return pool;
 }
 
@@ -160,6 +185,8 @@ mln_alloc_t *mln_alloc_init(mln_alloc_t *parent)
     pool->locker = NULL;
     pool->lock = NULL;
     pool->unlock = NULL;
+    pool->prof = NULL;
+    pool->trim_epoch = 0;
     return pool;
 }
 
@@ -179,12 +206,14 @@ mln_alloc_mgr_table_init(mln_alloc_mgr_t *tbl)
         am->used_head = am->used_tail = NULL;
         am->chunk_head = am->chunk_tail = NULL;
         am->blk_size = blk_size + 1;
+        am->blk_num = M_ALLOC_BLK_NUM;
         if (i != 0) {
             amprev = &tbl[i-1];
             amprev->free_head = amprev->free_tail = NULL;
             amprev->used_head = amprev->used_tail = NULL;
             amprev->chunk_head = amprev->chunk_tail = NULL;
             amprev->blk_size = (am->blk_size + tbl[i-2].blk_size) >> 1;
+            amprev->blk_num = M_ALLOC_BLK_NUM;
         }
     }
 }
@@ -198,6 +227,11 @@ void mln_alloc_destroy(mln_alloc_t *pool)
         if (parent->lock(parent->locker) != 0)
             return;
     if (pool->mem == NULL) {
+        if (pool->prof != NULL) {
+            (void)mln_alloc_prof_scan(pool, mln_alloc_prof_leak_report, NULL);
+            free(pool->prof);
+            pool->prof = NULL;
+        }
         mln_alloc_mgr_t *am, *amend;
         amend = pool->mgr_tbl + M_ALLOC_MGR_LEN;
         mln_alloc_chunk_t *ch;
@@ -229,6 +263,11 @@ void mln_alloc_destroy(mln_alloc_t *pool)
 }
 
 void *mln_alloc_m(mln_alloc_t *pool, mln_size_t size)
+{
+    return mln_alloc_m_inner(pool, size, mln_alloc_caller());
+}
+
+static inline void *mln_alloc_m_inner(mln_alloc_t *pool, mln_size_t size, void *caller)
 {
     mln_alloc_blk_t *blk;
     mln_alloc_mgr_t *am;
@@ -268,15 +307,19 @@ void *mln_alloc_m(mln_alloc_t *pool, mln_size_t size)
         blk->blk_size = size - (sizeof(mln_alloc_chunk_t) + sizeof(mln_alloc_blk_t));
         blk->is_large = 1;
         blk->in_used = 1;
-        ch->blks[0] = blk;
+        blk->is_aligned = 0;
+        blk->caller = NULL;
+        if (pool->prof != NULL) {
+            ++(pool->prof->classes[M_ALLOC_MGR_LEN].nchunk_alloc);
+            mln_alloc_prof_alloc(pool, blk, M_ALLOC_MGR_LEN, caller);
+        }
         return blk->data;
     }
 
     if (am->free_head == NULL) {
-        n = (sizeof(mln_alloc_blk_t) + am->blk_size + 3) >> 2;
-        size = n << 2;
+        size = mln_alloc_blk_stride(am->blk_size);
 
-        n = (sizeof(mln_alloc_chunk_t) + M_ALLOC_BLK_NUM * size + 3) >> 2;
+        n = (sizeof(mln_alloc_chunk_t) + am->blk_num * size + 3) >> 2;
 
         if (pool->parent != NULL) {
             if (mln_alloc_is_shm(pool->parent)) {
@@ -298,18 +341,26 @@ void *mln_alloc_m(mln_alloc_t *pool, mln_size_t size)
         }
         ch = (mln_alloc_chunk_t *)ptr;
         ch->mgr = am;
+        ch->blk_num = am->blk_num;
         mln_chunk_chain_add(&(am->chunk_head), &(am->chunk_tail), ch);
         ptr += sizeof(mln_alloc_chunk_t);
-        for (n = 0; n < M_ALLOC_BLK_NUM; ++n) {
+        for (n = 0; n < ch->blk_num; ++n) {
             blk = (mln_alloc_blk_t *)ptr;
             blk->data = ptr + sizeof(mln_alloc_blk_t);
             blk->chunk = ch;
             blk->pool = pool;
             blk->blk_size = am->blk_size;
-            ch->blks[n] = blk;
             ptr += size;
             mln_blk_chain_add(&(am->free_head), &(am->free_tail), blk);
         }
+        /*
+         * Every time a class runs dry, its next chunk is twice as large,
+         * so busy classes take fewer and larger chunks from the parent.
+         */
+        if (am->blk_num < M_ALLOC_BLK_NUM_MAX && (am->blk_num << 1) * size <= M_ALLOC_CHUNK_GROW_SIZE)
+            am->blk_num <<= 1;
+        if (pool->prof != NULL)
+            ++(pool->prof->classes[am - pool->mgr_tbl].nchunk_alloc);
     }
 
 out:
@@ -317,7 +368,11 @@ out:
     mln_blk_chain_del(&(am->free_head), &(am->free_tail), blk);
     mln_blk_chain_add(&(am->used_head), &(am->used_tail), blk);
     blk->in_used = 1;
+    blk->is_aligned = 0;
+    blk->caller = NULL;
     ++(blk->chunk->refer);
+    if (pool->prof != NULL)
+        mln_alloc_prof_alloc(pool, blk, am - pool->mgr_tbl, caller);
     return blk->data;
 }
 
@@ -350,12 +405,43 @@ mln_alloc_get_mgr_by_size(mln_alloc_mgr_t *tbl, mln_size_t size)
 
 void *mln_alloc_c(mln_alloc_t *pool, mln_size_t size)
 {
-    mln_u8ptr_t ptr = mln_alloc_m(pool, size);
+    mln_u8ptr_t ptr = mln_alloc_m_inner(pool, size, mln_alloc_caller());
     if (ptr == NULL) return NULL;
     memset(ptr, 0, size);
     return ptr;
 }
 
+/*
+ * The block is over-allocated so that an aligned address with room for
+ * a shadow header in front of it always exists inside it. The shadow header
+ * only records the original data address, which mln_alloc_free follows.
+ */
+void *mln_alloc_aligned(mln_alloc_t *pool, mln_size_t size, mln_size_t align)
+{
+    mln_u8ptr_t ptr, aligned;
+    mln_alloc_blk_t *blk, *shadow;
+
+    if (align == 0 || (align & (align - 1)))
+        return NULL;
+
+    ptr = (mln_u8ptr_t)mln_alloc_m_inner(pool, size + align - 1 + sizeof(mln_alloc_blk_t), mln_alloc_caller());
+    if (ptr == NULL) return NULL;
+    if (!((mln_uptr_t)ptr & (align - 1))) return ptr;
+
+    blk = (mln_alloc_blk_t *)(ptr - sizeof(mln_alloc_blk_t));
+    aligned = (mln_u8ptr_t)(((mln_uptr_t)ptr + sizeof(mln_alloc_blk_t) + align - 1) & ~((mln_uptr_t)align - 1));
+    shadow = (mln_alloc_blk_t *)(aligned - sizeof(mln_alloc_blk_t));
+    memset(shadow, 0, sizeof(mln_alloc_blk_t));
+    shadow->pool = pool;
+    shadow->data = ptr;
+    shadow->chunk = blk->chunk;
+    shadow->blk_size = size;
+    shadow->is_large = blk->is_large;
+    shadow->is_aligned = 1;
+    shadow->in_used = 1;
+    return aligned;
+}
+
 void *mln_alloc_re(mln_alloc_t *pool, void *ptr, mln_size_t size)
 {
     if (size == 0) {
@@ -368,7 +454,7 @@ void *mln_alloc_re(mln_alloc_t *pool, void *ptr, mln_size_t size)
         return ptr;
     }
 
-    mln_u8ptr_t new_ptr = mln_alloc_m(pool, size);
+    mln_u8ptr_t new_ptr = mln_alloc_m_inner(pool, size, mln_alloc_caller());
     if (new_ptr == NULL) return NULL;
     memcpy(new_ptr, ptr, old_blk->blk_size);
     mln_alloc_free(ptr);
@@ -383,8 +469,6 @@ void mln_alloc_free(void *ptr)
     }
 
     mln_alloc_t *pool;
-    mln_alloc_chunk_t *ch;
-    mln_alloc_mgr_t *am;
     mln_alloc_blk_t *blk;
 
     blk = (mln_alloc_blk_t *)((mln_u8ptr_t)ptr - sizeof(mln_alloc_blk_t));
@@ -394,12 +478,64 @@ void mln_alloc_free(void *ptr)
         abort();
     }
 
+    if (blk->is_aligned) {
+        /*the shadow header would not be touched by others until the block is reused*/
+        blk->in_used = 0;
+        ptr = blk->data;
+        blk = (mln_alloc_blk_t *)((mln_u8ptr_t)ptr - sizeof(mln_alloc_blk_t));
+        if (!blk->in_used) {
+            mln_log(error, "Double free.\n");
+            abort();
+        }
+    }
+
     pool = blk->pool;
     if (pool->mem) {
         return mln_alloc_free_shm(ptr);
     }
 
-    if (blk->is_large) {
+    mln_alloc_free_blk(pool, blk, blk->is_large? NULL: blk->chunk->mgr);
+}
+
+void mln_alloc_free_sized(mln_alloc_t *pool, void *ptr, mln_size_t size)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    mln_alloc_mgr_t *am;
+    mln_alloc_blk_t *blk;
+
+    blk = (mln_alloc_blk_t *)((mln_u8ptr_t)ptr - sizeof(mln_alloc_blk_t));
+
+    if (!blk->in_used) {
+        mln_log(error, "Double free.\n");
+        abort();
+    }
+
+    if (pool->mem != NULL || blk->is_aligned) {
+        return mln_alloc_free(ptr);
+    }
+
+    /*
+     * The size class is derived from the size given by the caller rather than
+     * from the chunk. The block header is still written to put it back into
+     * the free list, and its chunk to drop the reference count.
+     */
+    am = mln_alloc_get_mgr_by_size(pool->mgr_tbl, size);
+    assert(blk->pool == pool && am == (blk->is_large? NULL: blk->chunk->mgr));
+    mln_alloc_free_blk(pool, blk, am);
+}
+
+static inline void mln_alloc_free_blk(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_alloc_mgr_t *am)
+{
+    mln_alloc_chunk_t *ch;
+
+    if (am == NULL) {
+        if (pool->prof != NULL) {
+            mln_alloc_prof_free(pool, blk, M_ALLOC_MGR_LEN);
+            ++(pool->prof->classes[M_ALLOC_MGR_LEN].nchunk_free);
+        }
         mln_chunk_chain_del(&(pool->large_used_head), &(pool->large_used_tail), blk->chunk);
         if (pool->parent != NULL) {
             if (mln_alloc_is_shm(pool->parent)) {
@@ -416,29 +552,82 @@ void mln_alloc_free(void *ptr)
         return;
     }
     ch = blk->chunk;
-    am = ch->mgr;
+    if (pool->prof != NULL)
+        mln_alloc_prof_free(pool, blk, am - pool->mgr_tbl);
     blk->in_used = 0;
     mln_blk_chain_del(&(am->used_head), &(am->used_tail), blk);
     mln_blk_chain_add(&(am->free_head), &(am->free_tail), blk);
-    if (!--(ch->refer) && ++(ch->count) > M_ALLOC_CHUNK_COUNT) {
-        mln_alloc_blk_t **blks = ch->blks;
-        while (*blks != NULL) {
-            mln_blk_chain_del(&(am->free_head), &(am->free_tail), *(blks++));
-        }
-        mln_chunk_chain_del(&(am->chunk_head), &(am->chunk_tail), ch);
-        if (pool->parent != NULL) {
-            if (mln_alloc_is_shm(pool->parent)) {
-                if (pool->parent->lock(pool->parent->locker) != 0) {
-                    return;
-                }
-            }
-            mln_alloc_free(ch);
-            if (mln_alloc_is_shm(pool->parent)) {
-                (void)pool->parent->unlock(pool->parent->locker);
+    if (!--(ch->refer)) {
+        ch->idle_epoch = pool->trim_epoch;
+        if (++(ch->count) > M_ALLOC_CHUNK_COUNT)
+            (void)mln_alloc_chunk_release(pool, am, ch);
+    }
+}
+
+/*
+ * Detach an idle chunk and its blocks from the manager and give it back to the parent pool or heap.
+ */
+static inline mln_size_t mln_alloc_chunk_release(mln_alloc_t *pool, mln_alloc_mgr_t *am, mln_alloc_chunk_t *ch)
+{
+    mln_size_t i, size, total;
+    mln_u8ptr_t ptr;
+
+    size = mln_alloc_blk_stride(am->blk_size);
+    total = sizeof(mln_alloc_chunk_t) + ch->blk_num * size;
+    ptr = (mln_u8ptr_t)mln_alloc_chunk_first_blk(ch);
+    for (i = 0; i < ch->blk_num; ++i, ptr += size) {
+        mln_blk_chain_del(&(am->free_head), &(am->free_tail), (mln_alloc_blk_t *)ptr);
+    }
+    mln_chunk_chain_del(&(am->chunk_head), &(am->chunk_tail), ch);
+    if (pool->prof != NULL)
+        ++(pool->prof->classes[am - pool->mgr_tbl].nchunk_free);
+    if (pool->parent != NULL) {
+        if (mln_alloc_is_shm(pool->parent)) {
+            if (pool->parent->lock(pool->parent->locker) != 0) {
+                return 0;
             }
-        } else
-            free(ch);
+        }
+        mln_alloc_free(ch);
+        if (mln_alloc_is_shm(pool->parent)) {
+            (void)pool->parent->unlock(pool->parent->locker);
+        }
+    } else
+        free(ch);
+    return total;
+}
+
+/*
+ * Every call opens a new trim period. Chunks that have stayed idle
+ * for at least 'decay' periods are returned to the parent pool or heap,
+ * and the chunk growth of their classes is halved.
+ * A decay of 0 returns all idle chunks.
+ */
+mln_size_t mln_alloc_trim(mln_alloc_t *pool, mln_size_t decay)
+{
+    mln_alloc_mgr_t *am, *amend;
+    mln_alloc_chunk_t *ch, *next;
+    mln_size_t total = 0, released;
+
+    if (mln_alloc_is_shm(pool)) return 0;
+
+    ++(pool->trim_epoch);
+    amend = pool->mgr_tbl + M_ALLOC_MGR_LEN;
+    for (am = pool->mgr_tbl; am < amend; ++am) {
+        released = 0;
+        for (ch = am->chunk_head; ch != NULL; ch = next) {
+            next = ch->next;
+            if (ch->refer || pool->trim_epoch - ch->idle_epoch < decay) continue;
+            released += mln_alloc_chunk_release(pool, am, ch);
+        }
+        if (released && am->blk_num > M_ALLOC_BLK_NUM)
+            am->blk_num >>= 1;
+        total += released;
     }
+#if defined(__GLIBC__)
+    if (total && pool->parent == NULL)
+        (void)malloc_trim(0);
+#endif
+    return total;
 }
 
 static inline void *mln_alloc_shm_m(mln_alloc_t *pool, mln_size_t size)
@@ -602,6 +791,159 @@ static inline void mln_alloc_free_shm(void *ptr)
     }
 }
 
+/*
+ * profiling
+ */
+int mln_alloc_prof_enable(mln_alloc_t *pool, mln_u32_t sample)
+{
+    mln_size_t i;
+    mln_alloc_blk_t *blk;
+    mln_alloc_chunk_t *ch;
+    mln_alloc_prof_t *prof;
+
+    if (mln_alloc_is_shm(pool)) return -1;
+    if (pool->prof != NULL) {
+        pool->prof->sample = sample;
+        return 0;
+    }
+
+    /*
+     * Counters are kept outside of the pool (and its parents)
+     * so that they never show up in their own statistics.
+     */
+    if ((prof = (mln_alloc_prof_t *)calloc(1, sizeof(mln_alloc_prof_t))) == NULL)
+        return -1;
+    prof->sample = sample;
+    for (i = 0; i < M_ALLOC_MGR_LEN; ++i) {
+        prof->classes[i].blk_size = pool->mgr_tbl[i].blk_size;
+    }
+    pool->prof = prof;
+
+    /*
+     * Blocks allocated before profiling was enabled are accounted as well,
+     * otherwise their release would drive the live counters negative.
+     */
+    for (i = 0; i < M_ALLOC_MGR_LEN; ++i) {
+        for (ch = pool->mgr_tbl[i].chunk_head; ch != NULL; ch = ch->next)
+            ++(prof->classes[i].nchunk_alloc);
+        for (blk = pool->mgr_tbl[i].used_head; blk != NULL; blk = blk->next)
+            mln_alloc_prof_alloc(pool, blk, i, NULL);
+    }
+    for (ch = pool->large_used_head; ch != NULL; ch = ch->next) {
+        ++(prof->classes[M_ALLOC_MGR_LEN].nchunk_alloc);
+        mln_alloc_prof_alloc(pool, mln_alloc_chunk_first_blk(ch), M_ALLOC_MGR_LEN, NULL);
+    }
+    return 0;
+}
+
+void mln_alloc_prof_disable(mln_alloc_t *pool)
+{
+    if (pool->prof == NULL) return;
+    free(pool->prof);
+    pool->prof = NULL;
+}
+
+const mln_alloc_prof_t *mln_alloc_prof_stat(mln_alloc_t *pool)
+{
+    return pool->prof;
+}
+
+static inline void mln_alloc_prof_alloc(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_size_t idx, void *caller)
+{
+    mln_alloc_prof_t *prof = pool->prof;
+    mln_alloc_prof_class_t *pc = &prof->classes[idx];
+
+    ++(pc->nalloc);
+    ++(pc->live_blks);
+    if ((pc->live_bytes += blk->blk_size) > pc->peak_bytes)
+        pc->peak_bytes = pc->live_bytes;
+    if ((prof->live_bytes += blk->blk_size) > prof->peak_bytes)
+        prof->peak_bytes = prof->live_bytes;
+    if (prof->sample && ++(prof->counter) >= prof->sample) {
+        prof->counter = 0;
+        blk->caller = caller;
+    }
+}
+
+static inline void mln_alloc_prof_free(mln_alloc_t *pool, mln_alloc_blk_t *blk, mln_size_t idx)
+{
+    mln_alloc_prof_t *prof = pool->prof;
+    mln_alloc_prof_class_t *pc = &prof->classes[idx];
+
+    ++(pc->nfree);
+    --(pc->live_blks);
+    pc->live_bytes -= blk->blk_size;
+    prof->live_bytes -= blk->blk_size;
+}
+
+/*
+ * Walk all in-used blocks of a heap pool, small classes first, then large blocks.
+ * Scanning stops if the callback returns non-zero.
+ */
+int mln_alloc_prof_scan(mln_alloc_t *pool, mln_alloc_prof_scan_cb_t cb, void *data)
+{
+    int i, ret;
+    mln_alloc_blk_t *blk;
+    mln_alloc_chunk_t *ch;
+
+    if (mln_alloc_is_shm(pool)) return -1;
+
+    for (i = 0; i < M_ALLOC_MGR_LEN; ++i) {
+        for (blk = pool->mgr_tbl[i].used_head; blk != NULL; blk = blk->next) {
+            if ((ret = cb(blk->data, blk->blk_size, blk->caller, data)) != 0)
+                return ret;
+        }
+    }
+    for (ch = pool->large_used_head; ch != NULL; ch = ch->next) {
+        blk = mln_alloc_chunk_first_blk(ch);
+        if ((ret = cb(blk->data, blk->blk_size, blk->caller, data)) != 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int mln_alloc_prof_leak_report(void *ptr, mln_size_t blk_size, void *caller, void *data)
+{
+    mln_log(warn, "Outstanding block 0x%X size %U caller 0x%X\n", \
+            (long)ptr, (unsigned long)blk_size, (long)caller);
+    return 0;
+}
+
+static int mln_alloc_prof_dump_blk(void *ptr, mln_size_t blk_size, void *caller, void *data)
+{
+    fprintf((FILE *)data, "    %p\t%lu\t%p\n", ptr, (unsigned long)blk_size, caller);
+    return 0;
+}
+
+void mln_alloc_prof_dump(mln_alloc_t *pool, FILE *fp)
+{
+    int i;
+    mln_alloc_prof_class_t *pc;
+    mln_alloc_prof_t *prof = pool->prof;
+
+    if (prof == NULL) {
+        fprintf(fp, "pool %p: profiling disabled\n", pool);
+        return;
+    }
+
+    fprintf(fp, "pool %p: live %lu bytes, peak %lu bytes, sample 1/%u\n", \
+            pool, (unsigned long)prof->live_bytes, (unsigned long)prof->peak_bytes, prof->sample);
+    fprintf(fp, "class\tnalloc\tnfree\tlive_blks\tlive_bytes\tpeak_bytes\tchunk_alloc\tchunk_free\n");
+    for (i = 0; i <= M_ALLOC_MGR_LEN; ++i) {
+        pc = &prof->classes[i];
+        if (!pc->nalloc && !pc->nchunk_alloc) continue;
+        if (i == M_ALLOC_MGR_LEN) fprintf(fp, "large");
+        else fprintf(fp, "%lu", (unsigned long)pc->blk_size);
+        fprintf(fp, "\t%llu\t%llu\t%lu\t%lu\t%lu\t%llu\t%llu\n", \
+                (unsigned long long)pc->nalloc, (unsigned long long)pc->nfree, \
+                (unsigned long)pc->live_blks, (unsigned long)pc->live_bytes, \
+                (unsigned long)pc->peak_bytes, \
+                (unsigned long long)pc->nchunk_alloc, (unsigned long long)pc->nchunk_free);
+    }
+    fprintf(fp, "live blocks (address\tsize\tcaller):\n");
+    (void)mln_alloc_prof_scan(pool, mln_alloc_prof_dump_blk, fp);
+}
+
 /*
  * chain
  */
@@ -0,0 +1,601 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mln_btree.h"
+
+#define mln_btree_leaf(n)  ((mln_btree_leaf_t *)(n))
+#define mln_btree_inner(n) ((mln_btree_inner_t *)(n))
+
+static inline mln_btree_node_t *
+mln_btree_node_new(mln_btree_t *t, int leaf) __NONNULL1(1);
+static inline void
+mln_btree_node_free(mln_btree_t *t, mln_btree_node_t *n) __NONNULL2(1,2);
+static void
+mln_btree_node_destroy(mln_btree_t *t, mln_btree_node_t *n) __NONNULL2(1,2);
+static inline mln_u32_t
+mln_btree_lower_index(mln_btree_t *t, mln_btree_node_t *n, const void *key) __NONNULL3(1,2,3);
+static inline mln_u32_t
+mln_btree_upper_index(mln_btree_t *t, mln_btree_node_t *n, const void *key) __NONNULL3(1,2,3);
+static inline mln_uauto_t
+mln_btree_node_count(mln_btree_node_t *n) __NONNULL1(1);
+static inline int
+mln_btree_split(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i) __NONNULL2(1,2);
+static inline void
+mln_btree_merge(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i) __NONNULL2(1,2);
+static inline void
+mln_btree_rebalance(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i) __NONNULL2(1,2);
+static void *
+mln_btree_remove_recursive(mln_btree_t *t, mln_btree_node_t *n, const void *key) __NONNULL3(1,2,3);
+static inline mln_uauto_t
+mln_btree_load_nr_nodes(mln_uauto_t n);
+static void
+mln_btree_inner_release(mln_btree_t *t, mln_btree_node_t *n) __NONNULL2(1,2);
+
+mln_btree_t *
+mln_btree_init(struct mln_btree_attr *attr)
+{
+    mln_btree_t *t;
+
+    if (attr->cmp == NULL) return NULL;
+
+    if (attr->pool == NULL) {
+        t = (mln_btree_t *)malloc(sizeof(mln_btree_t));
+    } else {
+        t = (mln_btree_t *)attr->pool_alloc(attr->pool, sizeof(mln_btree_t));
+    }
+    if (t == NULL) return NULL;
+    t->pool = attr->pool;
+    t->pool_alloc = attr->pool_alloc;
+    t->pool_free = attr->pool_free;
+    t->cmp = attr->cmp;
+    t->data_free = attr->data_free;
+    t->root = t->head = t->tail = NULL;
+    t->nr_node = 0;
+    return t;
+}
+
+void mln_btree_destroy(mln_btree_t *t)
+{
+    if (t == NULL) return;
+
+    mln_btree_reset(t);
+    if (t->pool != NULL) t->pool_free(t);
+    else free(t);
+}
+
+void mln_btree_reset(mln_btree_t *t)
+{
+    if (t->root != NULL) mln_btree_node_destroy(t, t->root);
+    t->root = t->head = t->tail = NULL;
+    t->nr_node = 0;
+}
+
+static void mln_btree_node_destroy(mln_btree_t *t, mln_btree_node_t *n)
+{
+    mln_u32_t i;
+
+    if (n->leaf) {
+        if (t->data_free != NULL) {
+            for (i = 0; i < n->nr; ++i) t->data_free(n->keys[i]);
+        }
+    } else {
+        for (i = 0; i < n->nr; ++i) mln_btree_node_destroy(t, mln_btree_inner(n)->children[i]);
+    }
+    mln_btree_node_free(t, n);
+}
+
+static inline mln_btree_node_t *mln_btree_node_new(mln_btree_t *t, int leaf)
+{
+    mln_btree_node_t *n;
+    mln_size_t size = leaf? sizeof(mln_btree_leaf_t): sizeof(mln_btree_inner_t);
+
+    if (t->pool == NULL) n = (mln_btree_node_t *)malloc(size);
+    else n = (mln_btree_node_t *)t->pool_alloc(t->pool, size);
+    if (n == NULL) return NULL;
+    n->nr = 0;
+    n->leaf = leaf;
+    if (leaf) mln_btree_leaf(n)->prev = mln_btree_leaf(n)->next = NULL;
+    return n;
+}
+
+static inline void mln_btree_node_free(mln_btree_t *t, mln_btree_node_t *n)
+{
+    if (t->pool == NULL) free(n);
+    else t->pool_free(n);
+}
+
+/*
+ * The first index whose key is not less than key.
+ */
+static inline mln_u32_t mln_btree_lower_index(mln_btree_t *t, mln_btree_node_t *n, const void *key)
+{
+    mln_u32_t low = 0, high = n->nr, mid;
+
+    while (low < high) {
+        mid = (low + high) >> 1;
+        if (t->cmp(n->keys[mid], key) < 0) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/*
+ * The first index whose key is greater than key.
+ */
+static inline mln_u32_t mln_btree_upper_index(mln_btree_t *t, mln_btree_node_t *n, const void *key)
+{
+    mln_u32_t low = 0, high = n->nr, mid;
+
+    while (low < high) {
+        mid = (low + high) >> 1;
+        if (t->cmp(n->keys[mid], key) <= 0) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+static inline mln_uauto_t mln_btree_node_count(mln_btree_node_t *n)
+{
+    mln_u32_t i;
+    mln_uauto_t cnt = 0;
+
+    if (n->leaf) return n->nr;
+    for (i = 0; i < n->nr; ++i) cnt += mln_btree_inner(n)->counts[i];
+    return cnt;
+}
+
+/*
+ * Split the full child i of p into two halves.
+ */
+static inline int mln_btree_split(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i)
+{
+    mln_btree_inner_t *pi = mln_btree_inner(p);
+    mln_btree_node_t *c = pi->children[i], *n;
+    mln_u32_t half = c->nr >> 1, move = c->nr - half;
+    mln_uauto_t cnt;
+
+    if ((n = mln_btree_node_new(t, c->leaf)) == NULL) return -1;
+
+    memcpy(n->keys, c->keys + half, move * sizeof(void *));
+    n->nr = move;
+    c->nr = half;
+    if (c->leaf) {
+        mln_btree_leaf(n)->prev = c;
+        mln_btree_leaf(n)->next = mln_btree_leaf(c)->next;
+        if (mln_btree_leaf(c)->next != NULL) mln_btree_leaf(mln_btree_leaf(c)->next)->prev = n;
+        else t->tail = n;
+        mln_btree_leaf(c)->next = n;
+    } else {
+        memcpy(mln_btree_inner(n)->children, mln_btree_inner(c)->children + half, move * sizeof(mln_btree_node_t *));
+        memcpy(mln_btree_inner(n)->counts, mln_btree_inner(c)->counts + half, move * sizeof(mln_uauto_t));
+    }
+    cnt = mln_btree_node_count(n);
+
+    memmove(p->keys + i + 2, p->keys + i + 1, (p->nr - i - 1) * sizeof(void *));
+    memmove(pi->children + i + 2, pi->children + i + 1, (p->nr - i - 1) * sizeof(mln_btree_node_t *));
+    memmove(pi->counts + i + 2, pi->counts + i + 1, (p->nr - i - 1) * sizeof(mln_uauto_t));
+    p->keys[i + 1] = n->keys[0];
+    pi->children[i + 1] = n;
+    pi->counts[i + 1] = cnt;
+    pi->counts[i] -= cnt;
+    ++(p->nr);
+    return 0;
+}
+
+/*
+ * Full nodes are split on the way down, and counts and minimums are
+ * updated on a second pass along the recorded path, so the tree is
+ * still valid if a split fails.
+ */
+int mln_btree_insert(mln_btree_t *t, void *data)
+{
+    mln_btree_node_t *n, *path[M_BTREE_MAX_DEPTH];
+    mln_u32_t i, idx[M_BTREE_MAX_DEPTH], depth = 0, d;
+
+    if (t->root == NULL) {
+        if ((t->root = mln_btree_node_new(t, 1)) == NULL) return -1;
+        t->head = t->tail = t->root;
+    }
+    if (t->root->nr == M_BTREE_NODE_SIZE) {
+        if ((n = mln_btree_node_new(t, 0)) == NULL) return -1;
+        n->nr = 1;
+        n->keys[0] = t->root->keys[0];
+        mln_btree_inner(n)->children[0] = t->root;
+        mln_btree_inner(n)->counts[0] = t->nr_node;
+        if (mln_btree_split(t, n, 0) < 0) {
+            mln_btree_node_free(t, n);
+            return -1;
+        }
+        t->root = n;
+    }
+
+    for (n = t->root; !n->leaf; n = mln_btree_inner(n)->children[i]) {
+        if ((i = mln_btree_upper_index(t, n, data)) > 0) --i;
+        if (mln_btree_inner(n)->children[i]->nr == M_BTREE_NODE_SIZE) {
+            if (mln_btree_split(t, n, i) < 0) return -1;
+            if (t->cmp(data, n->keys[i + 1]) >= 0) ++i;
+        }
+        path[depth] = n;
+        idx[depth++] = i;
+    }
+
+    for (d = 0; d < depth; ++d) {
+        if (t->cmp(data, path[d]->keys[idx[d]]) < 0) path[d]->keys[idx[d]] = data;
+        ++(mln_btree_inner(path[d])->counts[idx[d]]);
+    }
+    i = mln_btree_upper_index(t, n, data);
+    memmove(n->keys + i + 1, n->keys + i, (n->nr - i) * sizeof(void *));
+    n->keys[i] = data;
+    ++(n->nr);
+    ++(t->nr_node);
+    return 0;
+}
+
+/*
+ * Merge child i + 1 of p into child i.
+ */
+static inline void mln_btree_merge(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i)
+{
+    mln_btree_inner_t *pi = mln_btree_inner(p);
+    mln_btree_node_t *l = pi->children[i], *r = pi->children[i + 1];
+
+    memcpy(l->keys + l->nr, r->keys, r->nr * sizeof(void *));
+    if (l->leaf) {
+        mln_btree_leaf(l)->next = mln_btree_leaf(r)->next;
+        if (mln_btree_leaf(r)->next != NULL) mln_btree_leaf(mln_btree_leaf(r)->next)->prev = l;
+        else t->tail = l;
+    } else {
+        memcpy(mln_btree_inner(l)->children + l->nr, mln_btree_inner(r)->children, r->nr * sizeof(mln_btree_node_t *));
+        memcpy(mln_btree_inner(l)->counts + l->nr, mln_btree_inner(r)->counts, r->nr * sizeof(mln_uauto_t));
+    }
+    l->nr += r->nr;
+    pi->counts[i] += pi->counts[i + 1];
+    mln_btree_node_free(t, r);
+
+    memmove(p->keys + i + 1, p->keys + i + 2, (p->nr - i - 2) * sizeof(void *));
+    memmove(pi->children + i + 1, pi->children + i + 2, (p->nr - i - 2) * sizeof(mln_btree_node_t *));
+    memmove(pi->counts + i + 1, pi->counts + i + 2, (p->nr - i - 2) * sizeof(mln_uauto_t));
+    --(p->nr);
+}
+
+/*
+ * Child i of p has less than M_BTREE_NODE_MIN entries,
+ * borrow one from a sibling or merge with it.
+ */
+static inline void mln_btree_rebalance(mln_btree_t *t, mln_btree_node_t *p, mln_u32_t i)
+{
+    mln_btree_inner_t *pi = mln_btree_inner(p);
+    mln_btree_node_t *c = pi->children[i], *s;
+    mln_uauto_t cnt;
+
+    if (i > 0 && (s = pi->children[i - 1])->nr > M_BTREE_NODE_MIN) {
+        memmove(c->keys + 1, c->keys, c->nr * sizeof(void *));
+        c->keys[0] = s->keys[s->nr - 1];
+        if (c->leaf) {
+            cnt = 1;
+        } else {
+            memmove(mln_btree_inner(c)->children + 1, mln_btree_inner(c)->children, c->nr * sizeof(mln_btree_node_t *));
+            memmove(mln_btree_inner(c)->counts + 1, mln_btree_inner(c)->counts, c->nr * sizeof(mln_uauto_t));
+            mln_btree_inner(c)->children[0] = mln_btree_inner(s)->children[s->nr - 1];
+            cnt = mln_btree_inner(c)->counts[0] = mln_btree_inner(s)->counts[s->nr - 1];
+        }
+        ++(c->nr);
+        --(s->nr);
+        pi->counts[i - 1] -= cnt;
+        pi->counts[i] += cnt;
+        p->keys[i] = c->keys[0];
+    } else if (i + 1 < p->nr && (s = pi->children[i + 1])->nr > M_BTREE_NODE_MIN) {
+        c->keys[c->nr] = s->keys[0];
+        if (c->leaf) {
+            cnt = 1;
+        } else {
+            mln_btree_inner(c)->children[c->nr] = mln_btree_inner(s)->children[0];
+            cnt = mln_btree_inner(c)->counts[c->nr] = mln_btree_inner(s)->counts[0];
+            memmove(mln_btree_inner(s)->children, mln_btree_inner(s)->children + 1, (s->nr - 1) * sizeof(mln_btree_node_t *));
+            memmove(mln_btree_inner(s)->counts, mln_btree_inner(s)->counts + 1, (s->nr - 1) * sizeof(mln_uauto_t));
+        }
+        memmove(s->keys, s->keys + 1, (s->nr - 1) * sizeof(void *));
+        ++(c->nr);
+        --(s->nr);
+        pi->counts[i + 1] -= cnt;
+        pi->counts[i] += cnt;
+        p->keys[i + 1] = s->keys[0];
+    } else if (i > 0) {
+        mln_btree_merge(t, p, i - 1);
+    } else if (i + 1 < p->nr) {
+        mln_btree_merge(t, p, i);
+    }
+}
+
+static void *mln_btree_remove_recursive(mln_btree_t *t, mln_btree_node_t *n, const void *key)
+{
+    void *data;
+    mln_u32_t i = mln_btree_upper_index(t, n, key);
+
+    if (n->leaf) {
+        if (i == 0 || t->cmp(n->keys[i - 1], key)) return NULL;
+        data = n->keys[--i];
+        memmove(n->keys + i, n->keys + i + 1, (n->nr - i - 1) * sizeof(void *));
+        --(n->nr);
+        return data;
+    }
+
+    if (i > 0) --i;
+    data = mln_btree_remove_recursive(t, mln_btree_inner(n)->children[i], key);
+    if (data == NULL) return NULL;
+    --(mln_btree_inner(n)->counts[i]);
+    n->keys[i] = mln_btree_inner(n)->children[i]->keys[0];
+    if (mln_btree_inner(n)->children[i]->nr < M_BTREE_NODE_MIN)
+        mln_btree_rebalance(t, n, i);
+    return data;
+}
+
+void *mln_btree_remove(mln_btree_t *t, const void *key)
+{
+    void *data;
+    mln_btree_node_t *n = t->root;
+
+    if (n == NULL) return NULL;
+    if ((data = mln_btree_remove_recursive(t, n, key)) == NULL) return NULL;
+    --(t->nr_node);
+
+    if (n->leaf) {
+        if (n->nr == 0) {
+            mln_btree_node_free(t, n);
+            t->root = t->head = t->tail = NULL;
+        }
+    } else if (n->nr == 1) {
+        t->root = mln_btree_inner(n)->children[0];
+        mln_btree_node_free(t, n);
+    }
+    return data;
+}
+
+void *mln_btree_search(mln_btree_t *t, const void *key)
+{
+    mln_u32_t i;
+    mln_btree_node_t *n = t->root;
+
+    if (n == NULL) return NULL;
+    while (1) {
+        i = mln_btree_upper_index(t, n, key);
+        if (n->leaf) break;
+        n = mln_btree_inner(n)->children[i > 0? i - 1: 0];
+    }
+    if (i == 0 || t->cmp(n->keys[i - 1], key)) return NULL;
+    return n->keys[i - 1];
+}
+
+/*
+ * The number of nodes for n entries in one level,
+ * each node has M_BTREE_NODE_MIN to M_BTREE_NODE_SIZE entries.
+ */
+static inline mln_uauto_t mln_btree_load_nr_nodes(mln_uauto_t n)
+{
+    mln_uauto_t m = (n + M_BTREE_LOAD_FILL - 1) / M_BTREE_LOAD_FILL;
+    while (m > 1 && n / m < M_BTREE_NODE_MIN) --m;
+    return m == 0? 1: m;
+}
+
+int mln_btree_load(mln_btree_t *t, void **data, mln_uauto_t n)
+{
+    mln_btree_node_t **nodes = NULL, **up, *node, *head = NULL, *prev = NULL;
+    mln_uauto_t m, k, j, pos, nr;
+
+    if (t->root != NULL) return -1;
+    if (n == 0) return 0;
+
+    k = mln_btree_load_nr_nodes(n);
+    for (j = 0, pos = 0; j < k; ++j) {
+        if ((node = mln_btree_node_new(t, 1)) == NULL) goto err;
+        nr = n / k + (j < n % k);
+        memcpy(node->keys, data + pos, nr * sizeof(void *));
+        node->nr = nr;
+        pos += nr;
+        mln_btree_leaf(node)->prev = prev;
+        if (prev != NULL) mln_btree_leaf(prev)->next = node;
+        else head = node;
+        prev = node;
+    }
+    if ((nodes = (mln_btree_node_t **)malloc(k * sizeof(mln_btree_node_t *))) == NULL) goto err;
+    for (j = 0, node = head; node != NULL; node = mln_btree_leaf(node)->next)
+        nodes[j++] = node;
+
+    while (k > 1) {
+        m = mln_btree_load_nr_nodes(k);
+        if ((up = (mln_btree_node_t **)malloc(m * sizeof(mln_btree_node_t *))) == NULL) goto err;
+        for (j = 0, pos = 0; j < m; ++j) {
+            if ((node = mln_btree_node_new(t, 0)) == NULL) {
+                while (j-- > 0) mln_btree_node_free(t, up[j]);
+                free(up);
+                goto err;
+            }
+            nr = k / m + (j < k % m);
+            for (; node->nr < nr; ++(node->nr), ++pos) {
+                node->keys[node->nr] = nodes[pos]->keys[0];
+                mln_btree_inner(node)->children[node->nr] = nodes[pos];
+                mln_btree_inner(node)->counts[node->nr] = mln_btree_node_count(nodes[pos]);
+            }
+            up[j] = node;
+        }
+        free(nodes);
+        nodes = up;
+        k = m;
+    }
+    t->root = nodes[0];
+    t->head = head;
+    t->tail = prev;
+    t->nr_node = n;
+    free(nodes);
+    return 0;
+
+err:
+    if (nodes != NULL) {
+        if (!nodes[0]->leaf) {
+            for (j = 0; j < k; ++j) mln_btree_inner_release(t, nodes[j]);
+        }
+        free(nodes);
+    }
+    while ((node = prev) != NULL) {
+        prev = mln_btree_leaf(node)->prev;
+        mln_btree_node_free(t, node);
+    }
+    return -1;
+}
+
+/*
+ * Free inner nodes only, leaves are freed by walking the leaf list.
+ */
+static void mln_btree_inner_release(mln_btree_t *t, mln_btree_node_t *n)
+{
+    mln_u32_t i;
+
+    if (n->leaf) return;
+    for (i = 0; i < n->nr; ++i) mln_btree_inner_release(t, mln_btree_inner(n)->children[i]);
+    mln_btree_node_free(t, n);
+}
+
+void *mln_btree_first(mln_btree_t *t, mln_btree_iter_t *iter)
+{
+    iter->leaf = t->head;
+    iter->index = 0;
+    return t->head == NULL? NULL: t->head->keys[0];
+}
+
+void *mln_btree_last(mln_btree_t *t, mln_btree_iter_t *iter)
+{
+    iter->leaf = t->tail;
+    if (t->tail == NULL) return NULL;
+    iter->index = t->tail->nr - 1;
+    return t->tail->keys[iter->index];
+}
+
+void *mln_btree_lower_bound(mln_btree_t *t, const void *key, mln_btree_iter_t *iter)
+{
+    mln_u32_t i;
+    mln_btree_node_t *n = t->root;
+
+    iter->leaf = NULL;
+    if (n == NULL) return NULL;
+    while (1) {
+        i = mln_btree_lower_index(t, n, key);
+        if (n->leaf) break;
+        n = mln_btree_inner(n)->children[i > 0? i - 1: 0];
+    }
+    if (i == n->nr) {
+        if ((n = mln_btree_leaf(n)->next) == NULL) return NULL;
+        i = 0;
+    }
+    iter->leaf = n;
+    iter->index = i;
+    return n->keys[i];
+}
+
+void *mln_btree_upper_bound(mln_btree_t *t, const void *key, mln_btree_iter_t *iter)
+{
+    mln_u32_t i;
+    mln_btree_node_t *n = t->root;
+
+    iter->leaf = NULL;
+    if (n == NULL) return NULL;
+    while (1) {
+        i = mln_btree_upper_index(t, n, key);
+        if (n->leaf) break;
+        n = mln_btree_inner(n)->children[i > 0? i - 1: 0];
+    }
+    if (i == n->nr) {
+        if ((n = mln_btree_leaf(n)->next) == NULL) return NULL;
+        i = 0;
+    }
+    iter->leaf = n;
+    iter->index = i;
+    return n->keys[i];
+}
+
+void *mln_btree_next(mln_btree_iter_t *iter)
+{
+    if (iter->leaf == NULL) return NULL;
+    if (++(iter->index) >= iter->leaf->nr) {
+        if ((iter->leaf = mln_btree_leaf(iter->leaf)->next) == NULL) return NULL;
+        iter->index = 0;
+    }
+    return iter->leaf->keys[iter->index];
+}
+
+void *mln_btree_prev(mln_btree_iter_t *iter)
+{
+    if (iter->leaf == NULL) return NULL;
+    if (iter->index == 0) {
+        if ((iter->leaf = mln_btree_leaf(iter->leaf)->prev) == NULL) return NULL;
+        iter->index = iter->leaf->nr;
+    }
+    return iter->leaf->keys[--(iter->index)];
+}
+
+void *mln_btree_select(mln_btree_t *t, mln_uauto_t k, mln_btree_iter_t *iter)
+{
+    mln_u32_t i;
+    mln_btree_node_t *n = t->root;
+
+    if (iter != NULL) iter->leaf = NULL;
+    if (k >= t->nr_node) return NULL;
+    while (!n->leaf) {
+        for (i = 0; k >= mln_btree_inner(n)->counts[i]; ++i)
+            k -= mln_btree_inner(n)->counts[i];
+        n = mln_btree_inner(n)->children[i];
+    }
+    if (iter != NULL) {
+        iter->leaf = n;
+        iter->index = k;
+    }
+    return n->keys[k];
+}
+
+mln_uauto_t mln_btree_rank(mln_btree_t *t, const void *key)
+{
+    mln_u32_t i, j;
+    mln_uauto_t rank = 0;
+    mln_btree_node_t *n = t->root;
+
+    if (n == NULL) return 0;
+    while (!n->leaf) {
+        if ((i = mln_btree_lower_index(t, n, key)) > 0) --i;
+        for (j = 0; j < i; ++j) rank += mln_btree_inner(n)->counts[j];
+        n = mln_btree_inner(n)->children[i];
+    }
+    return rank + mln_btree_lower_index(t, n, key);
+}
+
+/*
+ * Elements are read from the linked leaves in order,
+ * so no node is visited twice.
+ */
+int mln_btree_range_scan(mln_btree_t *t, const void *low, const void *high, btree_act act, void *udata)
+{
+    void *data;
+    mln_u32_t i;
+    mln_btree_iter_t iter;
+    mln_btree_node_t *n;
+
+    if (low == NULL) mln_btree_first(t, &iter);
+    else mln_btree_lower_bound(t, low, &iter);
+
+    for (n = iter.leaf, i = iter.index; n != NULL; n = mln_btree_leaf(n)->next, i = 0) {
+        for (; i < n->nr; ++i) {
+            data = n->keys[i];
+            if (high != NULL && t->cmp(data, high) >= 0) return 0;
+            if (act(data, udata) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+int mln_btree_scan_all(mln_btree_t *t, btree_act act, void *udata)
+{
+    return mln_btree_range_scan(t, NULL, NULL, act, udata);
+}
+
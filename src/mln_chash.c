@@ -0,0 +1,269 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mln_chash.h"
+#include "mln_string.h"
+
+static inline mln_chash_shard_t *
+mln_chash_shard(mln_chash_t *ch, void *key, mln_u64_t *phv) __NONNULL3(1,2,3);
+
+mln_chash_t *
+mln_chash_init(struct mln_chash_attr *attr)
+{
+    mln_chash_t *ch;
+    mln_u32_t i, n;
+    struct mln_hash_attr hattr;
+
+    if (attr->key_type == M_HASH_KEY_CUSTOM && (attr->hash == NULL || attr->cmp == NULL))
+        return NULL;
+    if (attr->nr_shards > M_CHASH_MAX_SHARDS) return NULL;
+
+    for (n = 1; n < (attr->nr_shards? attr->nr_shards: M_CHASH_DFL_SHARDS); n <<= 1)
+        ;
+
+    if ((ch = (mln_chash_t *)malloc(sizeof(mln_chash_t))) == NULL) return NULL;
+    ch->hash = attr->hash;
+    ch->mask = n - 1;
+    ch->key_type = attr->key_type;
+    ch->nocase = attr->nocase;
+    if (posix_memalign((void **)&ch->shards, M_CACHELINE_SIZE, n * sizeof(mln_chash_shard_t))) {
+        free(ch);
+        return NULL;
+    }
+    memset(ch->shards, 0, n * sizeof(mln_chash_shard_t));
+
+    hattr.pool = NULL;
+    hattr.pool_alloc = NULL;
+    hattr.pool_free = NULL;
+    hattr.hash = attr->hash;
+    hattr.cmp = attr->cmp;
+    hattr.free_key = attr->free_key;
+    hattr.free_val = attr->free_val;
+    hattr.len_base = attr->len_base / n + 1;
+    hattr.expandable = 1;
+    hattr.calc_prime = 0;
+    hattr.cache = attr->cache;
+    hattr.progressive = 1;
+    hattr.key_type = attr->key_type;
+    hattr.nocase = attr->nocase;
+    for (i = 0; i < n; ++i) {
+        if ((ch->shards[i].tbl = mln_hash_init(&hattr)) == NULL) goto err;
+        if (pthread_rwlock_init(&(ch->shards[i].lock), NULL) != 0) {
+            mln_hash_destroy(ch->shards[i].tbl, M_HASH_F_NONE);
+            goto err;
+        }
+    }
+    return ch;
+
+err:
+    while (i-- > 0) {
+        pthread_rwlock_destroy(&(ch->shards[i].lock));
+        mln_hash_destroy(ch->shards[i].tbl, M_HASH_F_NONE);
+    }
+    free(ch->shards);
+    free(ch);
+    return NULL;
+}
+
+void mln_chash_destroy(mln_chash_t *ch, mln_hash_flag_t flg)
+{
+    mln_chash_shard_t *s, *end = ch->shards + ch->mask + 1;
+
+    for (s = ch->shards; s < end; ++s) {
+        pthread_rwlock_destroy(&(s->lock));
+        mln_hash_destroy(s->tbl, flg);
+    }
+    free(ch->shards);
+    free(ch);
+}
+
+/*
+ * Shards are selected by the high bits of the mixed hash value,
+ * the buckets in a shard use the low bits.
+ * Shard tables are progressive, so hash does not depend on the table
+ * passed in, and the first shard's table is used here.
+ * The raw hash value is returned in phv and handed to the shard table,
+ * so the key is hashed only once.
+ */
+static inline mln_chash_shard_t *mln_chash_shard(mln_chash_t *ch, void *key, mln_u64_t *phv)
+{
+    mln_u64_t hv;
+
+    switch (ch->key_type) {
+        case M_HASH_KEY_STRING:
+            hv = mln_hash_string_calc(((mln_string_t *)key)->data, ((mln_string_t *)key)->len, ch->nocase);
+            break;
+        case M_HASH_KEY_CSTR:
+            hv = mln_hash_string_calc((mln_u8ptr_t)key, strlen((char *)key), ch->nocase);
+            break;
+        default:
+            hv = ch->hash(ch->shards[0].tbl, key);
+            break;
+    }
+    *phv = hv;
+    hv ^= hv >> 33;
+    hv *= (mln_u64_t)0xff51afd7ed558ccdULL;
+    hv ^= hv >> 33;
+    return &(ch->shards[(hv >> 32) & ch->mask]);
+}
+
+void *mln_chash_search(mln_chash_t *ch, void *key)
+{
+    void *val;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_rdlock(&(s->lock));
+    val = mln_hash_search_hv(s->tbl, key, hv);
+    pthread_rwlock_unlock(&(s->lock));
+    return val;
+}
+
+int mln_chash_read(mln_chash_t *ch, void *key, hash_scan_handler handler, void *udata)
+{
+    int ret = -1;
+    void *val;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_rdlock(&(s->lock));
+    if ((val = mln_hash_search_hv(s->tbl, key, hv)) != NULL)
+        ret = handler(key, val, udata);
+    pthread_rwlock_unlock(&(s->lock));
+    return ret;
+}
+
+int mln_chash_insert(mln_chash_t *ch, void *key, void *val)
+{
+    int ret;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_wrlock(&(s->lock));
+    ret = mln_hash_insert_hv(s->tbl, key, val, hv);
+    pthread_rwlock_unlock(&(s->lock));
+    return ret;
+}
+
+int mln_chash_replace(mln_chash_t *ch, void *key, void *val)
+{
+    int ret;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, *((void **)key), &hv);
+
+    pthread_rwlock_wrlock(&(s->lock));
+    ret = mln_hash_replace_hv(s->tbl, key, val, hv);
+    pthread_rwlock_unlock(&(s->lock));
+    return ret;
+}
+
+void mln_chash_remove(mln_chash_t *ch, void *key, mln_hash_flag_t flg)
+{
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_wrlock(&(s->lock));
+    mln_hash_remove_hv(s->tbl, key, flg, hv);
+    pthread_rwlock_unlock(&(s->lock));
+}
+
+void *mln_chash_get_or_insert(mln_chash_t *ch, void *key, void *val)
+{
+    void *old;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    /*
+     * Most calls hit an existent key, try it with the read lock first.
+     */
+    pthread_rwlock_rdlock(&(s->lock));
+    old = mln_hash_search_hv(s->tbl, key, hv);
+    pthread_rwlock_unlock(&(s->lock));
+    if (old != NULL) return old;
+
+    pthread_rwlock_wrlock(&(s->lock));
+    if ((old = mln_hash_search_hv(s->tbl, key, hv)) == NULL) {
+        old = mln_hash_insert_hv(s->tbl, key, val, hv) < 0? NULL: val;
+    }
+    pthread_rwlock_unlock(&(s->lock));
+    return old;
+}
+
+/*
+ * If handler returns NULL for an existent key, the entry is removed
+ * and its key is freed by free_key, the old value is left to handler.
+ */
+int mln_chash_compute(mln_chash_t *ch, void *key, chash_compute_handler handler, void *udata)
+{
+    int ret = 0;
+    void *old, *val;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_wrlock(&(s->lock));
+    old = mln_hash_search_hv(s->tbl, key, hv);
+    val = handler(key, old, udata);
+    if (old == NULL) {
+        if (val != NULL) ret = mln_hash_insert_hv(s->tbl, key, val, hv);
+    } else if (val == NULL) {
+        mln_hash_remove_hv(s->tbl, key, M_HASH_F_KEY, hv);
+    } else if (val != old) {
+        mln_hash_change_value_hv(s->tbl, key, val, hv);
+    }
+    pthread_rwlock_unlock(&(s->lock));
+    return ret;
+}
+
+int mln_chash_key_exist(mln_chash_t *ch, void *key)
+{
+    int ret;
+    mln_u64_t hv;
+    mln_chash_shard_t *s = mln_chash_shard(ch, key, &hv);
+
+    pthread_rwlock_rdlock(&(s->lock));
+    ret = mln_hash_key_exist_hv(s->tbl, key, hv);
+    pthread_rwlock_unlock(&(s->lock));
+    return ret;
+}
+
+int mln_chash_scan_all(mln_chash_t *ch, hash_scan_handler handler, void *udata)
+{
+    int ret = 0;
+    mln_chash_shard_t *s, *end = ch->shards + ch->mask + 1;
+
+    for (s = ch->shards; s < end && ret >= 0; ++s) {
+        pthread_rwlock_rdlock(&(s->lock));
+        ret = mln_hash_scan_all(s->tbl, handler, udata);
+        pthread_rwlock_unlock(&(s->lock));
+    }
+    return ret;
+}
+
+mln_u64_t mln_chash_nr_nodes(mln_chash_t *ch)
+{
+    mln_u64_t n = 0;
+    mln_chash_shard_t *s, *end = ch->shards + ch->mask + 1;
+
+    for (s = ch->shards; s < end; ++s) {
+        pthread_rwlock_rdlock(&(s->lock));
+        n += s->tbl->nr_nodes;
+        pthread_rwlock_unlock(&(s->lock));
+    }
+    return n;
+}
+
+void mln_chash_reset(mln_chash_t *ch, mln_hash_flag_t flg)
+{
+    mln_chash_shard_t *s, *end = ch->shards + ch->mask + 1;
+
+    for (s = ch->shards; s < end; ++s) {
+        pthread_rwlock_wrlock(&(s->lock));
+        mln_hash_reset(s->tbl, flg);
+        pthread_rwlock_unlock(&(s->lock));
+    }
+}
+
@@ -9,6 +9,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <stddef.h>
 #include "mln_types.h"
 #include "mln_global.h"
 #include "mln_tools.h"
@@ -22,8 +25,12 @@
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include "mln_ipc.h"
 #endif
 
 static void mln_init_notice(void);
@@ -33,13 +40,42 @@ static void mln_master_routine(struct mln_core_attr *attr);
 static int mln_get_framework_status(void);
 static void mln_sig_conf_reload(int signo);
 static int mln_conf_reload_scan_handler(mln_event_t *ev, mln_fork_t *f, void *data);
+static void mln_core_inherit_load(char **argv);
+static void mln_core_inherit_close(void);
+static int mln_core_sockaddr_cmp(struct sockaddr *a, struct sockaddr *b, socklen_t len) __NONNULL2(1,2);
+static void mln_sig_upgrade(int signo);
+static void mln_sig_quit(int signo);
+static void mln_core_sig_handler(mln_event_t *ev, int fd, void *data);
+static void mln_core_quit_timer(mln_event_t *ev, void *data);
+static void mln_core_upgrade(void);
+static int mln_core_quit_scan_handler(mln_event_t *ev, mln_fork_t *f, void *data);
+static int mln_core_count_scan_handler(mln_event_t *ev, mln_fork_t *f, void *data);
+static void mln_core_quit_master_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr);
+static void mln_core_quit_worker_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr);
 
 static mln_event_t *_ev = NULL;
+/*
+ * hot upgrade
+ */
+static int listen_fds[M_CORE_LISTEN_MAX];
+static mln_u32_t n_listen_fds = 0;
+static int inherited_fds[M_CORE_LISTEN_MAX];
+static mln_u32_t n_inherited_fds = 0;
+static pid_t upgrade_pid = 0;/*old master process to be notified*/
+static char **core_argv = NULL;
+static char core_path[PATH_MAX];
+static volatile sig_atomic_t sig_upgrade = 0;
+static volatile sig_atomic_t sig_quit = 0;
+static int sig_pipe[2] = {-1, -1};
+static int core_quitting = 0;
 #endif
 
 
 int mln_core_init(struct mln_core_attr *attr)
 {
+#if !defined(WIN32)
+    mln_core_inherit_load(attr->argv);
+#endif
     /*Init configurations*/
     if (mln_conf_load() < 0) {
         return -1;
@@ -51,6 +87,9 @@ int mln_core_init(struct mln_core_attr *attr)
     /*Init Melon resources*/
     if (attr->global_init != NULL && attr->global_init() < 0)
         return -1;
+#if !defined(WIN32)
+    mln_core_inherit_close();
+#endif
 
     mln_init_notice();
 #if !defined(WIN32)
@@ -70,6 +109,14 @@ int mln_core_init(struct mln_core_attr *attr)
         }
 
         /*fork*/
+        if (mln_ipc_handler_register(M_IPC_TYPE_QUIT, \
+                                     mln_core_quit_master_handler, \
+                                     mln_core_quit_worker_handler, \
+                                     NULL, \
+                                     NULL) < 0)
+        {
+            return -1;
+        }
         if (mln_pre_fork() < 0) {
             return -1;
         }
@@ -126,9 +173,33 @@ static void mln_master_routine(struct mln_core_attr *attr)
     if (_ev == NULL) _ev = ev;
     mln_fork_master_set_events(ev);
     mln_event_set_signal(SIGUSR2, mln_sig_conf_reload);
+    if (pipe(sig_pipe) < 0) {
+        mln_log(error, "pipe() error. %s\n", strerror(errno));
+        exit(1);
+    }
+    fcntl(sig_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sig_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(sig_pipe[1], F_SETFL, fcntl(sig_pipe[1], F_GETFL) | O_NONBLOCK);
+    if (mln_event_set_fd(ev, sig_pipe[0], M_EV_RECV|M_EV_NONBLOCK, M_EV_UNLIMITED, NULL, mln_core_sig_handler) < 0)
+        exit(1);
+    mln_event_set_signal(SIGHUP, mln_sig_upgrade);
+    mln_event_set_signal(SIGQUIT, mln_sig_quit);
+    /*
+     * Workers of this new master are already forked and share the
+     * listening sockets, it is time to let the old one drain its workers.
+     */
+    if (upgrade_pid > 0) {
+        if (kill(upgrade_pid, SIGQUIT) < 0)
+            mln_log(error, "Notify old master process %d failed. %s\n", (int)upgrade_pid, strerror(errno));
+        upgrade_pid = 0;
+    }
     if (attr->master_process != NULL) attr->master_process(ev);
     mln_event_dispatch(ev);
     mln_event_free(ev);
+    /*a restarted worker process gets here*/
+    close(sig_pipe[0]);
+    close(sig_pipe[1]);
+    sig_pipe[0] = sig_pipe[1] = -1;
 }
 
 static void mln_worker_routine(struct mln_core_attr *attr)
@@ -192,6 +263,280 @@ static int mln_conf_reload_scan_handler(mln_event_t *ev, mln_fork_t *f, void *da
     return mln_ipc_master_send_prepare(ev, M_IPC_TYPE_CONF, msg, sizeof(msg)-1, f);
 }
 
+/*
+ * Hot upgrade:
+ * 1. SIGHUP: the master process forks and executes the (new) binary with
+ *    the registered listening sockets and its pid in environment.
+ * 2. The new master process claims the sockets in global_init, forks
+ *    its workers and then sends SIGQUIT to the old master process.
+ * 3. SIGQUIT: the master process stops restarting workers, sends
+ *    M_IPC_TYPE_QUIT to them and exits after all of them exited.
+ * Signal handlers only set flags and write a byte to sig_pipe,
+ * the work is done when the master event reads it.
+ */
+static void mln_core_inherit_load(char **argv)
+{
+    char *p, *end;
+    long fd;
+
+    core_argv = argv;
+    if (argv != NULL && argv[0] != NULL) {
+        /*resolved now, in case the working directory is changed*/
+        if (strchr(argv[0], '/') == NULL || realpath(argv[0], core_path) == NULL)
+            snprintf(core_path, sizeof(core_path), "%s", argv[0]);
+    }
+
+    if ((p = getenv(M_CORE_UPGRADE_ENV)) != NULL) {
+        upgrade_pid = (pid_t)atol(p);
+        unsetenv(M_CORE_UPGRADE_ENV);
+    }
+    if ((p = getenv(M_CORE_INHERIT_ENV)) == NULL) return;
+    while (*p != 0 && n_inherited_fds < M_CORE_LISTEN_MAX) {
+        fd = strtol(p, &end, 10);
+        if (end == p || *end != ';' || fd < 0) break;
+        inherited_fds[n_inherited_fds++] = (int)fd;
+        p = end + 1;
+    }
+    unsetenv(M_CORE_INHERIT_ENV);
+}
+
+static void mln_core_inherit_close(void)
+{
+    mln_u32_t i;
+    for (i = 0; i < n_inherited_fds; ++i) {
+        mln_socket_close(inherited_fds[i]);
+    }
+    n_inherited_fds = 0;
+}
+
+int mln_core_listen_register(int fd)
+{
+    mln_u32_t i;
+    for (i = 0; i < n_listen_fds; ++i) {
+        if (listen_fds[i] == fd) return 0;
+    }
+    if (n_listen_fds >= M_CORE_LISTEN_MAX) return -1;
+    listen_fds[n_listen_fds++] = fd;
+    return 0;
+}
+
+int mln_core_listen_inherited(struct sockaddr *addr, socklen_t addrlen)
+{
+    mln_u32_t i;
+    int fd;
+    struct sockaddr_storage ss;
+    socklen_t len;
+
+    for (i = 0; i < n_inherited_fds; ++i) {
+        len = sizeof(ss);
+        memset(&ss, 0, sizeof(ss));
+        if (getsockname(inherited_fds[i], (struct sockaddr *)&ss, &len) < 0) continue;
+        if (mln_core_sockaddr_cmp((struct sockaddr *)&ss, addr, addrlen) < 0) continue;
+        fd = inherited_fds[i];
+        inherited_fds[i] = inherited_fds[--n_inherited_fds];
+        if (mln_core_listen_register(fd) < 0) {
+            mln_socket_close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    return -1;
+}
+
+static int mln_core_sockaddr_cmp(struct sockaddr *a, struct sockaddr *b, socklen_t len)
+{
+    if (a->sa_family != b->sa_family) return -1;
+
+    switch (a->sa_family) {
+        case AF_INET:
+        {
+            struct sockaddr_in *a4 = (struct sockaddr_in *)a, *b4 = (struct sockaddr_in *)b;
+            if (len < sizeof(*b4) || a4->sin_port != b4->sin_port) return -1;
+            return a4->sin_addr.s_addr == b4->sin_addr.s_addr? 0: -1;
+        }
+        case AF_INET6:
+        {
+            struct sockaddr_in6 *a6 = (struct sockaddr_in6 *)a, *b6 = (struct sockaddr_in6 *)b;
+            if (len < sizeof(*b6) || a6->sin6_port != b6->sin6_port) return -1;
+            return memcmp(&(a6->sin6_addr), &(b6->sin6_addr), sizeof(a6->sin6_addr))? -1: 0;
+        }
+        case AF_UNIX:
+        {
+            struct sockaddr_un *au = (struct sockaddr_un *)a, *bu = (struct sockaddr_un *)b;
+            if (len <= offsetof(struct sockaddr_un, sun_path)) return -1;
+            return strncmp(au->sun_path, bu->sun_path, sizeof(au->sun_path))? -1: 0;
+        }
+        default:
+            return -1;
+    }
+}
+
+static void mln_sig_upgrade(int signo)
+{
+    int err = errno;
+
+    sig_upgrade = 1;
+    if (sig_pipe[1] >= 0 && write(sig_pipe[1], "", 1) < 0) {/*full means already notified*/}
+    errno = err;
+}
+
+static void mln_sig_quit(int signo)
+{
+    int err = errno;
+
+    sig_quit = 1;
+    if (sig_pipe[1] >= 0 && write(sig_pipe[1], "", 1) < 0) {/*full means already notified*/}
+    errno = err;
+}
+
+static void mln_core_sig_handler(mln_event_t *ev, int fd, void *data)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    if (sig_upgrade) {
+        sig_upgrade = 0;
+        if (!core_quitting) mln_core_upgrade();
+    }
+    if (sig_quit) {
+        sig_quit = 0;
+        if (!core_quitting) {
+            mln_log(report, "Master process quitting.\n");
+            core_quitting = 1;
+            (void)mln_fork_scan_all(ev, mln_core_quit_scan_handler, NULL);
+            mln_core_quit_timer(ev, NULL);
+        }
+    }
+}
+
+/*
+ * Only armed while quitting, to see if all child processes exited.
+ */
+static void mln_core_quit_timer(mln_event_t *ev, void *data)
+{
+    mln_u32_t n = 0;
+
+    (void)mln_fork_scan_all(ev, mln_core_count_scan_handler, &n);
+    if (!n) {
+        mln_log(report, "All child processes exited, master process exit.\n");
+        exit(0);
+    }
+    if (mln_event_set_timer(ev, M_CORE_TIMER_MS, NULL, mln_core_quit_timer) < 0) {
+        mln_log(error, "mln_event_set_timer() failed.\n");
+        abort();
+    }
+}
+
+static void mln_core_upgrade(void)
+{
+    mln_u32_t i;
+    int fd, fd_max, flg;
+    DIR *dir;
+    struct dirent *de;
+    char buf[M_CORE_LISTEN_MAX * 12 + 1], pid_str[32], *p = buf;
+
+    if (core_argv == NULL) {
+        mln_log(error, "No arguments to execute the new binary.\n");
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        mln_log(error, "fork() error. %s\n", strerror(errno));
+        return;
+    } else if (pid > 0) {
+        mln_log(report, "Upgrading, new master process %d.\n", (int)pid);
+        return;
+    }
+
+    buf[0] = 0;
+    for (i = 0; i < n_listen_fds; ++i) {
+        p += snprintf(p, sizeof(buf) - (p - buf), "%d;", listen_fds[i]);
+        if ((flg = fcntl(listen_fds[i], F_GETFD)) >= 0)
+            fcntl(listen_fds[i], F_SETFD, flg & ~FD_CLOEXEC);
+    }
+    snprintf(pid_str, sizeof(pid_str), "%d", (int)getppid());
+    if (setenv(M_CORE_INHERIT_ENV, buf, 1) < 0 || setenv(M_CORE_UPGRADE_ENV, pid_str, 1) < 0) {
+        mln_log(error, "setenv() error. %s\n", strerror(errno));
+        _exit(1);
+    }
+    /*
+     * Only the listening sockets and the standard streams are left,
+     * the new master process opens everything else by itself.
+     * Opened fds are marked close-on-exec if /proc/self/fd can be read,
+     * otherwise every possible fd is closed.
+     */
+    if ((dir = opendir("/proc/self/fd")) != NULL) {
+        while ((de = readdir(dir)) != NULL) {
+            if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+            fd = atoi(de->d_name);
+            if (fd <= STDERR_FILENO || fd == dirfd(dir)) continue;
+            for (i = 0; i < n_listen_fds; ++i) {
+                if (listen_fds[i] == fd) break;
+            }
+            if (i >= n_listen_fds && (flg = fcntl(fd, F_GETFD)) >= 0)
+                fcntl(fd, F_SETFD, flg | FD_CLOEXEC);
+        }
+        closedir(dir);
+    } else {
+        if ((fd_max = (int)sysconf(_SC_OPEN_MAX)) < 0) fd_max = 1024;
+        for (fd = STDERR_FILENO + 1; fd < fd_max; ++fd) {
+            for (i = 0; i < n_listen_fds; ++i) {
+                if (listen_fds[i] == fd) break;
+            }
+            if (i >= n_listen_fds) close(fd);
+        }
+    }
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGUSR2, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    execvp(core_path, core_argv);
+    _exit(1);
+}
+
+static int mln_core_quit_scan_handler(mln_event_t *ev, mln_fork_t *f, void *data)
+{
+    char msg[] = "quit";
+
+    /*no one would be restarted*/
+    f->stype = M_PST_DFL;
+    if (f->etype == M_PET_EXE) {
+        if (kill(f->pid, SIGTERM) < 0)
+            mln_log(error, "kill() error. %s\n", strerror(errno));
+        return 0;
+    }
+    if (mln_ipc_master_send_prepare(ev, M_IPC_TYPE_QUIT, msg, sizeof(msg)-1, f) < 0)
+        mln_log(error, "Send quit message to worker process failed.\n");
+    return 0;
+}
+
+static int mln_core_count_scan_handler(mln_event_t *ev, mln_fork_t *f, void *data)
+{
+    ++(*(mln_u32_t *)data);
+    return 0;
+}
+
+/*
+ * Master never receives M_IPC_TYPE_QUIT.
+ */
+static void mln_core_quit_master_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr)
+{
+}
+
+/*
+ * By default, a worker process stops dispatching and returns from
+ * mln_core_init(). Register another worker handler of M_IPC_TYPE_QUIT
+ * to close its listeners and finish its connections before that.
+ */
+static void mln_core_quit_worker_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr)
+{
+    mln_log(report, "Worker process quit.\n");
+    mln_event_set_break(ev);
+}
+
 static int mln_get_framework_status(void)
 {
     char framework[] = "framework";
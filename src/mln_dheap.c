@@ -0,0 +1,194 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mln_dheap.h"
+
+#define mln_dheap_parent(i) (((i) - 1) / M_DHEAP_ARITY)
+#define mln_dheap_child(i)  ((i) * M_DHEAP_ARITY + 1)
+
+static inline void
+mln_dheap_sift_up(mln_dheap_t *dh, mln_dheap_node_t *fn, mln_size_t i) __NONNULL2(1,2);
+static inline void
+mln_dheap_sift_down(mln_dheap_t *dh, mln_dheap_node_t *fn, mln_size_t i) __NONNULL2(1,2);
+static inline int
+mln_dheap_expand(mln_dheap_t *dh) __NONNULL1(1);
+
+
+mln_dheap_t *mln_dheap_init(struct mln_dheap_attr *attr)
+{
+    mln_dheap_t *dh;
+    mln_size_t len = attr->len_base? attr->len_base: M_DHEAP_LEN_BASE;
+
+    if (attr->pool != NULL)
+        dh = (mln_dheap_t *)attr->pool_alloc(attr->pool, sizeof(mln_dheap_t));
+    else
+        dh = (mln_dheap_t *)malloc(sizeof(mln_dheap_t));
+    if (dh == NULL) return NULL;
+
+    dh->pool = attr->pool;
+    dh->pool_alloc = attr->pool_alloc;
+    dh->pool_free = attr->pool_free;
+    dh->cmp = attr->cmp;
+    dh->key_free = attr->key_free;
+    if (attr->pool != NULL)
+        dh->tbl = (mln_dheap_node_t **)attr->pool_alloc(attr->pool, len * sizeof(mln_dheap_node_t *));
+    else
+        dh->tbl = (mln_dheap_node_t **)malloc(len * sizeof(mln_dheap_node_t *));
+    if (dh->tbl == NULL) {
+        if (attr->pool != NULL) attr->pool_free(dh);
+        else free(dh);
+        return NULL;
+    }
+    dh->len = len;
+    dh->num = 0;
+    return dh;
+}
+
+void mln_dheap_destroy(mln_dheap_t *dh)
+{
+    if (dh == NULL) return;
+
+    mln_dheap_node_t **p, **end = dh->tbl + dh->num;
+    for (p = dh->tbl; p < end; ++p) {
+        mln_dheap_node_destroy(dh, *p);
+    }
+    if (dh->pool != NULL) {
+        dh->pool_free(dh->tbl);
+        dh->pool_free(dh);
+    } else {
+        free(dh->tbl);
+        free(dh);
+    }
+}
+
+static inline int mln_dheap_expand(mln_dheap_t *dh)
+{
+    mln_dheap_node_t **tbl;
+    mln_size_t len = dh->len << 1;
+
+    if (dh->pool != NULL) {
+        tbl = (mln_dheap_node_t **)dh->pool_alloc(dh->pool, len * sizeof(mln_dheap_node_t *));
+        if (tbl == NULL) return -1;
+        memcpy(tbl, dh->tbl, dh->num * sizeof(mln_dheap_node_t *));
+        dh->pool_free(dh->tbl);
+    } else {
+        tbl = (mln_dheap_node_t **)realloc(dh->tbl, len * sizeof(mln_dheap_node_t *));
+        if (tbl == NULL) return -1;
+    }
+    dh->tbl = tbl;
+    dh->len = len;
+    return 0;
+}
+
+/*
+ * Both sift functions move a hole instead of swapping nodes,
+ * fn is written only once at its final position.
+ */
+static inline void mln_dheap_sift_up(mln_dheap_t *dh, mln_dheap_node_t *fn, mln_size_t i)
+{
+    mln_size_t p;
+    mln_dheap_node_t **tbl = dh->tbl;
+
+    while (i > 0) {
+        p = mln_dheap_parent(i);
+        if (dh->cmp(fn->key, tbl[p]->key)) break;
+        tbl[i] = tbl[p];
+        tbl[i]->index = i;
+        i = p;
+    }
+    tbl[i] = fn;
+    fn->index = i;
+}
+
+static inline void mln_dheap_sift_down(mln_dheap_t *dh, mln_dheap_node_t *fn, mln_size_t i)
+{
+    mln_size_t c, m, end, num = dh->num;
+    mln_dheap_node_t **tbl = dh->tbl;
+
+    while ((c = mln_dheap_child(i)) < num) {
+        end = c + M_DHEAP_ARITY;
+        if (end > num) end = num;
+        for (m = c++; c < end; ++c) {
+            if (!dh->cmp(tbl[c]->key, tbl[m]->key)) m = c;
+        }
+        if (dh->cmp(tbl[m]->key, fn->key)) break;
+        tbl[i] = tbl[m];
+        tbl[i]->index = i;
+        i = m;
+    }
+    tbl[i] = fn;
+    fn->index = i;
+}
+
+int mln_dheap_insert(mln_dheap_t *dh, mln_dheap_node_t *fn)
+{
+    if (dh->num >= dh->len && mln_dheap_expand(dh) < 0)
+        return -1;
+    mln_dheap_sift_up(dh, fn, dh->num++);
+    return 0;
+}
+
+mln_dheap_node_t *mln_dheap_extract_min(mln_dheap_t *dh)
+{
+    mln_dheap_node_t *min;
+
+    if (!dh->num) return NULL;
+    min = dh->tbl[0];
+    if (--(dh->num))
+        mln_dheap_sift_down(dh, dh->tbl[dh->num], 0);
+    min->index = M_DHEAP_NOT_IN;
+    return min;
+}
+
+void mln_dheap_update(mln_dheap_t *dh, mln_dheap_node_t *fn)
+{
+    mln_size_t i = fn->index;
+
+    if (i > 0 && !dh->cmp(fn->key, dh->tbl[mln_dheap_parent(i)]->key))
+        mln_dheap_sift_up(dh, fn, i);
+    else
+        mln_dheap_sift_down(dh, fn, i);
+}
+
+void mln_dheap_delete(mln_dheap_t *dh, mln_dheap_node_t *fn)
+{
+    mln_dheap_node_t *last;
+    mln_size_t i = fn->index;
+
+    last = dh->tbl[--(dh->num)];
+    fn->index = M_DHEAP_NOT_IN;
+    if (last == fn) return;
+
+    last->index = i;
+    mln_dheap_update(dh, last);
+}
+
+/*mln_dheap_node_t*/
+mln_dheap_node_t *mln_dheap_node_init(mln_dheap_t *dh, void *key)
+{
+    mln_dheap_node_t *fn;
+
+    if (dh->pool != NULL)
+        fn = (mln_dheap_node_t *)dh->pool_alloc(dh->pool, sizeof(mln_dheap_node_t));
+    else
+        fn = (mln_dheap_node_t *)malloc(sizeof(mln_dheap_node_t));
+    if (fn == NULL) return NULL;
+
+    fn->key = key;
+    fn->index = M_DHEAP_NOT_IN;
+    return fn;
+}
+
+void mln_dheap_node_destroy(mln_dheap_t *dh, mln_dheap_node_t *fn)
+{
+    if (fn == NULL) return;
+    if (dh->key_free != NULL && fn->key != NULL)
+        dh->key_free(fn->key);
+    if (dh->pool != NULL) dh->pool_free(fn);
+    else free(fn);
+}
+
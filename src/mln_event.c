@@ -30,12 +30,8 @@ static int
 mln_event_rbtree_fd_cmp(const void *k1, const void *k2) __NONNULL2(1,2);
 static int
 mln_event_fd_timeout_cmp(const void *k1, const void *k2);
-static void
-mln_event_fd_timeout_copy(void *k1, void *k2);
 static int
-mln_event_fheap_timer_cmp(const void *k1, const void *k2) __NONNULL2(1,2);
-static void
-mln_event_fheap_timer_copy(void *k1, void *k2) __NONNULL2(1,2);
+mln_event_dheap_timer_cmp(const void *k1, const void *k2) __NONNULL2(1,2);
 static inline void
 mln_event_set_fd_nonblock(int fd);
 static inline void
@@ -67,13 +63,6 @@ mln_event_set_fd_append(mln_event_t *event, \
 static int
 mln_event_set_fd_timeout(mln_event_t *ev, mln_event_desc_t *ed, int timeout_ms);
 
-/*varliables*/
-mln_event_desc_t fheap_min = {
-    M_EV_TM, 0,
-    {{NULL, NULL, 0}},
-    NULL, NULL, NULL, NULL
-};
-
 mln_event_t *mln_event_new(void)
 {
     int rc;
@@ -102,30 +91,26 @@ mln_event_t *mln_event_new(void)
     ev->ev_fd_active_head = NULL;
     ev->ev_fd_active_tail = NULL;
 
-    struct mln_fheap_attr fattr;
-    fattr.pool = NULL;
-    fattr.pool_alloc = NULL;
-    fattr.pool_free = NULL;
-    fattr.cmp = mln_event_fd_timeout_cmp;
-    fattr.copy = mln_event_fd_timeout_copy;
-    fattr.key_free = NULL;
-    fattr.min_val = &fheap_min;
-    fattr.min_val_size = sizeof(mln_event_desc_t);
-    ev->ev_fd_timeout_heap = mln_fheap_init(&fattr);
+    struct mln_dheap_attr dattr;
+    dattr.pool = NULL;
+    dattr.pool_alloc = NULL;
+    dattr.pool_free = NULL;
+    dattr.cmp = mln_event_fd_timeout_cmp;
+    dattr.key_free = NULL;
+    dattr.len_base = 0;
+    ev->ev_fd_timeout_heap = mln_dheap_init(&dattr);
     if (ev->ev_fd_timeout_heap == NULL) {
         mln_log(error, "No memory.\n");
         goto err2;
     }
     /*timer heap*/
-    fattr.pool = NULL;
-    fattr.pool_alloc = NULL;
-    fattr.pool_free = NULL;
-    fattr.cmp = mln_event_fheap_timer_cmp;
-    fattr.copy = mln_event_fheap_timer_copy;
-    fattr.key_free = mln_event_desc_free;
-    fattr.min_val = &fheap_min;
-    fattr.min_val_size = sizeof(mln_event_desc_t);
-    ev->ev_timer_heap = mln_fheap_init(&fattr);
+    dattr.pool = NULL;
+    dattr.pool_alloc = NULL;
+    dattr.pool_free = NULL;
+    dattr.cmp = mln_event_dheap_timer_cmp;
+    dattr.key_free = mln_event_desc_free;
+    dattr.len_base = 0;
+    ev->ev_timer_heap = mln_dheap_init(&dattr);
     if (ev->ev_timer_heap == NULL) {
         mln_log(error, "No memory.\n");
         goto err3;
@@ -182,9 +167,9 @@ mln_event_t *mln_event_new(void)
     return ev;
 
 err4:
-    mln_fheap_destroy(ev->ev_timer_heap);
+    mln_dheap_destroy(ev->ev_timer_heap);
 err3:
-    mln_fheap_destroy(ev->ev_fd_timeout_heap);
+    mln_dheap_destroy(ev->ev_fd_timeout_heap);
 err2:
     mln_rbtree_destroy(ev->ev_fd_tree);
 err1:
@@ -196,7 +181,7 @@ void mln_event_free(mln_event_t *ev)
 {
     if (ev == NULL) return;
     mln_event_desc_t *ed;
-    mln_fheap_destroy(ev->ev_fd_timeout_heap);
+    mln_dheap_destroy(ev->ev_fd_timeout_heap);
     mln_rbtree_destroy(ev->ev_fd_tree);
     while ((ed = ev->ev_fd_wait_head) != NULL) {
         ev_fd_wait_chain_del(&(ev->ev_fd_wait_head), \
@@ -204,7 +189,7 @@ void mln_event_free(mln_event_t *ev)
                              ed);
         mln_event_desc_free(ed);
     }
-    mln_fheap_destroy(ev->ev_timer_heap);
+    mln_dheap_destroy(ev->ev_timer_heap);
 #if defined(MLN_EPOLL)
     close(ev->epollfd);
     close(ev->unusedfd);
@@ -253,14 +238,19 @@ int mln_event_set_timer(mln_event_t *event, \
     ed->next = NULL;
     ed->act_prev = NULL;
     ed->act_next = NULL;
-    mln_fheap_node_t *fn = mln_fheap_node_init(event->ev_timer_heap, ed);
+    mln_dheap_node_t *fn = mln_dheap_node_init(event->ev_timer_heap, ed);
     if (fn == NULL) {
         mln_log(error, "No memory.\n");
         free(ed);
         return -1;
     }
     pthread_mutex_lock(&event->timer_lock);
-    mln_fheap_insert(event->ev_timer_heap, fn);
+    if (mln_dheap_insert(event->ev_timer_heap, fn) < 0) {
+        pthread_mutex_unlock(&event->timer_lock);
+        mln_log(error, "No memory.\n");
+        mln_dheap_node_destroy(event->ev_timer_heap, fn);
+        return -1;
+    }
     pthread_mutex_unlock(&event->timer_lock);
     return 0;
 }
@@ -272,13 +262,13 @@ static inline void mln_event_deal_timer(mln_event_t *event)
     gettimeofday(&tv, NULL);
     now = tv.tv_sec * 1000000 + tv.tv_usec;
     mln_event_desc_t *ed;
-    mln_fheap_node_t *fn;
+    mln_dheap_node_t *fn;
 
 lp:
     if (pthread_mutex_trylock(&event->timer_lock))
         return;
 
-    fn = mln_fheap_minimum(event->ev_timer_heap);
+    fn = mln_dheap_minimum(event->ev_timer_heap);
     if (fn == NULL) {
         pthread_mutex_unlock(&event->timer_lock);
         return;
@@ -290,14 +280,14 @@ lp:
         return;
     }
 
-    fn = mln_fheap_extract_min(event->ev_timer_heap);
+    fn = mln_dheap_extract_min(event->ev_timer_heap);
 
     pthread_mutex_unlock(&event->timer_lock);
 
     if (ed->data.tm.handler != NULL)
         ed->data.tm.handler(event, ed->data.tm.data);
 
-    mln_fheap_node_destroy(event->ev_timer_heap, fn);
+    mln_dheap_node_destroy(event->ev_timer_heap, fn);
 
     if (!event->is_break)
         goto lp;
@@ -652,31 +642,34 @@ mln_event_set_fd_timeout(mln_event_t *ev, mln_event_desc_t *ed, int timeout_ms)
     mln_event_fd_t *ef = &(ed->data.fd);
     if (timeout_ms == M_EV_UNLIMITED) {
         if (ef->timeout_node != NULL) {
-            mln_fheap_delete(ev->ev_fd_timeout_heap, ef->timeout_node);
-            mln_fheap_node_destroy(ev->ev_fd_timeout_heap, ef->timeout_node);
+            mln_dheap_delete(ev->ev_fd_timeout_heap, ef->timeout_node);
+            mln_dheap_node_destroy(ev->ev_fd_timeout_heap, ef->timeout_node);
             ef->timeout_node = NULL;
             ef->end_us = 0;
         }
         return 0;
     }
-    mln_fheap_node_t *fn;
+    mln_dheap_node_t *fn;
     struct timeval tv;
     memset(&tv, 0, sizeof(tv));
     gettimeofday(&tv, NULL);
     if (ef->timeout_node == NULL) {
         ef->end_us = tv.tv_sec*1000000+tv.tv_usec+timeout_ms*1000;
-        fn = mln_fheap_node_init(ev->ev_fd_timeout_heap, ed);
+        fn = mln_dheap_node_init(ev->ev_fd_timeout_heap, ed);
         if (fn == NULL) {
             mln_log(error, "No memory.\n");
             return -1;
         }
+        if (mln_dheap_insert(ev->ev_fd_timeout_heap, fn) < 0) {
+            mln_log(error, "No memory.\n");
+            mln_dheap_node_destroy(ev->ev_fd_timeout_heap, fn);
+            ef->end_us = 0;
+            return -1;
+        }
         ef->timeout_node = fn;
-        mln_fheap_insert(ev->ev_fd_timeout_heap, fn);
     } else {
-        fn = ef->timeout_node;
-        mln_fheap_delete(ev->ev_fd_timeout_heap, fn);
         ef->end_us = tv.tv_sec*1000000+tv.tv_usec+timeout_ms*1000;
-        mln_fheap_insert(ev->ev_fd_timeout_heap, fn);
+        mln_dheap_update(ev->ev_fd_timeout_heap, ef->timeout_node);
     }
     return 0;
 }
@@ -697,8 +690,8 @@ mln_event_set_fd_clr(mln_event_t *event, int fd)
     }
     ed = (mln_event_desc_t *)(rn->data);
     if (ed->data.fd.timeout_node != NULL) {
-        mln_fheap_delete(event->ev_fd_timeout_heap, ed->data.fd.timeout_node);
-        mln_fheap_node_destroy(event->ev_fd_timeout_heap, ed->data.fd.timeout_node);
+        mln_dheap_delete(event->ev_fd_timeout_heap, ed->data.fd.timeout_node);
+        mln_dheap_node_destroy(event->ev_fd_timeout_heap, ed->data.fd.timeout_node);
         ed->data.fd.timeout_node = NULL;
         ed->data.fd.end_us = 0;
     }
@@ -1233,8 +1226,8 @@ lp:
                                ed);
         ef = &(ed->data.fd);
         if (ef->timeout_node != NULL) {
-            mln_fheap_delete(event->ev_fd_timeout_heap, ef->timeout_node);
-            mln_fheap_node_destroy(event->ev_fd_timeout_heap, ef->timeout_node);
+            mln_dheap_delete(event->ev_fd_timeout_heap, ef->timeout_node);
+            mln_dheap_node_destroy(event->ev_fd_timeout_heap, ef->timeout_node);
             ef->timeout_node = NULL;
             ef->end_us = 0;
         }
@@ -1298,7 +1291,7 @@ static inline void mln_event_deal_fd_timeout(mln_event_t *event)
     gettimeofday(&tv, NULL);
     now = tv.tv_sec * 1000000 + tv.tv_usec;
     mln_event_desc_t *ed;
-    mln_fheap_node_t *fn;
+    mln_dheap_node_t *fn;
     mln_event_fd_t *ef;
     ev_fd_handler h;
     void *data;
@@ -1308,7 +1301,7 @@ lp:
     if (pthread_mutex_trylock(&event->fd_lock))
         return;
 
-    fn = mln_fheap_minimum(event->ev_fd_timeout_heap);
+    fn = mln_dheap_minimum(event->ev_fd_timeout_heap);
     if (fn == NULL) {
         pthread_mutex_unlock(&event->fd_lock);
         return;
@@ -1326,8 +1319,8 @@ lp:
         return;
     }
     ef->in_process = 1;
-    mln_fheap_delete(event->ev_fd_timeout_heap, fn);
-    mln_fheap_node_destroy(event->ev_fd_timeout_heap, fn);
+    mln_dheap_delete(event->ev_fd_timeout_heap, fn);
+    mln_dheap_node_destroy(event->ev_fd_timeout_heap, fn);
     ed->data.fd.timeout_node = NULL;
 
     if (ed->data.fd.timeout_handler != NULL) {
@@ -1361,7 +1354,7 @@ mln_event_rbtree_fd_cmp(const void *k1, const void *k2)
 }
 
 /*
- * fheap functions
+ * dheap functions
  */
 static int
 mln_event_fd_timeout_cmp(const void *k1, const void *k2)
@@ -1372,16 +1365,8 @@ mln_event_fd_timeout_cmp(const void *k1, const void *k2)
     return 1;
 }
 
-static void
-mln_event_fd_timeout_copy(void *k1, void *k2)
-{
-    mln_event_desc_t *ed1 = (mln_event_desc_t *)k1;
-    mln_event_desc_t *ed2 = (mln_event_desc_t *)k2;
-    ed1->data.fd.end_us = ed2->data.fd.end_us;
-}
-
 static int
-mln_event_fheap_timer_cmp(const void *k1, const void *k2)
+mln_event_dheap_timer_cmp(const void *k1, const void *k2)
 {
     mln_event_desc_t *ed1 = (mln_event_desc_t *)k1;
     mln_event_desc_t *ed2 = (mln_event_desc_t *)k2;
@@ -1389,14 +1374,6 @@ mln_event_fheap_timer_cmp(const void *k1, const void *k2)
     return 1;
 }
 
-static void
-mln_event_fheap_timer_copy(void *k1, void *k2)
-{
-    mln_event_desc_t *ed1 = (mln_event_desc_t *)k1;
-    mln_event_desc_t *ed2 = (mln_event_desc_t *)k2;
-    ed1->data.tm.end_tm = ed2->data.tm.end_tm;
-}
-
 /*
  * chains
  */
@@ -13,7 +13,12 @@
 #include "mln_log.h"
 #include "mln_global.h"
 #include "mln_ipc.h"
+#include "mln_affinity.h"
+#include "mln_stats.h"
+#include "mln_notifier.h"
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 mln_tcp_conn_t master_conn;
 mln_size_t child_error_bytes;
@@ -29,6 +34,15 @@ clr_handler rs_clr_handler = NULL;
 void *rs_clr_data = NULL;
 volatile mln_u32_t child_startup = 0;
 int wait_signo = SIGUSR1;
+mln_affinity_t *worker_affinity = NULL;
+mln_u32_t n_worker_affinity = 0;
+mln_sauto_t worker_id_seq = 0;
+mln_size_t worker_shm_size = 0;
+mln_ipc_shm_t *worker_shm = NULL;
+mln_u32_t worker_conn_dist = 0;
+int worker_dist_fd = -1;
+dist_handler worker_dist_handler = NULL;
+void *worker_dist_data = NULL;
 
 MLN_CHAIN_FUNC_DECLARE(worker_list, \
                        mln_fork_t, \
@@ -44,7 +58,8 @@ do_fork_core(enum proc_exec_type etype, \
              enum proc_state_type stype, \
              mln_s8ptr_t *args, \
              mln_u32_t n_args, \
-             mln_event_t *master_ev);
+             mln_event_t *master_ev, \
+             mln_sauto_t worker_id);
 static mln_fork_t *
 mln_fork_init(struct mln_fork_attr *attr) __NONNULL1(1);
 static void
@@ -65,6 +80,30 @@ static void
 mln_ipc_fd_handler_worker_send(mln_event_t *ev, int fd, void *data);
 static inline mln_ipc_handler_t *mln_ipc_handler_new(mln_u32_t type, ipc_handler handler, void *data);
 static void mln_ipc_handler_free(mln_ipc_handler_t *ih);
+static mln_ipc_shm_t *mln_ipc_shm_create(mln_size_t size);
+static void mln_ipc_shm_destroy(mln_ipc_shm_t *shm);
+static int mln_ipc_shm_lock(void *lock);
+static int mln_ipc_shm_unlock(void *lock);
+static int
+mln_ipc_shm_send(mln_event_t *ev, \
+                 mln_ipc_shm_ring_t *r, \
+                 mln_u32_t type, \
+                 void *buf, \
+                 mln_u32_t len, \
+                 mln_fork_t *f_child);
+static void
+mln_ipc_shm_process(mln_event_t *ev, \
+                    mln_ipc_shm_t *shm, \
+                    mln_ipc_shm_ring_t *r, \
+                    mln_rbtree_t *tree, \
+                    void *f_ptr);
+static void
+mln_fork_dist_load_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr);
+static void
+mln_fork_dist_accept_handler(mln_event_t *ev, int fd, void *data);
+static void
+mln_fork_dist_recv_handler(mln_event_t *ev, int fd, void *data);
+static int mln_fork_dist_fd_send(int sock, int fd);
 
 /*pre-fork*/
 int mln_pre_fork(void)
@@ -119,7 +158,12 @@ int mln_pre_fork(void)
         mln_tcp_conn_destroy(&master_conn);
         return -1;
     }
-    if (mln_set_ipc_handlers() < 0) {
+    /*
+     * Set before the registered ones, so that users can override it.
+     */
+    if (mln_set_master_ipc_handler(M_IPC_TYPE_LOAD, mln_fork_dist_load_handler, NULL) < 0 || \
+        mln_set_ipc_handlers() < 0)
+    {
         mln_log(error, "No memory.\n");
         mln_rbtree_destroy(worker_ipc_tree);
         worker_ipc_tree = NULL;
@@ -157,6 +201,10 @@ mln_fork_init(struct mln_fork_attr *attr)
         return NULL;
     }
     f->pid = attr->pid;
+    f->worker_id = attr->worker_id;
+    f->shm = attr->shm;
+    f->dist_fd = attr->dist_fd;
+    f->load = 0;
     f->n_args = attr->n_args;
     f->state = STATE_IDLE;
     f->msg_len = 0;
@@ -180,6 +228,9 @@ mln_fork_destroy(mln_fork_t *f, int free_args)
     if (f->msg_content != NULL) {
         free(f->msg_content);
     }
+    mln_ipc_shm_destroy(f->shm);
+    if (f->dist_fd >= 0)
+        mln_socket_close(f->dist_fd);
     if (mln_tcp_conn_get_fd(&(f->conn)) >= 0)
         mln_socket_close(mln_tcp_conn_get_fd(&(f->conn)));
     mln_tcp_conn_destroy(&(f->conn));
@@ -233,6 +284,46 @@ int do_fork(void)
             exit(1);
         }
     }
+    if (mln_affinity_conf_load("worker_cpu_affinity", &worker_affinity, &n_worker_affinity) < 0) {
+        exit(1);
+    }
+    cmd = cd->search(cd, "worker_ipc_shm");
+    if (cmd != NULL) {
+        if (mln_conf_get_narg(cmd) != 1) {
+            mln_log(error, "'worker_ipc_shm' need an integer argument.\n");
+            exit(1);
+        }
+        mln_conf_item_t *ci = cmd->search(cmd, 1);
+        if (ci->type != CONF_INT) {
+            mln_log(error, "'worker_ipc_shm' need an integer argument.\n");
+            exit(1);
+        }
+        if (ci->val.i < 0 || (ci->val.i && ((mln_size_t)ci->val.i << 20) < M_ALLOC_SHM_DEFAULT_SIZE+1024)) {
+            mln_log(error, "Invalid value to 'worker_ipc_shm', at least %u MB.\n", \
+                    (mln_u32_t)((M_ALLOC_SHM_DEFAULT_SIZE+1024+(1<<20)-1) >> 20));
+            exit(1);
+        }
+        worker_shm_size = (mln_size_t)ci->val.i << 20;
+    }
+    cmd = cd->search(cd, "worker_conn_dist");
+    if (cmd != NULL) {
+        if (mln_conf_get_narg(cmd) != 1) {
+            mln_log(error, "'worker_conn_dist' need a boolean argument.\n");
+            exit(1);
+        }
+        mln_conf_item_t *ci = cmd->search(cmd, 1);
+        if (ci->type != CONF_BOOL) {
+            mln_log(error, "'worker_conn_dist' need a boolean argument.\n");
+            exit(1);
+        }
+        worker_conn_dist = ci->val.b? 1: 0;
+    }
+    if (mln_stats_init(n_worker_proc) < 0) {
+        exit(1);
+    }
+    if (mln_log_shm_init(n_worker_proc) < 0) {
+        exit(1);
+    }
     if (!do_fork_worker_process(n_worker_proc)) return 0;
 
     mln_conf_cmd_t **v, **cc;
@@ -290,7 +381,8 @@ int mln_fork_spawn(enum proc_state_type stype, \
                            stype, \
                            args, \
                            n_args, \
-                           master_ev);
+                           master_ev, \
+                           -1);
     if (ret < 0) {
         return -1;
     } else if (ret == 0) {
@@ -314,7 +406,8 @@ int mln_fork_restart(mln_event_t *master_ev)
                         M_PST_SUP, \
                         NULL, \
                         0, \
-                        master_ev);
+                        master_ev, \
+                        worker_id_seq++);
 }
 
 static int
@@ -350,16 +443,40 @@ do_fork_core(enum proc_exec_type etype, \
              enum proc_state_type stype, \
              mln_s8ptr_t *args, \
              mln_u32_t n_args, \
-             mln_event_t *master_ev)
+             mln_event_t *master_ev, \
+             mln_sauto_t worker_id)
 {
-    int fds[2];
+    int fds[2], dist_fds[2] = {-1, -1};
+    mln_ipc_shm_t *shm = NULL;
     if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
         mln_log(error, "socketpair() error. %s\n", strerror(errno));
         return -1;
     }
+    /*
+     * File descriptors are passed by a datagram socketpair, since the
+     * ancillary data would be lost in the byte stream of IPC messages.
+     */
+    if (worker_id >= 0 && worker_conn_dist) {
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, dist_fds) < 0) {
+            mln_log(error, "socketpair() error. %s\n", strerror(errno));
+            mln_socket_close(fds[0]);
+            mln_socket_close(fds[1]);
+            return -1;
+        }
+    }
+    /*
+     * Mapped before fork, so that the pool and the messages have
+     * the same addresses in both processes.
+     */
+    if (worker_id >= 0 && worker_shm_size) {
+        if ((shm = mln_ipc_shm_create(worker_shm_size)) == NULL) {
+            mln_log(error, "Create IPC shared memory for worker process No.%l failed, use socketpair only.\n", worker_id + 1);
+        }
+    }
     pid_t pid = fork();
     if (pid > 0) {
         mln_socket_close(fds[1]);
+        if (dist_fds[1] >= 0) mln_socket_close(dist_fds[1]);
         /*
          * In linux 2.6.32-279, there is a loophole in process restart.
          * If you use select() or kqueue(), you wouldn't get this problem.
@@ -382,6 +499,9 @@ do_fork_core(enum proc_exec_type etype, \
         fattr.n_args = n_args;
         fattr.fd = fds[0];
         fattr.pid = pid;
+        fattr.worker_id = worker_id;
+        fattr.shm = shm;
+        fattr.dist_fd = dist_fds[0];
         fattr.etype = etype;
         fattr.stype = stype;
         mln_fork_t *f = mln_fork_init(&fattr);
@@ -404,14 +524,29 @@ do_fork_core(enum proc_exec_type etype, \
         return 1;
     } else if (pid == 0) {
         mln_socket_close(fds[0]);
+        if (dist_fds[0] >= 0) mln_socket_close(dist_fds[0]);
         mln_fork_destroy_all();
         mln_rbtree_destroy(master_ipc_tree);
         if (rs_clr_handler != NULL)
             rs_clr_handler(rs_clr_data);
         master_ipc_tree = NULL;
+        worker_shm = shm;
+        worker_dist_fd = dist_fds[1];
+        mln_stats_worker_set(worker_id);
+        mln_log_shm_worker_set(worker_id);
         mln_tcp_conn_set_fd(&master_conn, fds[1]);
         signal(SIGCHLD, SIG_DFL);
         signal(wait_signo, SIG_DFL);
+        /*
+         * Pin the worker before it allocates anything, so that its memory
+         * comes from the node of its CPUs. A restarted worker keeps the
+         * affinity of the one it replaces.
+         */
+        if (worker_id >= 0 && n_worker_affinity) {
+            if (mln_affinity_bind(&worker_affinity[worker_id % n_worker_affinity]) < 0) {
+                mln_log(error, "Bind worker process No.%l failed. %s\n", worker_id + 1, strerror(errno));
+            }
+        }
         if (kill(getppid(), wait_signo) < 0) {
             mln_log(error, "kill() error. %s\n", strerror(errno));
             abort();
@@ -419,6 +554,13 @@ do_fork_core(enum proc_exec_type etype, \
         return 0;
     }
     mln_log(error, "fork() error. %s\n", strerror(errno));
+    mln_socket_close(fds[0]);
+    mln_socket_close(fds[1]);
+    if (dist_fds[0] >= 0) {
+        mln_socket_close(dist_fds[0]);
+        mln_socket_close(dist_fds[1]);
+    }
+    mln_ipc_shm_destroy(shm);
     return -1;
 }
 
@@ -671,6 +813,13 @@ mln_ipc_fd_handler_master_process(mln_event_t *ev, mln_fork_t *f)
                 }
                 memcpy(&(f->msg_type), f->msg_content, M_F_TYPELEN);
                 f->state = STATE_IDLE;
+                if (f->msg_type == M_IPC_TYPE_SHM_WAKEUP) {
+                    free(f->msg_content);
+                    f->msg_content = NULL;
+                    if (f->shm != NULL)
+                        mln_ipc_shm_process(ev, f->shm, &(f->shm->to_master), master_ipc_tree, f);
+                    break;
+                }
                 mln_ipc_handler_t ih;
                 ih.type = f->msg_type;
                 mln_rbtree_node_t *rn = mln_rbtree_search(master_ipc_tree, \
@@ -703,10 +852,11 @@ void mln_socketpair_close_handler(mln_event_t *ev, mln_fork_t *f, int fd)
     enum proc_state_type stype = f->stype;
     mln_s8ptr_t *args = f->args;
     mln_u32_t n_args = f->n_args;
+    mln_sauto_t worker_id = f->worker_id;
     if (stype == M_PST_SUP) {
         mln_fork_destroy(f, 0);
         if (etype == M_PET_DFL) {
-            int rv = mln_fork_restart(ev);
+            int rv = do_fork_core(M_PET_DFL, M_PST_SUP, NULL, 0, ev, worker_id);
             if (rv < 0) {
                 mln_log(error, "mln_fork_restart() error.\n");
                 abort();
@@ -780,6 +930,13 @@ mln_ipc_fd_handler_worker_process(mln_event_t *ev, mln_tcp_conn_t *tc)
                 }
                 memcpy(&cur_msg_type, child_msg_content, M_F_TYPELEN);
                 child_state = STATE_IDLE;
+                if (cur_msg_type == M_IPC_TYPE_SHM_WAKEUP) {
+                    free(child_msg_content);
+                    child_msg_content = NULL;
+                    if (worker_shm != NULL)
+                        mln_ipc_shm_process(ev, worker_shm, &(worker_shm->to_worker), worker_ipc_tree, tc);
+                    break;
+                }
                 mln_ipc_handler_t ih;
                 ih.type = cur_msg_type;
                 mln_rbtree_node_t *rn = mln_rbtree_search(worker_ipc_tree, \
@@ -980,8 +1137,362 @@ mln_ipc_fd_handler_worker_send(mln_event_t *ev, int fd, void *data)
 
 
 
+/*
+ * shared memory transport
+ */
+static mln_ipc_shm_t *mln_ipc_shm_create(mln_size_t size)
+{
+    mln_ipc_shm_t *shm;
+    pthread_mutexattr_t mattr;
+    struct mln_alloc_shm_attr_s sattr;
+
+    shm = (mln_ipc_shm_t *)mmap(NULL, sizeof(mln_ipc_shm_t), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if (shm == MAP_FAILED) return NULL;
+    memset(shm, 0, sizeof(mln_ipc_shm_t));
+
+    if (pthread_mutexattr_init(&mattr) != 0) goto err1;
+    if (pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED) != 0) goto err2;
+#if defined(__linux__)
+    /*
+     * The peer may be killed while holding the lock.
+     */
+    if (pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST) != 0) goto err2;
+#endif
+    if (pthread_mutex_init(&(shm->lock), &mattr) != 0) goto err2;
+    pthread_mutexattr_destroy(&mattr);
+
+    sattr.size = size;
+    sattr.locker = &(shm->lock);
+    sattr.lock = mln_ipc_shm_lock;
+    sattr.unlock = mln_ipc_shm_unlock;
+    if ((shm->pool = mln_alloc_shm_init(&sattr)) == NULL) {
+        munmap(shm, sizeof(mln_ipc_shm_t));
+        return NULL;
+    }
+    return shm;
+
+err2:
+    pthread_mutexattr_destroy(&mattr);
+err1:
+    munmap(shm, sizeof(mln_ipc_shm_t));
+    return NULL;
+}
+
+/*
+ * Only unmapped in the calling process, the peer may still use it.
+ */
+static void mln_ipc_shm_destroy(mln_ipc_shm_t *shm)
+{
+    if (shm == NULL) return;
+    mln_alloc_destroy(shm->pool);
+    munmap(shm, sizeof(mln_ipc_shm_t));
+}
+
+static int mln_ipc_shm_lock(void *lock)
+{
+    int rc = pthread_mutex_lock((pthread_mutex_t *)lock);
+#if defined(__linux__)
+    if (rc == EOWNERDEAD) {
+        /*
+         * The dead peer was allocating or freeing, the pool may leak
+         * a little but is still usable.
+         */
+        rc = pthread_mutex_consistent((pthread_mutex_t *)lock);
+    }
+#endif
+    return rc;
+}
+
+static int mln_ipc_shm_unlock(void *lock)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+void *mln_ipc_shm_alloc(mln_fork_t *f_child, mln_size_t len)
+{
+    void *buf;
+    mln_ipc_shm_t *shm = f_child == NULL? worker_shm: f_child->shm;
+
+    if (shm == NULL) return NULL;
+    if (mln_ipc_shm_lock(&(shm->lock)) != 0) return NULL;
+    buf = mln_alloc_m(shm->pool, len);
+    (void)mln_ipc_shm_unlock(&(shm->lock));
+    return buf;
+}
+
+void mln_ipc_shm_free(mln_fork_t *f_child, void *buf)
+{
+    mln_ipc_shm_t *shm = f_child == NULL? worker_shm: f_child->shm;
 
+    if (shm == NULL || buf == NULL) return;
+    if (mln_ipc_shm_lock(&(shm->lock)) != 0) {
+        mln_log(error, "Lock IPC shared memory failed.\n");
+        abort();
+    }
+    mln_alloc_free(buf);
+    (void)mln_ipc_shm_unlock(&(shm->lock));
+}
 
+int mln_ipc_master_send_shm(mln_event_t *ev, \
+                            mln_u32_t type, \
+                            void *buf, \
+                            mln_u32_t len, \
+                            mln_fork_t *f_child)
+{
+    if (f_child->shm == NULL) return -1;
+    return mln_ipc_shm_send(ev, &(f_child->shm->to_worker), type, buf, len, f_child);
+}
+
+int mln_ipc_worker_send_shm(mln_event_t *ev, \
+                            mln_u32_t type, \
+                            void *buf, \
+                            mln_u32_t len)
+{
+    if (worker_shm == NULL) return -1;
+    return mln_ipc_shm_send(ev, &(worker_shm->to_master), type, buf, len, NULL);
+}
+
+/*
+ * If the ring is full, the message is copied into the socketpair as usual.
+ * Messages sent by these two ways are not ordered with each other.
+ */
+static int
+mln_ipc_shm_send(mln_event_t *ev, \
+                 mln_ipc_shm_ring_t *r, \
+                 mln_u32_t type, \
+                 void *buf, \
+                 mln_u32_t len, \
+                 mln_fork_t *f_child)
+{
+    int ret;
+    mln_ipc_shm_msg_t *m;
+    mln_u32_t tail = r->tail;
+
+    if (tail - __atomic_load_n(&(r->head), __ATOMIC_ACQUIRE) >= M_F_SHM_QLEN) {
+        if (f_child != NULL)
+            ret = mln_ipc_master_send_prepare(ev, type, buf, len, f_child);
+        else
+            ret = mln_ipc_worker_send_prepare(ev, type, buf, len);
+        mln_ipc_shm_free(f_child, buf);
+        return ret;
+    }
+
+    m = &(r->msgs[tail & (M_F_SHM_QLEN - 1)]);
+    m->buf = buf;
+    m->type = type;
+    m->len = len;
+    __atomic_store_n(&(r->tail), tail + 1, __ATOMIC_RELEASE);
+
+    /*the receiver is woken up by a message through the socketpair*/
+    if (mln_notifier_arm(&(r->notified))) {
+        if (f_child != NULL)
+            ret = mln_ipc_master_send_prepare(ev, M_IPC_TYPE_SHM_WAKEUP, &type, 0, f_child);
+        else
+            ret = mln_ipc_worker_send_prepare(ev, M_IPC_TYPE_SHM_WAKEUP, &type, 0);
+        if (ret < 0) mln_notifier_disarm(&(r->notified));
+    }
+    return 0;
+}
+
+static void
+mln_ipc_shm_process(mln_event_t *ev, \
+                    mln_ipc_shm_t *shm, \
+                    mln_ipc_shm_ring_t *r, \
+                    mln_rbtree_t *tree, \
+                    void *f_ptr)
+{
+    mln_u32_t head = r->head;
+    mln_ipc_shm_msg_t *m;
+    mln_ipc_handler_t ih, *ihp;
+    mln_rbtree_node_t *rn;
+
+    /*the wakeup message is already consumed*/
+    mln_notifier_drain(&(r->notified), -1);
+
+    while (head != __atomic_load_n(&(r->tail), __ATOMIC_ACQUIRE)) {
+        m = &(r->msgs[head & (M_F_SHM_QLEN - 1)]);
+        ih.type = m->type;
+        rn = mln_rbtree_search(tree, tree->root, &ih);
+        if (!mln_rbtree_null(rn, tree)) {
+            ihp = (mln_ipc_handler_t *)(rn->data);
+            if (ihp->handler != NULL)
+                ihp->handler(ev, f_ptr, m->buf, m->len, &(ihp->data));
+        }
+        if (mln_ipc_shm_lock(&(shm->lock)) != 0) {
+            mln_log(error, "Lock IPC shared memory failed.\n");
+            abort();
+        }
+        mln_alloc_free(m->buf);
+        (void)mln_ipc_shm_unlock(&(shm->lock));
+        __atomic_store_n(&(r->head), ++head, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * connection distribution
+ */
+int mln_fork_dist_listen(mln_event_t *ev, int listen_fd)
+{
+    if (!worker_conn_dist) {
+        mln_log(error, "'worker_conn_dist' is off.\n");
+        return -1;
+    }
+    return mln_event_set_fd(ev, \
+                            listen_fd, \
+                            M_EV_RECV|M_EV_NONBLOCK, \
+                            M_EV_UNLIMITED, \
+                            NULL, \
+                            mln_fork_dist_accept_handler);
+}
+
+static void
+mln_fork_dist_accept_handler(mln_event_t *ev, int fd, void *data)
+{
+    int connfd;
+    mln_fork_t *f, *min;
+
+    while (1) {
+        if ((connfd = accept(fd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                mln_log(error, "accept() error. %s\n", strerror(errno));
+            break;
+        }
+        /*
+         * The load is increased here until the worker reports again,
+         * so that a burst of connections is spread over workers.
+         */
+        for (min = NULL, f = worker_list_head; f != NULL; f = f->next) {
+            if (f->dist_fd < 0 || f->etype != M_PET_DFL) continue;
+            if (min == NULL || f->load < min->load) min = f;
+        }
+        if (min != NULL && mln_fork_dist_fd_send(min->dist_fd, connfd) < 0) {
+            /*its queue is full, try the others*/
+            for (f = worker_list_head; f != NULL; f = f->next) {
+                if (f == min || f->dist_fd < 0 || f->etype != M_PET_DFL) continue;
+                if (mln_fork_dist_fd_send(f->dist_fd, connfd) == 0) break;
+            }
+            min = f;
+        }
+        if (min == NULL) {
+            mln_log(error, "No worker process to accept connection.\n");
+        } else {
+            ++(min->load);
+        }
+        mln_socket_close(connfd);
+    }
+}
+
+static int mln_fork_dist_fd_send(int sock, int fd)
+{
+    char c = 0;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr cm;
+        char           buf[CMSG_SPACE(sizeof(int))];
+    } ctl;
+
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctl, 0, sizeof(ctl));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(sock, &msg, MSG_DONTWAIT) == 1? 0: -1;
+}
+
+int mln_set_worker_dist_handler(mln_event_t *ev, dist_handler handler, void *data)
+{
+    if (worker_dist_fd < 0) return -1;
+    worker_dist_handler = handler;
+    worker_dist_data = data;
+    return mln_event_set_fd(ev, \
+                            worker_dist_fd, \
+                            M_EV_RECV|M_EV_NONBLOCK, \
+                            M_EV_UNLIMITED, \
+                            NULL, \
+                            mln_fork_dist_recv_handler);
+}
+
+static void
+mln_fork_dist_recv_handler(mln_event_t *ev, int fd, void *data)
+{
+    char c;
+    int connfd, tmp;
+    ssize_t n;
+    mln_u8ptr_t p, end;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr cm;
+        char           buf[CMSG_SPACE(sizeof(int))];
+    } ctl;
+
+    while (1) {
+        iov.iov_base = &c;
+        iov.iov_len = 1;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof(ctl.buf);
+#if defined(MSG_CMSG_CLOEXEC)
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+#else
+        n = recvmsg(fd, &msg, 0);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        /*
+         * Exactly one fd is passed each time,
+         * any other received fd is closed rather than leaked.
+         */
+        connfd = -1;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            end = (mln_u8ptr_t)cmsg + cmsg->cmsg_len;
+            for (p = CMSG_DATA(cmsg); p + sizeof(int) <= end; p += sizeof(int)) {
+                memcpy(&tmp, p, sizeof(int));
+                if (connfd < 0 && n == 1 && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) connfd = tmp;
+                else close(tmp);
+            }
+        }
+        if (n == 0) {
+            if (connfd >= 0) close(connfd);
+            break;
+        }
+        if (connfd < 0) continue;
+#if !defined(MSG_CMSG_CLOEXEC)
+        fcntl(connfd, F_SETFD, FD_CLOEXEC);
+#endif
+        worker_dist_handler(ev, connfd, worker_dist_data);
+    }
+}
+
+int mln_fork_dist_load_report(mln_event_t *ev, mln_u32_t load)
+{
+    return mln_ipc_worker_send_prepare(ev, M_IPC_TYPE_LOAD, &load, sizeof(load));
+}
+
+static void
+mln_fork_dist_load_handler(mln_event_t *ev, void *f_ptr, void *buf, mln_u32_t len, void **udata_ptr)
+{
+    if (len != sizeof(mln_u32_t)) return;
+    memcpy(&(((mln_fork_t *)f_ptr)->load), buf, sizeof(mln_u32_t));
+}
 
 /*chain*/
 MLN_CHAIN_FUNC_DEFINE(worker_list, \
@@ -6,8 +6,10 @@
 #include <stdlib.h>
 #include "mln_prime_generator.h"
 #include "mln_hash.h"
+#include "mln_string.h"
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 MLN_CHAIN_FUNC_DECLARE(mln_hash_entry, \
                        mln_hash_entry_t, \
@@ -16,7 +18,7 @@ MLN_CHAIN_FUNC_DECLARE(mln_hash_entry_cache, \
                        mln_hash_entry_t, \
                        static inline void,);
 static inline mln_hash_entry_t *
-mln_hash_entry_new(mln_hash_t *h, void *key, void *val) __NONNULL3(1,2,3);
+mln_hash_entry_new(mln_hash_t *h, void *key, void *val, mln_u64_t hv) __NONNULL2(1,2);
 static inline void
 mln_hash_entry_free(mln_hash_t *h, mln_hash_entry_t *he, mln_hash_flag_t flg) __NONNULL1(1);
 static inline void
@@ -25,6 +27,32 @@ static inline void
 mln_hash_expand(mln_hash_t *h) __NONNULL1(1);
 static inline void
 mln_move_hash_entry(mln_hash_t *h, mln_hash_mgr_t *old_tbl, mln_u32_t old_len) __NONNULL2(1,2);
+static inline mln_u64_t
+mln_hash_mix(mln_u64_t hv);
+static inline mln_hash_mgr_t *
+mln_hash_tbl_new(mln_hash_t *h, mln_u64_t len) __NONNULL1(1);
+static inline void
+mln_hash_tbl_free(mln_hash_t *h, mln_hash_mgr_t *tbl) __NONNULL2(1,2);
+static inline mln_u64_t
+mln_hash_raw(mln_hash_t *h, void *key) __NONNULL2(1,2);
+static inline mln_u64_t
+mln_hash_index(mln_hash_t *h, mln_u64_t hv, mln_u64_t len) __NONNULL1(1);
+static inline mln_u64_t
+mln_hash_entry_index(mln_hash_t *h, mln_hash_entry_t *he) __NONNULL2(1,2);
+static inline int
+mln_hash_key_match(mln_hash_t *h, void *key, mln_u64_t hv, mln_hash_entry_t *he) __NONNULL3(1,2,4);
+static inline mln_hash_entry_t *
+mln_hash_lookup(mln_hash_t *h, void *key, mln_u64_t hv, mln_hash_mgr_t **pmgr) __NONNULL3(1,2,4);
+static inline void
+mln_hash_resize_check(mln_hash_t *h) __NONNULL1(1);
+static inline void
+mln_hash_progressive_resize(mln_hash_t *h, mln_u64_t len) __NONNULL1(1);
+static inline void
+mln_hash_rehash_step(mln_hash_t *h) __NONNULL1(1);
+static inline mln_hash_mgr_t *
+mln_hash_old_bucket(mln_hash_t *h, mln_u64_t hv) __NONNULL1(1);
+static inline mln_hash_entry_t *
+mln_hash_iterator_next(mln_hash_entry_t *he, mln_hash_mgr_t *old) __NONNULL1(1);
 
 mln_hash_t *
 mln_hash_init(struct mln_hash_attr *attr)
@@ -44,27 +72,32 @@ mln_hash_init(struct mln_hash_attr *attr)
     h->cmp = attr->cmp;
     h->free_key = attr->free_key;
     h->free_val = attr->free_val;
-    h->len = attr->calc_prime? mln_prime_calc(attr->len_base): attr->len_base;
-    if (h->pool != NULL) {
-        h->tbl = (mln_hash_mgr_t *)h->pool_alloc(h->pool, h->len*sizeof(mln_hash_mgr_t));
-        memset(h->tbl, 0, h->len*sizeof(mln_hash_mgr_t));
+    h->progressive = attr->progressive;
+    h->key_type = attr->key_type;
+    h->nocase = attr->nocase;
+    if (h->progressive) {
+        for (h->len = 1; h->len < attr->len_base; h->len <<= 1)
+            ;
     } else {
-        h->tbl = (mln_hash_mgr_t *)calloc(h->len, sizeof(mln_hash_mgr_t));
+        h->len = attr->calc_prime? mln_prime_calc(attr->len_base): attr->len_base;
     }
+    h->tbl = mln_hash_tbl_new(h, h->len);
     if (h->tbl == NULL) {
         if (h->pool != NULL) h->pool_free(h);
         else free(h);
         return NULL;
     }
+    h->old_tbl = NULL;
+    h->old_len = 0;
+    h->rehash_pos = 0;
     h->cache_head = h->cache_tail = NULL;
     h->nr_nodes = 0;
-    h->threshold = attr->calc_prime? mln_prime_calc(h->len << 1): h->len << 1;
     h->expandable = attr->expandable;
-    h->calc_prime = attr->calc_prime;
+    h->calc_prime = h->progressive? 0: attr->calc_prime;
+    h->threshold = h->calc_prime? mln_prime_calc(h->len << 1): h->len << 1;
     h->cache = attr->cache;
     if (h->len == 0 || \
-            h->hash == NULL || \
-            h->cmp == NULL)
+            (h->key_type == M_HASH_KEY_CUSTOM && (h->hash == NULL || h->cmp == NULL)))
     {
         if (h->pool != NULL) {
             h->pool_free(h->tbl);
@@ -82,7 +115,21 @@ void
 mln_hash_destroy(mln_hash_t *h, mln_hash_flag_t flg)
 {
     mln_hash_entry_t *he, *fr;
-    mln_hash_mgr_t *mgr, *mgr_end = h->tbl + h->len;
+    mln_hash_mgr_t *mgr, *mgr_end;
+    if (h->old_tbl != NULL) {
+        mgr_end = h->old_tbl + h->old_len;
+        for (mgr = h->old_tbl + h->rehash_pos; mgr < mgr_end; ++mgr) {
+            he = mgr->head;
+            while (he != NULL) {
+                fr = he;
+                he = he->next;
+                fr->hash = NULL;
+                mln_hash_entry_free(h, fr, flg);
+            }
+        }
+        mln_hash_tbl_free(h, h->old_tbl);
+    }
+    mgr_end = h->tbl + h->len;
     for (mgr = h->tbl; mgr < mgr_end; ++mgr) {
         he = mgr->head;
         while (he != NULL) {
@@ -106,15 +153,20 @@ mln_hash_destroy(mln_hash_t *h, mln_hash_flag_t flg)
 }
 
 int mln_hash_replace(mln_hash_t *h, void *key, void *val)
+{
+    return mln_hash_replace_hv(h, key, val, mln_hash_raw(h, *((void **)key)));
+}
+
+int mln_hash_replace_hv(mln_hash_t *h, void *key, void *val, mln_u64_t hv)
 {
     void **k = (void **)key;
     void **v = (void **)val;
-    mln_u32_t index = h->hash(h, *k);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
+    mln_hash_mgr_t *mgr;
     mln_hash_entry_t *he;
-    for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, *k, he->key)) break;
-    }
+
+    if (h->progressive) mln_hash_rehash_step(h);
+
+    he = mln_hash_lookup(h, *k, hv, &mgr);
     if (he != NULL) {
         void *save_key = he->key;
         void *save_val = he->val;
@@ -125,13 +177,9 @@ int mln_hash_replace(mln_hash_t *h, void *key, void *val)
         return 0;
     }
 
-    if (h->expandable && h->nr_nodes > h->threshold) {
-        mln_hash_expand(h);
-    }
-    if (h->expandable && h->nr_nodes <= (h->threshold >> 3)) {
-        mln_hash_reduce(h);
-    }
-    he = mln_hash_entry_new(h, *k, *v);
+    mln_hash_resize_check(h);
+    mgr = &(h->tbl[mln_hash_index(h, hv, h->len)]);
+    he = mln_hash_entry_new(h, *k, *v, hv);
     if (he == NULL) return -1;
     mln_hash_entry_chain_add(&(mgr->head), &(mgr->tail), he);
     ++(h->nr_nodes);
@@ -141,15 +189,15 @@ int mln_hash_replace(mln_hash_t *h, void *key, void *val)
 
 int mln_hash_insert(mln_hash_t *h, void *key, void *val)
 {
-    if (h->expandable && h->nr_nodes > h->threshold) {
-        mln_hash_expand(h);
-    }
-    if (h->expandable && h->nr_nodes <= (h->threshold >> 3)) {
-        mln_hash_reduce(h);
-    }
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
-    mln_hash_entry_t *he = mln_hash_entry_new(h, key, val);
+    return mln_hash_insert_hv(h, key, val, mln_hash_raw(h, key));
+}
+
+int mln_hash_insert_hv(mln_hash_t *h, void *key, void *val, mln_u64_t hv)
+{
+    if (h->progressive) mln_hash_rehash_step(h);
+    mln_hash_resize_check(h);
+    mln_hash_mgr_t *mgr = &(h->tbl[mln_hash_index(h, hv, h->len)]);
+    mln_hash_entry_t *he = mln_hash_entry_new(h, key, val, hv);
     if (he == NULL) return -1;
     mln_hash_entry_chain_add(&(mgr->head), &(mgr->tail), he);
     ++(h->nr_nodes);
@@ -162,12 +210,7 @@ static inline void mln_hash_reduce(mln_hash_t *h)
     mln_u32_t len = h->len;
     h->len = h->calc_prime? mln_prime_calc(h->threshold >> 2): h->threshold >> 2;
     if (h->len == 0) h->len = 1;
-    if (h->pool != NULL) {
-        h->tbl = (mln_hash_mgr_t *)h->pool_alloc(h->pool, h->len*sizeof(mln_hash_mgr_t));
-        memset(h->tbl, 0, h->len*sizeof(mln_hash_mgr_t));
-    } else {
-        h->tbl = (mln_hash_mgr_t *)calloc(h->len, sizeof(mln_hash_mgr_t));
-    }
+    h->tbl = mln_hash_tbl_new(h, h->len);
     if (h->tbl == NULL) {
         h->tbl = old_tbl;
         h->len = len;
@@ -184,12 +227,7 @@ static inline void mln_hash_expand(mln_hash_t *h)
     mln_hash_mgr_t *old_tbl = h->tbl;
     mln_u32_t len = h->len;
     h->len = h->calc_prime? mln_prime_calc(len + (len >> 1)): (len + (len >> 1));
-    if (h->pool != NULL) {
-        h->tbl = (mln_hash_mgr_t *)h->pool_alloc(h->pool, h->len*sizeof(mln_hash_mgr_t));
-        memset(h->tbl, 0, h->len*sizeof(mln_hash_mgr_t));
-    } else {
-        h->tbl = (mln_hash_mgr_t *)calloc(h->len, sizeof(mln_hash_mgr_t));
-    }
+    h->tbl = mln_hash_tbl_new(h, h->len);
     if (h->tbl == NULL) {
         h->tbl = old_tbl;
         h->len = len;
@@ -208,26 +246,220 @@ mln_move_hash_entry(mln_hash_t *h, mln_hash_mgr_t *old_tbl, mln_u32_t old_len)
     mln_hash_mgr_t *old_end = old_tbl + old_len;
     mln_hash_mgr_t *new_mgr;
     mln_hash_entry_t *he;
-    mln_u32_t index;
 
     for (; old_tbl < old_end; ++old_tbl) {
         while ((he = old_tbl->head) != NULL) {
             mln_hash_entry_chain_del(&(old_tbl->head), &(old_tbl->tail), he);
-            index = h->hash(h, he->key);
-            new_mgr = &(h->tbl[index]);
+            new_mgr = &(h->tbl[mln_hash_entry_index(h, he)]);
             mln_hash_entry_chain_add(&(new_mgr->head), &(new_mgr->tail), he);
         }
     }
 }
 
-void *mln_hash_change_value(mln_hash_t *h, void *key, void *new_value)
+static inline mln_hash_mgr_t *mln_hash_tbl_new(mln_hash_t *h, mln_u64_t len)
+{
+    mln_hash_mgr_t *tbl;
+    if (h->pool != NULL) {
+        tbl = (mln_hash_mgr_t *)h->pool_alloc(h->pool, len*sizeof(mln_hash_mgr_t));
+        if (tbl != NULL) memset(tbl, 0, len*sizeof(mln_hash_mgr_t));
+    } else {
+        tbl = (mln_hash_mgr_t *)calloc(len, sizeof(mln_hash_mgr_t));
+    }
+    return tbl;
+}
+
+static inline void mln_hash_tbl_free(mln_hash_t *h, mln_hash_mgr_t *tbl)
+{
+    if (h->pool != NULL) h->pool_free(tbl);
+    else free(tbl);
+}
+
+/*
+ * progressive mode
+ *
+ * The hash handler returns a raw hash value instead of a bucket index,
+ * it is mixed and masked by the power-of-two table length here.
+ */
+static inline mln_u64_t mln_hash_mix(mln_u64_t hv)
 {
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
+    hv ^= hv >> 33;
+    hv *= (mln_u64_t)0xff51afd7ed558ccdULL;
+    hv ^= hv >> 33;
+    hv *= (mln_u64_t)0xc4ceb9fe1a85ec53ULL;
+    hv ^= hv >> 33;
+    return hv;
+}
+
+/*
+ * For string keys and in progressive mode, the raw hash value is kept in
+ * the entry, so rehashing never calls the hash handler and lookups compare
+ * the hash values before the keys.
+ * Otherwise, the hash handler returns the bucket index directly.
+ */
+static inline mln_u64_t mln_hash_raw(mln_hash_t *h, void *key)
+{
+    switch (h->key_type) {
+        case M_HASH_KEY_STRING:
+            return mln_hash_string_calc(((mln_string_t *)key)->data, ((mln_string_t *)key)->len, h->nocase);
+        case M_HASH_KEY_CSTR:
+            return mln_hash_string_calc((mln_u8ptr_t)key, strlen((char *)key), h->nocase);
+        default:
+            return h->hash(h, key);
+    }
+}
+
+static inline mln_u64_t mln_hash_index(mln_hash_t *h, mln_u64_t hv, mln_u64_t len)
+{
+    if (h->progressive) {
+        if (h->key_type == M_HASH_KEY_CUSTOM) hv = mln_hash_mix(hv);
+        return hv & (len - 1);
+    }
+    if (h->key_type != M_HASH_KEY_CUSTOM) return hv % len;
+    return hv;
+}
+
+static inline mln_u64_t mln_hash_entry_index(mln_hash_t *h, mln_hash_entry_t *he)
+{
+    if (h->progressive || h->key_type != M_HASH_KEY_CUSTOM)
+        return mln_hash_index(h, he->hval, h->len);
+    return h->hash(h, he->key);
+}
+
+static inline int
+mln_hash_key_match(mln_hash_t *h, void *key, mln_u64_t hv, mln_hash_entry_t *he)
+{
+    switch (h->key_type) {
+        case M_HASH_KEY_STRING:
+            if (he->hval != hv) return 0;
+            if (h->nocase) return !mln_string_strcasecmp((mln_string_t *)key, (mln_string_t *)(he->key));
+            return !mln_string_strcmp((mln_string_t *)key, (mln_string_t *)(he->key));
+        case M_HASH_KEY_CSTR:
+            if (he->hval != hv) return 0;
+            if (h->nocase) return !strcasecmp((char *)key, (char *)(he->key));
+            return !strcmp((char *)key, (char *)(he->key));
+        default:
+            if (h->progressive && he->hval != hv) return 0;
+            return h->cmp(h, key, he->key);
+    }
+}
+
+static inline mln_hash_entry_t *
+mln_hash_lookup(mln_hash_t *h, void *key, mln_u64_t hv, mln_hash_mgr_t **pmgr)
+{
+    mln_hash_mgr_t *mgr;
     mln_hash_entry_t *he;
+
+    *pmgr = mgr = &(h->tbl[mln_hash_index(h, hv, h->len)]);
     for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, key, he->key)) break;
+        if (mln_hash_key_match(h, key, hv, he)) return he;
+    }
+    if ((mgr = mln_hash_old_bucket(h, hv)) != NULL) {
+        for (he = mgr->head; he != NULL; he = he->next) {
+            if (mln_hash_key_match(h, key, hv, he)) {
+                *pmgr = mgr;
+                return he;
+            }
+        }
+    }
+    return NULL;
+}
+
+static inline void mln_hash_resize_check(mln_hash_t *h)
+{
+    if (!h->expandable) return;
+    if (h->progressive) {
+        if (h->old_tbl != NULL) return;
+        if (h->nr_nodes > h->threshold) {
+            mln_hash_progressive_resize(h, h->len << 1);
+        } else if (h->len > 1 && h->nr_nodes <= (h->threshold >> 3)) {
+            mln_hash_progressive_resize(h, h->len >> 1);
+        }
+        return;
+    }
+    if (h->nr_nodes > h->threshold) {
+        mln_hash_expand(h);
+    }
+    if (h->nr_nodes <= (h->threshold >> 3)) {
+        mln_hash_reduce(h);
+    }
+}
+
+/*
+ * Both tables stay live until every bucket of the old one is migrated.
+ * New entries always go into the new table.
+ */
+static inline void mln_hash_progressive_resize(mln_hash_t *h, mln_u64_t len)
+{
+    mln_hash_mgr_t *tbl = mln_hash_tbl_new(h, len);
+    if (tbl == NULL) return;
+    h->old_tbl = h->tbl;
+    h->old_len = h->len;
+    h->rehash_pos = 0;
+    h->tbl = tbl;
+    h->len = len;
+    h->threshold = len << 1;
+}
+
+static inline void mln_hash_rehash_step(mln_hash_t *h)
+{
+    mln_hash_mgr_t *mgr, *new_mgr;
+    mln_hash_entry_t *he;
+    int moved = 0, visited = 0;
+
+    if (h->old_tbl == NULL) return;
+
+    while (h->rehash_pos < h->old_len && \
+           moved < M_HASH_REHASH_STEP && \
+           visited < M_HASH_REHASH_STEP * 10)
+    {
+        mgr = &(h->old_tbl[h->rehash_pos++]);
+        ++visited;
+        if (mgr->head == NULL) continue;
+        while ((he = mgr->head) != NULL) {
+            mln_hash_entry_chain_del(&(mgr->head), &(mgr->tail), he);
+            new_mgr = &(h->tbl[mln_hash_entry_index(h, he)]);
+            mln_hash_entry_chain_add(&(new_mgr->head), &(new_mgr->tail), he);
+        }
+        ++moved;
+    }
+    if (h->rehash_pos >= h->old_len) {
+        mln_hash_tbl_free(h, h->old_tbl);
+        h->old_tbl = NULL;
+        h->old_len = 0;
+        h->rehash_pos = 0;
     }
+}
+
+/*
+ * The bucket of the old table which may still hold entries of hv, NULL if it is migrated.
+ */
+static inline mln_hash_mgr_t *mln_hash_old_bucket(mln_hash_t *h, mln_u64_t hv)
+{
+    mln_u64_t index;
+
+    if (h->old_tbl == NULL) return NULL;
+    index = mln_hash_index(h, hv, h->old_len);
+    return index < h->rehash_pos? NULL: &(h->old_tbl[index]);
+}
+
+/*
+ * While rehashing, the chain of the new table is followed by the one of the old table.
+ */
+static inline mln_hash_entry_t *mln_hash_iterator_next(mln_hash_entry_t *he, mln_hash_mgr_t *old)
+{
+    if (he->next != NULL || old == NULL || he == old->tail) return he->next;
+    return old->head;
+}
+
+void *mln_hash_change_value(mln_hash_t *h, void *key, void *new_value)
+{
+    return mln_hash_change_value_hv(h, key, new_value, mln_hash_raw(h, key));
+}
+
+void *mln_hash_change_value_hv(mln_hash_t *h, void *key, void *new_value, mln_u64_t hv)
+{
+    mln_hash_mgr_t *mgr;
+    mln_hash_entry_t *he = mln_hash_lookup(h, key, hv, &mgr);
     if (he == NULL) return NULL;
     mln_u8ptr_t retval = (mln_u8ptr_t)(he->val);
     he->val = new_value;
@@ -236,49 +468,51 @@ void *mln_hash_change_value(mln_hash_t *h, void *key, void *new_value)
 
 void *mln_hash_search(mln_hash_t *h, void *key)
 {
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
-    mln_hash_entry_t *he;
-    for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, key, he->key)) break;
-    }
+    return mln_hash_search_hv(h, key, mln_hash_raw(h, key));
+}
+
+void *mln_hash_search_hv(mln_hash_t *h, void *key, mln_u64_t hv)
+{
+    mln_hash_mgr_t *mgr;
+    mln_hash_entry_t *he = mln_hash_lookup(h, key, hv, &mgr);
     if (he == NULL) return NULL;
     return he->val;
 }
 
 void *mln_hash_search_iterator(mln_hash_t *h, void *key, int **ctx)
 {
+    mln_u64_t hv = mln_hash_raw(h, key);
+    mln_hash_mgr_t *old = mln_hash_old_bucket(h, hv);
+    mln_hash_entry_t *he;
+
     if (*ctx != NULL) {
-        mln_hash_entry_t *he = *((mln_hash_entry_t **)ctx);
-        for (; he != NULL; he = he->next) {
-            if (h->cmp(h, key, he->key)) break;
-        }
-        if (he == NULL) {
-            *ctx = NULL;
-            return NULL;
-        }
-        *ctx = (int *)(he->next);
-        return he->val;
+        he = *((mln_hash_entry_t **)ctx);
+    } else {
+        he = h->tbl[mln_hash_index(h, hv, h->len)].head;
+        if (he == NULL && old != NULL) he = old->head;
     }
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
-    mln_hash_entry_t *he;
-    for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, key, he->key)) break;
+    for (; he != NULL; he = mln_hash_iterator_next(he, old)) {
+        if (mln_hash_key_match(h, key, hv, he)) break;
     }
-    if (he == NULL) return NULL;
-    *ctx = (int *)(he->next);
+    if (he == NULL) {
+        *ctx = NULL;
+        return NULL;
+    }
+    *ctx = (int *)mln_hash_iterator_next(he, old);
     return he->val;
 }
 
 void mln_hash_remove(mln_hash_t *h, void *key, mln_hash_flag_t flg)
 {
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
+    mln_hash_remove_hv(h, key, flg, mln_hash_raw(h, key));
+}
+
+void mln_hash_remove_hv(mln_hash_t *h, void *key, mln_hash_flag_t flg, mln_u64_t hv)
+{
+    mln_hash_mgr_t *mgr;
     mln_hash_entry_t *he;
-    for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, key, he->key)) break;
-    }
+    if (h->progressive) mln_hash_rehash_step(h);
+    he = mln_hash_lookup(h, key, hv, &mgr);
     if (he == NULL) return;
     mln_hash_entry_chain_del(&(mgr->head), &(mgr->tail), he);
     --(h->nr_nodes);
@@ -286,7 +520,7 @@ void mln_hash_remove(mln_hash_t *h, void *key, mln_hash_flag_t flg)
 }
 
 static inline mln_hash_entry_t *
-mln_hash_entry_new(mln_hash_t *h, void *key, void *val)
+mln_hash_entry_new(mln_hash_t *h, void *key, void *val, mln_u64_t hv)
 {
     mln_hash_entry_t *he;
     if ((he = h->cache_head) != NULL) {
@@ -303,6 +537,7 @@ mln_hash_entry_new(mln_hash_t *h, void *key, void *val)
     }
     he->val = val;
     he->key = key;
+    he->hval = hv;
     he->prev = he->next = NULL;
     return he;
 }
@@ -339,9 +574,18 @@ mln_hash_entry_free(mln_hash_t *h, mln_hash_entry_t *he, mln_hash_flag_t flg)
 int mln_hash_scan_all(mln_hash_t *h, hash_scan_handler handler, void *udata)
 {
     mln_hash_mgr_t *mgr, *end;
+    mln_hash_entry_t *he;
+    if (h->old_tbl != NULL) {
+        end = h->old_tbl + h->old_len;
+        for (mgr = h->old_tbl + h->rehash_pos; mgr < end; ++mgr) {
+            for (he = mgr->head; he != NULL; he = he->next) {
+                if (handler != NULL && handler(he->key, he->val, udata) < 0)
+                    return -1;
+            }
+        }
+    }
     mgr = h->tbl;
     end = h->tbl + h->len;
-    mln_hash_entry_t *he;
     for (; mgr < end; ++mgr) {
         for (he = mgr->head; he != NULL; he = he->next) {
             if (handler != NULL && handler(he->key, he->val, udata) < 0)
@@ -353,21 +597,35 @@ int mln_hash_scan_all(mln_hash_t *h, hash_scan_handler handler, void *udata)
 
 int mln_hash_key_exist(mln_hash_t *h, void *key)
 {
-    mln_u32_t index = h->hash(h, key);
-    mln_hash_mgr_t *mgr = &(h->tbl[index]);
-    mln_hash_entry_t *he;
-    for (he = mgr->head; he != NULL; he = he->next) {
-        if (h->cmp(h, key, he->key)) return 1;
-    }
-    return 0;
+    return mln_hash_key_exist_hv(h, key, mln_hash_raw(h, key));
+}
+
+int mln_hash_key_exist_hv(mln_hash_t *h, void *key, mln_u64_t hv)
+{
+    mln_hash_mgr_t *mgr;
+    return mln_hash_lookup(h, key, hv, &mgr) != NULL;
 }
 
 void mln_hash_reset(mln_hash_t *h, mln_hash_flag_t flg)
 {
     mln_hash_mgr_t *mgr, *end;
+    mln_hash_entry_t *he;
+    if (h->old_tbl != NULL) {
+        /*entries are freed where they are, nothing is migrated*/
+        end = h->old_tbl + h->old_len;
+        for (mgr = h->old_tbl + h->rehash_pos; mgr < end; ++mgr) {
+            while ((he = mgr->head) != NULL) {
+                mln_hash_entry_chain_del(&(mgr->head), &(mgr->tail), he);
+                mln_hash_entry_free(h, he, flg);
+            }
+        }
+        mln_hash_tbl_free(h, h->old_tbl);
+        h->old_tbl = NULL;
+        h->old_len = 0;
+        h->rehash_pos = 0;
+    }
     mgr = h->tbl;
     end = h->tbl + h->len;
-    mln_hash_entry_t *he;
     for (; mgr < end; ++mgr) {
         while ((he = mgr->head) != NULL) {
             mln_hash_entry_chain_del(&(mgr->head), &(mgr->tail), he);
@@ -378,6 +636,99 @@ void mln_hash_reset(mln_hash_t *h, mln_hash_flag_t flg)
     h->nr_nodes = 0;
 }
 
+/*
+ * String hash, a wyhash variant.
+ * Input is read eight bytes a time, and if nocase is set,
+ * ASCII upper case letters are folded in the whole word at once.
+ */
+#define M_HASH_S0 ((mln_u64_t)0xa0761d6478bd642fULL)
+#define M_HASH_S1 ((mln_u64_t)0xe7037ed1a0b428dbULL)
+#define M_HASH_S2 ((mln_u64_t)0x8ebc6af09c88c6e3ULL)
+#define M_HASH_S3 ((mln_u64_t)0x589965cc75374cc3ULL)
+#define M_HASH_ONES ((mln_u64_t)0x0101010101010101ULL)
+
+static inline mln_u64_t mln_hash_fold(mln_u64_t w)
+{
+    mln_u64_t low = w & (M_HASH_ONES * 0x7f);
+    mln_u64_t ge_a = low + M_HASH_ONES * (0x80 - 'A');
+    mln_u64_t gt_z = low + M_HASH_ONES * (0x7f - 'Z');
+    return w | (((ge_a & ~gt_z & ~w) & (M_HASH_ONES * 0x80)) >> 2);
+}
+
+static inline mln_u64_t mln_hash_r8(mln_u8ptr_t p, int nocase)
+{
+    mln_u64_t v;
+    memcpy(&v, p, sizeof(v));
+    return nocase? mln_hash_fold(v): v;
+}
+
+static inline mln_u64_t mln_hash_r4(mln_u8ptr_t p, int nocase)
+{
+    mln_u32_t v;
+    memcpy(&v, p, sizeof(v));
+    return nocase? mln_hash_fold((mln_u64_t)v): (mln_u64_t)v;
+}
+
+static inline mln_u64_t mln_hash_r3(mln_u8ptr_t p, mln_u64_t len, int nocase)
+{
+    mln_u64_t v = ((mln_u64_t)p[0] << 16) | ((mln_u64_t)p[len >> 1] << 8) | p[len - 1];
+    return nocase? mln_hash_fold(v): v;
+}
+
+static inline mln_u64_t mln_hash_mum(mln_u64_t a, mln_u64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    return (mln_u64_t)r ^ (mln_u64_t)(r >> 64);
+#else
+    mln_u64_t ha = a >> 32, hb = b >> 32, la = (mln_u32_t)a, lb = (mln_u32_t)b, hi, lo;
+    mln_u64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+mln_u64_t mln_hash_string_calc(mln_u8ptr_t data, mln_u64_t len, int nocase)
+{
+    mln_u8ptr_t p = data;
+    mln_u64_t seed = mln_hash_mum(M_HASH_S0, M_HASH_S1), a, b, i;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (mln_hash_r4(p, nocase) << 32) | mln_hash_r4(p + ((len >> 3) << 2), nocase);
+            b = (mln_hash_r4(p + len - 4, nocase) << 32) | mln_hash_r4(p + len - 4 - ((len >> 3) << 2), nocase);
+        } else if (len > 0) {
+            a = mln_hash_r3(p, len, nocase);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        i = len;
+        if (i > 48) {
+            mln_u64_t see1 = seed, see2 = seed;
+            do {
+                seed = mln_hash_mum(mln_hash_r8(p, nocase) ^ M_HASH_S1, mln_hash_r8(p + 8, nocase) ^ seed);
+                see1 = mln_hash_mum(mln_hash_r8(p + 16, nocase) ^ M_HASH_S2, mln_hash_r8(p + 24, nocase) ^ see1);
+                see2 = mln_hash_mum(mln_hash_r8(p + 32, nocase) ^ M_HASH_S3, mln_hash_r8(p + 40, nocase) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mln_hash_mum(mln_hash_r8(p, nocase) ^ M_HASH_S1, mln_hash_r8(p + 8, nocase) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = mln_hash_r8(p + i - 16, nocase);
+        b = mln_hash_r8(p + i - 8, nocase);
+    }
+    return mln_hash_mum(M_HASH_S1 ^ len, mln_hash_mum(a ^ M_HASH_S1, b ^ seed));
+}
+
 MLN_CHAIN_FUNC_DEFINE(mln_hash_entry, \
                       mln_hash_entry_t, \
                       static inline void, \
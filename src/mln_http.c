@@ -23,8 +23,6 @@ static inline int mln_http_process_line(mln_http_t *http, mln_chain_t **in, mln_
 static inline int mln_http_parse_headline(mln_http_t *http, mln_u8ptr_t buf, mln_size_t len);
 static inline int mln_http_parse_field(mln_http_t *http, mln_u8ptr_t buf, mln_size_t len);
 static void mln_http_hash_free(void *data);
-static mln_u64_t mln_http_hash_calc(mln_hash_t *h, void *key);
-static int mln_http_hash_cmp(mln_hash_t *h, void *key1, void *key2);
 static inline int mln_http_atou(mln_string_t *s, mln_u32_t *status);
 static int mln_http_dump_scan(void *key, void *val, void *data);
 static inline int
@@ -885,14 +883,17 @@ mln_http_t *mln_http_init(mln_tcp_conn_t *connection, void *data, mln_http_handl
     hattr.pool = pool;
     hattr.pool_alloc = (hash_pool_alloc_handler)mln_alloc_m;
     hattr.pool_free = (hash_pool_free_handler)mln_alloc_free;
-    hattr.hash = mln_http_hash_calc;
-    hattr.cmp = mln_http_hash_cmp;
+    hattr.hash = NULL;
+    hattr.cmp = NULL;
     hattr.free_key = mln_http_hash_free;
     hattr.free_val = mln_http_hash_free;
     hattr.len_base = M_HTTP_HASH_LEN;
     hattr.expandable = 0;
     hattr.calc_prime = 0;
     hattr.cache = 0;
+    hattr.progressive = 0;
+    hattr.key_type = M_HASH_KEY_STRING;
+    hattr.nocase = 1;
     http->header_fields = mln_hash_init(&hattr);
     if (http->header_fields == NULL) {
         mln_alloc_free(http);
@@ -973,24 +974,6 @@ static void mln_http_hash_free(void *data)
     mln_string_free((mln_string_t *)data);
 }
 
-static mln_u64_t mln_http_hash_calc(mln_hash_t *h, void *key)
-{
-    mln_u64_t index = 0;
-    mln_string_t *s = (mln_string_t *)key;
-    mln_u8ptr_t p, end = s->data + s->len;
-
-    for (p = s->data; p < end; ++p) {
-        index += (((mln_u64_t)(*p)) * 3);
-    }
-
-    return index % h->len;
-}
-
-static int mln_http_hash_cmp(mln_hash_t *h, void *key1, void *key2)
-{
-    return !mln_string_strcasecmp((mln_string_t *)key1, (mln_string_t *)key2);
-}
-
 /*
  * dump
  */
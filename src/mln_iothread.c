@@ -7,50 +7,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <signal.h>
-#if defined(WIN32)
-#include <winsock2.h>
-#else
-#include <sys/socket.h>
+#include <sched.h>
+#include <unistd.h>
+#include "mln_notifier.h"
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #endif
 
-static inline void mln_iothread_fd_nonblock_set(int fd);
-static inline mln_iothread_msg_t *mln_iothread_msg_new(mln_u32_t type, void *data, int feedback);
-static inline void mln_iothread_msg_free(mln_iothread_msg_t *msg);
-MLN_CHAIN_FUNC_DECLARE(mln_iothread_msg, mln_iothread_msg_t, static inline void,);
-MLN_CHAIN_FUNC_DEFINE(mln_iothread_msg, mln_iothread_msg_t, static inline void, prev, next);
+static inline int mln_iothread_fds_init(mln_iothread_t *t);
+static inline mln_iothread_msg_t *mln_iothread_msg_new(mln_iothread_t *t, mln_u32_t type, void *data, int feedback);
+static inline void mln_iothread_msg_free(mln_iothread_t *t, mln_iothread_msg_t *msg);
+static inline void mln_iothread_msg_wait(mln_iothread_msg_t *msg);
 
 int mln_iothread_init(mln_iothread_t *t, struct mln_iothread_attr *attr)
 {
-    mln_u32_t i;
-    int fds[2];
+    mln_u32_t i, qlen, mode;
+    struct mln_queue_ring_attr rattr;
 
-    if (!attr->nthread || attr->entry == NULL) {
+    if (!attr->nthread || attr->entry == NULL || (attr->spsc && attr->nthread > 1)) {
         return -1;
     }
 
-    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
-        return -1;
-    }
-    t->io_fd = fds[0];
-    t->user_fd = fds[1];
-    mln_iothread_fd_nonblock_set(t->io_fd);
-    mln_iothread_fd_nonblock_set(t->user_fd);
+    qlen = attr->qlen? attr->qlen: M_IOTHREAD_QLEN;
+    mode = attr->spsc? M_QUEUE_RING_SPSC: M_QUEUE_RING_MPMC;
     t->entry = attr->entry;
     t->args = attr->args;
     t->handler = attr->handler;
-    pthread_mutex_init(&(t->io_lock), NULL);
-    pthread_mutex_init(&(t->user_lock), NULL);
-    t->io_head = t->io_tail = NULL;
-    t->user_head = t->user_tail = NULL;
     t->nthread = attr->nthread;
+    t->io_notified = t->user_notified = 0;
+    t->tids = NULL;
+    t->io_ring = t->user_ring = t->free_ring = NULL;
+    t->msgs = NULL;
 
-    if ((t->tids = (pthread_t *)calloc(t->nthread, sizeof(pthread_t))) == NULL) {
-        mln_socket_close(fds[0]);
-        mln_socket_close(fds[1]);
+    if (mln_iothread_fds_init(t) < 0) {
         return -1;
     }
+
+    rattr.qlen = qlen;
+    rattr.free_handler = NULL;
+    rattr.mode = mode;
+    if ((t->io_ring = mln_queue_ring_init(&rattr)) == NULL) goto err;
+    if ((t->user_ring = mln_queue_ring_init(&rattr)) == NULL) goto err;
+    /*
+     * Both ends allocate and free messages, the pool is always MPMC.
+     */
+    rattr.qlen = qlen << 1;
+    rattr.mode = M_QUEUE_RING_MPMC;
+    if ((t->free_ring = mln_queue_ring_init(&rattr)) == NULL) goto err;
+    if ((t->msgs = (mln_iothread_msg_t *)calloc(qlen << 1, sizeof(mln_iothread_msg_t))) == NULL) goto err;
+    for (i = 0; i < (qlen << 1); ++i) {
+        t->msgs[i].pooled = 1;
+        mln_queue_ring_push(t->free_ring, &(t->msgs[i]));
+    }
+
+    if ((t->tids = (pthread_t *)calloc(t->nthread, sizeof(pthread_t))) == NULL) goto err;
     for (i = 0; i < t->nthread; ++i) {
         if (pthread_create(t->tids + i, NULL, t->entry, t->args) != 0) {
             mln_iothread_destroy(t);
@@ -63,11 +75,30 @@ int mln_iothread_init(mln_iothread_t *t, struct mln_iothread_attr *attr)
     }
 
     return 0;
+
+err:
+    mln_iothread_destroy(t);
+    return -1;
+}
+
+static inline int mln_iothread_fds_init(mln_iothread_t *t)
+{
+    if (mln_notifier_init(&(t->io_fd), &(t->io_wfd)) < 0) {
+        return -1;
+    }
+    if (mln_notifier_init(&(t->user_fd), &(t->user_wfd)) < 0) {
+        mln_notifier_destroy(t->io_fd, t->io_wfd);
+        return -1;
+    }
+    return 0;
 }
 
 void mln_iothread_destroy(mln_iothread_t *t)
 {
     if (t == NULL) return;
+
+    mln_iothread_msg_t *msg;
+
     if (t->tids != NULL) {
         mln_u32_t i;
         for (i = 0; i < t->nthread; ++i) {
@@ -75,54 +106,64 @@ void mln_iothread_destroy(mln_iothread_t *t)
             pthread_join(t->tids[i], NULL);
         }
         free(t->tids);
+        t->tids = NULL;
+    }
+    if (t->io_ring != NULL) {
+        while ((msg = (mln_iothread_msg_t *)mln_queue_ring_pop(t->io_ring)) != NULL) {
+            if (!msg->pooled) free(msg);
+        }
+        mln_queue_ring_destroy(t->io_ring);
+        t->io_ring = NULL;
+    }
+    if (t->user_ring != NULL) {
+        while ((msg = (mln_iothread_msg_t *)mln_queue_ring_pop(t->user_ring)) != NULL) {
+            if (!msg->pooled) free(msg);
+        }
+        mln_queue_ring_destroy(t->user_ring);
+        t->user_ring = NULL;
+    }
+    if (t->free_ring != NULL) {
+        mln_queue_ring_destroy(t->free_ring);
+        t->free_ring = NULL;
     }
-    mln_socket_close(t->io_fd);
-    mln_socket_close(t->user_fd);
+    if (t->msgs != NULL) {
+        free(t->msgs);
+        t->msgs = NULL;
+    }
+    mln_notifier_destroy(t->io_fd, t->io_wfd);
+    mln_notifier_destroy(t->user_fd, t->user_wfd);
 }
 
 int mln_iothread_send(mln_iothread_t *t, mln_u32_t type, void *data, mln_iothread_ep_type_t to, mln_u32_t feedback)
 {
     int fd;
-    pthread_mutex_t *plock;
+    mln_u32_t *notified;
     mln_iothread_msg_t *msg;
-    mln_iothread_msg_t **head, **tail;
+    mln_queue_ring_t *ring;
 
     if (to == io_thread) {
-        fd = t->user_fd;
-        plock = &(t->io_lock);
-        head = &(t->io_head);
-        tail = &(t->io_tail);
+        fd = t->io_wfd;
+        ring = t->io_ring;
+        notified = &(t->io_notified);
     } else {
-        fd = t->io_fd;
-        plock = &(t->user_lock);
-        head = &(t->user_head);
-        tail = &(t->user_tail);
+        fd = t->user_wfd;
+        ring = t->user_ring;
+        notified = &(t->user_notified);
     }
 
-    if ((msg = mln_iothread_msg_new(type, data, feedback)) == NULL)
+    if ((msg = mln_iothread_msg_new(t, type, data, feedback)) == NULL)
         return -1;
 
-    if (feedback)
-        pthread_mutex_lock(&(msg->mutex));
-
-    pthread_mutex_lock(plock);
-
-    mln_iothread_msg_chain_add(head, tail, msg);
-
-    if (*head == *tail && *head == msg && send(fd, " ", 1, 0) != 1) {
-        mln_iothread_msg_chain_del(head, tail, msg);
-        if (feedback) pthread_mutex_unlock(&(msg->mutex));
-        pthread_mutex_unlock(plock);
-        mln_iothread_msg_free(msg);
+    if (mln_queue_ring_push(ring, msg) < 0) {
+        mln_iothread_msg_free(t, msg);
         return 1;
     }
 
-    pthread_mutex_unlock(plock);
+    mln_notifier_notify(notified, fd);
 
     if (feedback) {
-        pthread_mutex_lock(&(msg->mutex));
-        pthread_mutex_unlock(&(msg->mutex));
-        mln_iothread_msg_free(msg);
+        mln_iothread_msg_wait(msg);
+        mln_iothread_msg_free(t, msg);
     }
 
     return 0;
@@ -131,84 +172,102 @@ int mln_iothread_send(mln_iothread_t *t, mln_u32_t type, void *data, mln_iothrea
 int mln_iothread_recv(mln_iothread_t *t, mln_iothread_ep_type_t from)
 {
     int fd, n = 0;
-    mln_s8_t c;
-    pthread_mutex_t *plock;
-    mln_iothread_msg_t *msg, *pos;
-    mln_iothread_msg_t **head, **tail;
+    mln_u32_t *notified;
+    mln_iothread_msg_t *msg;
+    mln_queue_ring_t *ring;
 
     if (from == io_thread) {
         fd = t->user_fd;
-        plock = &(t->user_lock);
-        head = &(t->user_head);
-        tail = &(t->user_tail);
+        ring = t->user_ring;
+        notified = &(t->user_notified);
     } else {
         fd = t->io_fd;
-        plock = &(t->io_lock);
-        head = &(t->io_head);
-        tail = &(t->io_tail);
+        ring = t->io_ring;
+        notified = &(t->io_notified);
     }
 
-    pthread_mutex_lock(plock);
+    mln_notifier_drain(notified, fd);
 
-    pos = *head;
-    while ((msg = *head) != NULL) {
-        mln_iothread_msg_chain_del(head, tail, msg);
+    while ((msg = (mln_iothread_msg_t *)mln_queue_ring_pop(ring)) != NULL) {
         if (t->handler != NULL)
             t->handler(t, from, msg);
         if (msg->feedback) {
             if (!msg->hold)
-                pthread_mutex_unlock(&(msg->mutex));
+                mln_iothread_msg_release(msg);
         } else {
-            mln_iothread_msg_free(msg);
+            mln_iothread_msg_free(t, msg);
         }
         ++n;
     }
 
-    if (pos != *head)
-        (void)recv(fd, &c, 1, 0);
-
-    pthread_mutex_unlock(plock);
-
     return n;
 }
 
+/*
+ * The sender frees the message once it is released, so the message
+ * must not be touched after done is set.
+ */
+void mln_iothread_msg_release(mln_iothread_msg_t *m)
+{
+#if defined(__linux__)
+    if (__atomic_exchange_n(&(m->done), 1, __ATOMIC_ACQ_REL) == 2)
+        syscall(SYS_futex, &(m->done), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    __atomic_store_n(&(m->done), 1, __ATOMIC_RELEASE);
+#endif
+}
 
-static inline mln_iothread_msg_t *mln_iothread_msg_new(mln_u32_t type, void *data, int feedback)
+/*
+ * Spin for a while since the receiver usually replies soon,
+ * then sleep on a futex, or yield if futex is not supported.
+ */
+static inline void mln_iothread_msg_wait(mln_iothread_msg_t *msg)
 {
-    mln_iothread_msg_t *msg = (mln_iothread_msg_t *)malloc(sizeof(mln_iothread_msg_t));
-    if (msg == NULL)
-        return NULL;
+    mln_u32_t i, expect;
+
+    for (i = 0; i < M_IOTHREAD_SPIN; ++i) {
+        if (__atomic_load_n(&(msg->done), __ATOMIC_ACQUIRE) == 1) return;
+        mln_cpu_pause();
+    }
+#if defined(__linux__)
+    expect = 0;
+    if (!__atomic_compare_exchange_n(&(msg->done), &expect, 2, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+    while (__atomic_load_n(&(msg->done), __ATOMIC_ACQUIRE) != 1)
+        syscall(SYS_futex, &(msg->done), FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+#else
+    (void)expect;
+    while (__atomic_load_n(&(msg->done), __ATOMIC_ACQUIRE) != 1)
+        sched_yield();
+#endif
+}
+
+static inline mln_iothread_msg_t *mln_iothread_msg_new(mln_iothread_t *t, mln_u32_t type, void *data, int feedback)
+{
+    mln_iothread_msg_t *msg = (mln_iothread_msg_t *)mln_queue_ring_pop(t->free_ring);
+    if (msg == NULL) {
+        /*the pool is exhausted by held messages*/
+        if ((msg = (mln_iothread_msg_t *)malloc(sizeof(mln_iothread_msg_t))) == NULL)
+            return NULL;
+        msg->pooled = 0;
+    }
 
     msg->feedback = feedback;
+    msg->hold = 0;
     msg->type = type;
     msg->data = data;
-    msg->prev = msg->next = NULL;
-
-    if (feedback && pthread_mutex_init(&(msg->mutex), NULL) != 0) {
-        free(msg);
-        return NULL;
-    }
+    msg->done = 0;
     return msg;
 }
 
-static inline void mln_iothread_msg_free(mln_iothread_msg_t *msg)
+static inline void mln_iothread_msg_free(mln_iothread_t *t, mln_iothread_msg_t *msg)
 {
     if (msg == NULL)
         return;
 
-    if (msg->feedback)
-        pthread_mutex_destroy(&(msg->mutex));
-
-    free(msg);
+    if (msg->pooled)
+        mln_queue_ring_push(t->free_ring, msg);
+    else
+        free(msg);
 }
 
-static inline void mln_iothread_fd_nonblock_set(int fd)
-{
-#if defined(WIN32)
-    u_long opt = 1;
-    ioctlsocket(fd, FIONBIO, &opt);
-#else
-    int flg = fcntl(fd, F_GETFL, NULL);
-    fcntl(fd, F_SETFL, flg | O_NONBLOCK);
-#endif
-}
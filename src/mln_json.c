@@ -11,8 +11,6 @@
 static inline mln_json_obj_t *mln_json_obj_new(void);
 static void mln_json_encode_utf8(unsigned int u, mln_u8ptr_t *b, int *count);
 static inline int mln_json_get_char(mln_u8ptr_t *s, int *len, unsigned int *hex);
-static mln_u64_t mln_json_hash_calc(mln_hash_t *h, void *key);
-static int mln_json_hash_cmp(mln_hash_t *h, void *key1, void *key2);
 static void mln_json_obj_free(void *data);
 static int mln_json_rbtree_cmp(const void *data1, const void *data2);
 static inline void mln_json_jumpoff_blank(char **jstr, int *len);
@@ -165,14 +163,17 @@ mln_json_parse_obj(mln_json_t *val, char *jstr, int len, mln_uauto_t index)
     hattr.pool = NULL;
     hattr.pool_alloc = NULL;
     hattr.pool_free = NULL;
-    hattr.hash = mln_json_hash_calc;
-    hattr.cmp = mln_json_hash_cmp;
+    hattr.hash = NULL;
+    hattr.cmp = NULL;
     hattr.free_key = NULL;
     hattr.free_val = mln_json_obj_free;
     hattr.len_base = M_JSON_HASH_LEN;
     hattr.expandable = 1;
     hattr.calc_prime = 0;
     hattr.cache = 0;
+    hattr.progressive = 0;
+    hattr.key_type = M_HASH_KEY_STRING;
+    hattr.nocase = 0;
     val->data.m_j_obj = mln_hash_init(&hattr);
     if (val->data.m_j_obj == NULL) {
         return -1;
@@ -916,25 +917,6 @@ static inline mln_json_obj_t *mln_json_obj_new(void)
     return (mln_json_obj_t *)calloc(1, sizeof(mln_json_obj_t));
 }
 
-static mln_u64_t mln_json_hash_calc(mln_hash_t *h, void *key)
-{
-    mln_string_t *str = (mln_string_t *)key;
-    mln_u8ptr_t s, end = str->data + str->len;
-    mln_u64_t index = 0, tbl_len = h->len;
-
-    for (s = str->data; s < end; ++s) {
-        index += (((mln_u64_t)(*s)) * 65599);
-        index %= tbl_len;
-    }
-
-    return index;
-}
-
-static int mln_json_hash_cmp(mln_hash_t *h, void *key1, void *key2)
-{
-    return !mln_string_strcmp((mln_string_t *)key1, (mln_string_t *)key2);
-}
-
 static void mln_json_obj_free(void *data)
 {
     mln_json_obj_t *obj = (mln_json_obj_t *)data;
@@ -1111,14 +1093,17 @@ int mln_json_update_obj(mln_json_t *j, mln_json_t *key, mln_json_t *val)
         hattr.pool = NULL;
         hattr.pool_alloc = NULL;
         hattr.pool_free = NULL;
-        hattr.hash = mln_json_hash_calc;
-        hattr.cmp = mln_json_hash_cmp;
+        hattr.hash = NULL;
+        hattr.cmp = NULL;
         hattr.free_key = NULL;
         hattr.free_val = mln_json_obj_free;
         hattr.len_base = M_JSON_HASH_LEN;
         hattr.expandable = 1;
         hattr.calc_prime = 0;
         hattr.cache = 0;
+        hattr.progressive = 0;
+        hattr.key_type = M_HASH_KEY_STRING;
+        hattr.nocase = 0;
         j->data.m_j_obj = mln_hash_init(&hattr);
         if (j->data.m_j_obj == NULL) {
             return -1;
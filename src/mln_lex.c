@@ -222,6 +222,9 @@ mln_lex_t *mln_lex_init(struct mln_lex_attr *attr)
     mln_string_t k2 = mln_string("true");
     mln_string_t *scan;
     mln_lex_keyword_t *newkw;
+    sattr.pool = attr->pool;
+    sattr.pool_alloc = (stack_pool_alloc_handler)mln_alloc_m;
+    sattr.pool_free = (stack_pool_free_handler)mln_alloc_free;
     sattr.free_handler = mln_lex_input_free;
     sattr.copy_handler = NULL;
     sattr.cache = 0;
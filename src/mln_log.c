@@ -13,15 +13,35 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <signal.h>
+#if !defined(WIN32)
+#include <sys/uio.h>
+#include <sys/mman.h>
+#endif
 #include "mln_log.h"
 #include "mln_conf.h"
 #include "mln_path.h"
 #include "mln_tools.h"
 
+typedef struct {
+    char       *buf;
+    mln_size_t  size;
+    mln_size_t  len;
+} mln_log_line_t;
+
 /*
  * declarations
  */
 static void
+mln_log_format(mln_log_line_t *l, \
+               mln_log_level_t level, \
+               const char *file, \
+               const char *func, \
+               int line, \
+               char *msg, \
+               va_list arg);
+static void mln_log_output(mln_log_t *log, mln_log_level_t level, char *buf, mln_size_t len);
+static void
 _mln_sys_log_process(mln_log_t *log, \
                      mln_log_level_t level, \
                      const char *file, \
@@ -36,6 +56,12 @@ static inline ssize_t mln_log_write(mln_log_t *log, void *buf, mln_size_t size);
 #if !defined(WIN32)
 static void mln_log_atfork_lock(void);
 static void mln_log_atfork_unlock(void);
+static void mln_log_atfork_child(void);
+static int mln_log_set_async(mln_log_t *log);
+static int mln_log_buf_append(char *data, mln_size_t n);
+static int mln_log_buf_flush(void);
+static void *mln_log_flusher(void *arg);
+static void mln_log_buf_exit(void *arg);
 #endif
 static int mln_log_get_log(mln_log_t *log, int is_init);
 static mln_logger_t _logger = NULL;
@@ -46,7 +72,34 @@ static mln_logger_t _logger = NULL;
 char log_err_level[] = "Log level permission deny.";
 char log_err_fmt[] = "Log message format error.";
 char log_path_cmd[] = "log_path";
-mln_log_t g_log = {{0},{0},{0},STDERR_FILENO,0,none,(mln_spin_t)0};
+mln_log_t g_log = {{0},{0},{0},STDERR_FILENO,0,0,none,(mln_spin_t)0};
+#if !defined(WIN32)
+/*
+ * Buffers of all threads, the lock is also held by whom is flushing them,
+ * so there is only one consumer of each buffer.
+ */
+mln_log_buf_t *log_buf_head = NULL;
+mln_log_buf_t *log_buf_tail = NULL;
+pthread_mutex_t log_buf_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t log_buf_cond = PTHREAD_COND_INITIALIZER;
+pthread_key_t log_buf_key;
+mln_u32_t log_flusher_running = 0;
+__thread mln_log_buf_t *log_buf_self = NULL;
+/*
+ * Rings of worker processes, log_shm_cur is the ring of this worker process,
+ * and log_shm_drain is only set in the master process.
+ * They are also protected by log_buf_lock.
+ */
+int log_shm_on = 0;
+mln_log_shm_t *log_shm = NULL;
+mln_u32_t log_shm_n = 0;
+mln_log_shm_t *log_shm_cur = NULL;
+int log_shm_drain = 0;
+
+MLN_CHAIN_FUNC_DECLARE(mln_log_buf, \
+                       mln_log_buf_t, \
+                       static inline void,);
+#endif
 
 /*
  * file lock
@@ -100,7 +153,7 @@ int mln_log_init(int in_daemon)
     }
     if ((ret = pthread_atfork(mln_log_atfork_lock, \
                               mln_log_atfork_unlock, \
-                              mln_log_atfork_unlock)) != 0)
+                              mln_log_atfork_child)) != 0)
     {
         fprintf(stderr, "%s(): pthread_atfork failed. %s\n", __FUNCTION__, strerror(ret));
         mln_spin_destroy(&(log->thread_lock));
@@ -118,6 +171,12 @@ int mln_log_init(int in_daemon)
         mln_log_destroy();
         return -1;
     }
+#if !defined(WIN32)
+    if (mln_log_set_async(log) < 0) {
+        mln_log_destroy();
+        return -1;
+    }
+#endif
     return 0;
 }
 
@@ -217,18 +276,59 @@ mln_log_get_log(mln_log_t *log, int is_init)
 #if !defined(WIN32)
 static void mln_log_atfork_lock(void)
 {
+    pthread_mutex_lock(&log_buf_lock);
     mln_spin_lock(&(g_log.thread_lock));
 }
 
 static void mln_log_atfork_unlock(void)
 {
     mln_spin_unlock(&(g_log.thread_lock));
+    pthread_mutex_unlock(&log_buf_lock);
+}
+
+/*
+ * Lines buffered before fork belong to the parent. Only the forking thread
+ * exists in the child, and the flusher is started again at the next logging.
+ */
+static void mln_log_atfork_child(void)
+{
+    mln_log_buf_t *b, *fr;
+
+    for (b = log_buf_head; b != NULL; ) {
+        fr = b;
+        b = b->next;
+        if (fr == log_buf_self) {
+            fr->tail = fr->head;
+            continue;
+        }
+        mln_log_buf_chain_del(&log_buf_head, &log_buf_tail, fr);
+        free(fr);
+    }
+    log_flusher_running = 0;
+    /*the flusher of the parent may be waiting on it, which never wakes up here*/
+    pthread_cond_init(&log_buf_cond, NULL);
+    /*a new worker process is given its ring by mln_log_shm_worker_set()*/
+    log_shm_cur = NULL;
+    log_shm_drain = 0;
+    mln_log_atfork_unlock();
 }
 #endif
 
 void mln_log_destroy(void)
 {
     mln_log_t *log = &g_log;
+#if !defined(WIN32)
+    pthread_mutex_lock(&log_buf_lock);
+    if (log->async) (void)mln_log_buf_flush();
+    log_shm_cur = NULL;
+    log_shm_drain = 0;
+    if (log_shm != NULL) {
+        munmap(log_shm, log_shm_n * sizeof(mln_log_shm_t));
+        log_shm = NULL;
+        log_shm_n = 0;
+    }
+    pthread_mutex_unlock(&log_buf_lock);
+#endif
     if (log->fd > 0 && \
         log->fd != STDIN_FILENO && \
         log->fd != STDOUT_FILENO && \
@@ -315,17 +415,23 @@ void _mln_sys_log(mln_log_level_t level, \
                   char *msg, \
                   ...)
 {
-    mln_spin_lock(&(g_log.thread_lock));
-    mln_file_lock(g_log.fd);
     va_list arg;
+
+    /*filter before any lock, level may be changed by reloading*/
+    if (_logger == NULL && level < __atomic_load_n(&(g_log.level), __ATOMIC_RELAXED))
+        return;
+
     va_start(arg, msg);
-    if (_logger != NULL)
+    if (_logger != NULL) {
+        mln_spin_lock(&(g_log.thread_lock));
+        mln_file_lock(g_log.fd);
         _logger(&g_log, level, file, func, line, msg, arg);
-    else
+        mln_file_unlock(g_log.fd);
+        mln_spin_unlock(&(g_log.thread_lock));
+    } else {
         _mln_sys_log_process(&g_log, level, file, func, line, msg, arg);
+    }
     va_end(arg);
-    mln_file_unlock(g_log.fd);
-    mln_spin_unlock(&(g_log.thread_lock));
 }
 
 static inline ssize_t mln_log_write(mln_log_t *log, void *buf, mln_size_t size)
@@ -340,6 +446,10 @@ static inline ssize_t mln_log_write(mln_log_t *log, void *buf, mln_size_t size)
 
 ssize_t mln_log_writen(void *buf, mln_size_t size)
 {
+#if !defined(WIN32)
+    if (g_log.async && mln_log_buf_append((char *)buf, size) == 0)
+        return size;
+#endif
     mln_spin_lock(&(g_log.thread_lock));
     mln_file_lock(g_log.fd);
     ssize_t n = mln_log_write(&g_log, buf, size);
@@ -348,6 +458,375 @@ ssize_t mln_log_writen(void *buf, mln_size_t size)
     return n;
 }
 
+/*
+ * A whole line is written by one write() to a file opened with O_APPEND,
+ * it would not be interleaved with lines of other processes, so the file
+ * lock is not needed.
+ * In async mode, error lines are flushed at once, since they are usually
+ * followed by abort().
+ */
+static void mln_log_output(mln_log_t *log, mln_log_level_t level, char *buf, mln_size_t len)
+{
+#if !defined(WIN32)
+    if (log->async && mln_log_buf_append(buf, len) == 0) {
+        if (level == error) mln_log_flush();
+        return;
+    }
+#endif
+    mln_spin_lock(&(log->thread_lock));
+    mln_log_write(log, buf, len);
+    mln_spin_unlock(&(log->thread_lock));
+}
+
+#if !defined(WIN32)
+static int mln_log_conf_bool(mln_conf_domain_t *cd, char *name)
+{
+    mln_conf_cmd_t *cc;
+    mln_conf_item_t *ci;
+
+    if ((cc = cd->search(cd, name)) == NULL) return 0;
+    if (mln_conf_get_narg(cc) != 1 || (ci = cc->search(cc, 1))->type != CONF_BOOL) {
+        fprintf(stderr, "Command '%s' need a boolean parameter.\n", name);
+        return -1;
+    }
+    return ci->val.b? 1: 0;
+}
+
+/*
+ * 'log_shm on;' implies 'log_async on;'.
+ */
+static int mln_log_set_async(mln_log_t *log)
+{
+    int rc, async;
+    mln_conf_t *cf = mln_get_conf();
+    mln_conf_domain_t *cd;
+
+    if (cf == NULL || (cd = cf->search(cf, "main")) == NULL) return 0;
+    if ((async = mln_log_conf_bool(cd, "log_async")) < 0) return -1;
+    if ((log_shm_on = mln_log_conf_bool(cd, "log_shm")) < 0) return -1;
+    if (!async && !log_shm_on) return 0;
+
+    if ((rc = pthread_key_create(&log_buf_key, mln_log_buf_exit)) != 0) {
+        fprintf(stderr, "%s(): pthread_key_create failed. %s\n", __FUNCTION__, strerror(rc));
+        return -1;
+    }
+    if (atexit(mln_log_flush) != 0) {
+        fprintf(stderr, "%s(): atexit failed.\n", __FUNCTION__);
+        pthread_key_delete(log_buf_key);
+        return -1;
+    }
+    log->async = 1;
+    return 0;
+}
+
+static void mln_log_buf_exit(void *arg)
+{
+    __atomic_store_n(&(((mln_log_buf_t *)arg)->dead), 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * The flusher blocks all signals, so that they are handled by other threads.
+ * @ log_buf_lock must be locked by caller.
+ */
+static inline void mln_log_flusher_start(void)
+{
+    pthread_t tid;
+    sigset_t set, old;
+
+    if (log_flusher_running) return;
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &old);
+    if (pthread_create(&tid, NULL, mln_log_flusher, NULL) == 0) {
+        pthread_detach(tid);
+        __atomic_store_n(&log_flusher_running, 1, __ATOMIC_RELAXED);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static inline mln_log_buf_t *mln_log_buf_self(void)
+{
+    mln_log_buf_t *b = log_buf_self;
+
+    if (b != NULL && __atomic_load_n(&log_flusher_running, __ATOMIC_RELAXED))
+        return b;
+
+    pthread_mutex_lock(&log_buf_lock);
+    if (b == NULL) {
+        if (posix_memalign((void **)&b, M_CACHELINE_SIZE, sizeof(mln_log_buf_t)) != 0) {
+            pthread_mutex_unlock(&log_buf_lock);
+            return NULL;
+        }
+        b->head = b->tail = 0;
+        b->dead = 0;
+        b->prev = b->next = NULL;
+        pthread_setspecific(log_buf_key, b);
+        mln_log_buf_chain_add(&log_buf_head, &log_buf_tail, b);
+        log_buf_self = b;
+    }
+    /*if failed, buffers are flushed by loggers when they are full*/
+    mln_log_flusher_start();
+    pthread_mutex_unlock(&log_buf_lock);
+    return b;
+}
+
+/*
+ * return value: 0 - buffered, -1 - the caller should write it directly
+ */
+static int mln_log_buf_append(char *data, mln_size_t n)
+{
+    mln_u64_t head, off;
+    mln_log_buf_t *b;
+
+    if (n > M_LOG_BUF_LEN / 2 || (b = mln_log_buf_self()) == NULL) {
+        /*keep the order of lines of this thread*/
+        mln_log_flush();
+        return -1;
+    }
+
+    head = b->head;
+    if (head + n - __atomic_load_n(&(b->tail), __ATOMIC_ACQUIRE) > M_LOG_BUF_LEN) {
+        mln_log_flush();
+        /*the ring of this worker process is full as well*/
+        if (head + n - __atomic_load_n(&(b->tail), __ATOMIC_ACQUIRE) > M_LOG_BUF_LEN)
+            return -1;
+    }
+
+    off = head & (M_LOG_BUF_LEN - 1);
+    if (off + n <= M_LOG_BUF_LEN) {
+        memcpy(b->data + off, data, n);
+    } else {
+        memcpy(b->data + off, data, M_LOG_BUF_LEN - off);
+        memcpy(b->data, data + (M_LOG_BUF_LEN - off), n - (M_LOG_BUF_LEN - off));
+    }
+    __atomic_store_n(&(b->head), head + n, __ATOMIC_RELEASE);
+
+    if (head + n - __atomic_load_n(&(b->tail), __ATOMIC_RELAXED) > M_LOG_BUF_LEN / 2)
+        pthread_cond_signal(&log_buf_cond);
+    return 0;
+}
+
+static inline void mln_log_writev(int fd, struct iovec *iov, int cnt)
+{
+    ssize_t n;
+
+    while (cnt > 0) {
+        if ((n = writev(fd, iov, cnt)) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        for (; cnt > 0 && (size_t)n >= iov->iov_len; --cnt, ++iov)
+            n -= iov->iov_len;
+        if (cnt > 0) {
+            iov->iov_base = (char *)(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+static inline int mln_log_iov_set(struct iovec *iov, char *data, mln_u64_t size, mln_u64_t head, mln_u64_t tail)
+{
+    mln_u64_t off = tail & (size - 1);
+
+    iov[0].iov_base = data + off;
+    if (off + (head - tail) <= size) {
+        iov[0].iov_len = head - tail;
+        return 1;
+    }
+    iov[0].iov_len = size - off;
+    iov[1].iov_base = data;
+    iov[1].iov_len = head - tail - (size - off);
+    return 2;
+}
+
+static inline void mln_log_iov_write(struct iovec *iov, int cnt)
+{
+    struct iovec copy[M_LOG_IOV_MAX];
+
+    mln_spin_lock(&(g_log.thread_lock));
+    if (!g_log.in_daemon) memcpy(copy, iov, cnt * sizeof(struct iovec));
+    mln_log_writev(g_log.fd, iov, cnt);
+    if (!g_log.in_daemon) mln_log_writev(STDERR_FILENO, copy, cnt);
+    mln_spin_unlock(&(g_log.thread_lock));
+}
+
+/*
+ * Lines of a thread buffer are put as a whole or not at all,
+ * so that the master process never writes a partial line.
+ */
+static int mln_log_shm_put(mln_log_shm_t *r, struct iovec *iov, int cnt)
+{
+    int i;
+    mln_u64_t head = r->head, off, total = 0, n;
+
+    for (i = 0; i < cnt; ++i) total += iov[i].iov_len;
+    if (head + total - __atomic_load_n(&(r->tail), __ATOMIC_ACQUIRE) > M_LOG_SHM_LEN)
+        return -1;
+
+    for (i = 0; i < cnt; head += iov[i++].iov_len) {
+        off = head & (M_LOG_SHM_LEN - 1);
+        n = M_LOG_SHM_LEN - off < iov[i].iov_len? M_LOG_SHM_LEN - off: iov[i].iov_len;
+        memcpy(r->data + off, iov[i].iov_base, n);
+        memcpy(r->data, (char *)(iov[i].iov_base) + n, iov[i].iov_len - n);
+    }
+    __atomic_store_n(&(r->head), head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * return value: the number of rings which are more than half full
+ */
+static int mln_log_shm_drain_all(void)
+{
+    int i, cnt, busy = 0;
+    mln_u32_t k = 0;
+    mln_u64_t head, tail;
+    mln_log_shm_t *r, *rings[M_LOG_IOV_MAX / 2];
+    mln_u64_t heads[M_LOG_IOV_MAX / 2];
+    struct iovec iov[M_LOG_IOV_MAX];
+
+    while (k < log_shm_n) {
+        for (i = cnt = 0; k < log_shm_n && i < M_LOG_IOV_MAX / 2; ++k) {
+            r = log_shm + k;
+            head = __atomic_load_n(&(r->head), __ATOMIC_ACQUIRE);
+            tail = r->tail;
+            if (head == tail) continue;
+            if (head - tail > M_LOG_SHM_LEN / 2) ++busy;
+            cnt += mln_log_iov_set(&iov[cnt], r->data, M_LOG_SHM_LEN, head, tail);
+            rings[i] = r;
+            heads[i++] = head;
+        }
+        if (!cnt) break;
+
+        mln_log_iov_write(iov, cnt);
+        while (i-- > 0)
+            __atomic_store_n(&(rings[i]->tail), heads[i], __ATOMIC_RELEASE);
+    }
+    return busy;
+}
+
+/*
+ * @ log_buf_lock must be locked by caller.
+ * return value: the number of rings which are more than half full in the master process
+ */
+static int mln_log_buf_flush(void)
+{
+    int i, j, cnt;
+    mln_u64_t head, tail;
+    mln_log_buf_t *b, *fr, *bufs[M_LOG_IOV_MAX / 2];
+    mln_u64_t heads[M_LOG_IOV_MAX / 2];
+    int firsts[M_LOG_IOV_MAX / 2 + 1];
+    struct iovec iov[M_LOG_IOV_MAX];
+
+    b = log_buf_head;
+    while (b != NULL) {
+        for (i = cnt = 0; b != NULL && i < M_LOG_IOV_MAX / 2; b = b->next) {
+            head = __atomic_load_n(&(b->head), __ATOMIC_ACQUIRE);
+            tail = b->tail;
+            if (head == tail) continue;
+            firsts[i] = cnt;
+            cnt += mln_log_iov_set(&iov[cnt], b->data, M_LOG_BUF_LEN, head, tail);
+            bufs[i] = b;
+            heads[i++] = head;
+        }
+        if (!cnt) break;
+        firsts[i] = cnt;
+
+        if (log_shm_cur != NULL) {
+            /*lines left in buffers are tried again next time*/
+            for (j = 0; j < i; ++j) {
+                if (mln_log_shm_put(log_shm_cur, &iov[firsts[j]], firsts[j+1] - firsts[j]) == 0)
+                    __atomic_store_n(&(bufs[j]->tail), heads[j], __ATOMIC_RELEASE);
+            }
+            continue;
+        }
+
+        mln_log_iov_write(iov, cnt);
+        while (i-- > 0)
+            __atomic_store_n(&(bufs[i]->tail), heads[i], __ATOMIC_RELEASE);
+    }
+
+    for (b = log_buf_head; b != NULL; ) {
+        fr = b;
+        b = b->next;
+        if (__atomic_load_n(&(fr->dead), __ATOMIC_ACQUIRE) && fr->tail == __atomic_load_n(&(fr->head), __ATOMIC_ACQUIRE)) {
+            mln_log_buf_chain_del(&log_buf_head, &log_buf_tail, fr);
+            free(fr);
+        }
+    }
+
+    return log_shm_drain? mln_log_shm_drain_all(): 0;
+}
+
+static void *mln_log_flusher(void *arg)
+{
+    long ms;
+    struct timespec ts;
+
+    pthread_mutex_lock(&log_buf_lock);
+    while (1) {
+        /*come back soon if worker processes are logging fast*/
+        ms = mln_log_buf_flush() > 0? 1: M_LOG_FLUSH_MS;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        if ((ts.tv_nsec += ms * 1000000) >= 1000000000) {
+            ts.tv_nsec -= 1000000000;
+            ++(ts.tv_sec);
+        }
+        pthread_cond_timedwait(&log_buf_cond, &log_buf_lock, &ts);
+    }
+    pthread_mutex_unlock(&log_buf_lock);
+    return NULL;
+}
+#endif
+
+void mln_log_flush(void)
+{
+#if !defined(WIN32)
+    if (!g_log.async) return;
+    pthread_mutex_lock(&log_buf_lock);
+    (void)mln_log_buf_flush();
+    pthread_mutex_unlock(&log_buf_lock);
+#endif
+}
+
+int mln_log_shm_init(mln_u32_t n_workers)
+{
+#if !defined(WIN32)
+    mln_log_shm_t *p;
+
+    if (!log_shm_on || log_shm != NULL || !n_workers) return 0;
+
+    p = (mln_log_shm_t *)mmap(NULL, n_workers * sizeof(mln_log_shm_t), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if (p == MAP_FAILED) {
+        mln_log(error, "mmap() failed. %s\n", strerror(errno));
+        return -1;
+    }
+    pthread_mutex_lock(&log_buf_lock);
+    log_shm = p;
+    log_shm_n = n_workers;
+    log_shm_drain = 1;
+    mln_log_flusher_start();
+    pthread_mutex_unlock(&log_buf_lock);
+#endif
+    return 0;
+}
+
+void mln_log_shm_worker_set(mln_sauto_t worker_id)
+{
+#if !defined(WIN32)
+    if (log_shm == NULL || worker_id < 0) return;
+    pthread_mutex_lock(&log_buf_lock);
+    /*
+     * Processes forked by mln_fork_restart() get ids beyond log_shm_n,
+     * a ring has only one producer, so they write the file directly.
+     */
+    log_shm_cur = (mln_u64_t)worker_id < log_shm_n? log_shm + worker_id: NULL;
+    pthread_mutex_unlock(&log_buf_lock);
+#endif
+}
+
+/*
+ * Format the whole line in memory, then output it at once.
+ */
 static void
 _mln_sys_log_process(mln_log_t *log, \
                      mln_log_level_t level, \
@@ -357,7 +836,52 @@ _mln_sys_log_process(mln_log_t *log, \
                      char *msg, \
                      va_list arg)
 {
+    va_list cp;
+    mln_log_line_t l;
+    char buf[M_LOG_LINE_LEN];
+
     if (level < log->level) return;
+
+    l.buf = buf;
+    l.size = sizeof(buf);
+    l.len = 0;
+    va_copy(cp, arg);
+    mln_log_format(&l, level, file, func, line, msg, cp);
+    va_end(cp);
+    if (l.len > sizeof(buf)) {
+        /*truncated if no memory*/
+        if ((l.buf = (char *)malloc(l.len)) == NULL) {
+            l.buf = buf;
+            l.len = sizeof(buf);
+        } else {
+            l.size = l.len;
+            l.len = 0;
+            va_copy(cp, arg);
+            mln_log_format(&l, level, file, func, line, msg, cp);
+            va_end(cp);
+        }
+    }
+    mln_log_output(log, level, l.buf, l.len);
+    if (l.buf != buf) free(l.buf);
+}
+
+static inline void mln_log_line_append(mln_log_line_t *l, const void *data, mln_size_t n)
+{
+    /*len goes on even if the buffer is full, so that the caller knows the size needed*/
+    if (l->len < l->size)
+        memcpy(l->buf + l->len, data, n > l->size - l->len? l->size - l->len: n);
+    l->len += n;
+}
+
+static void
+mln_log_format(mln_log_line_t *l, \
+               mln_log_level_t level, \
+               const char *file, \
+               const char *func, \
+               int line, \
+               char *msg, \
+               va_list arg)
+{
     int n;
     struct timeval tv;
     struct utctime uc;
@@ -369,41 +893,39 @@ _mln_sys_log_process(mln_log_t *log, \
                          "%02ld/%02ld/%ld %02ld:%02ld:%02ld GMT ", \
                          uc.month, uc.day, uc.year, \
                          uc.hour, uc.minute, uc.second);
-        mln_log_write(log, (void *)line_str, n);
+        mln_log_line_append(l, line_str, n);
     }
     switch (level) {
         case none:
             break;
         case report:
-            mln_log_write(log, (void *)"REPORT: ", 8);
+            mln_log_line_append(l, "REPORT: ", 8);
             break;
         case debug:
-            mln_log_write(log, (void *)"DEBUG: ", 7);
+            mln_log_line_append(l, "DEBUG: ", 7);
             break;
         case warn:
-            mln_log_write(log, (void *)"WARN: ", 6);
+            mln_log_line_append(l, "WARN: ", 6);
             break;
         case error:
-            mln_log_write(log, (void *)"ERROR: ", 7);
+            mln_log_line_append(l, "ERROR: ", 7);
             break;
         default: 
             return ;
     }
     if (level >= debug) {
-        memset(line_str, 0, sizeof(line_str));
-        mln_log_write(log, (void *)file, strlen(file));
-        mln_log_write(log, (void *)":", 1);
-        mln_log_write(log, (void *)func, strlen(func));
-        mln_log_write(log, (void *)":", 1);
+        mln_log_line_append(l, file, strlen(file));
+        mln_log_line_append(l, ":", 1);
+        mln_log_line_append(l, func, strlen(func));
+        mln_log_line_append(l, ":", 1);
         n = snprintf(line_str, sizeof(line_str)-1, "%d", line);
-        mln_log_write(log, (void *)line_str, n);
-        mln_log_write(log, (void *)": ", 2);
+        mln_log_line_append(l, line_str, n);
+        mln_log_line_append(l, ": ", 2);
     }
     
     if (level > none) {
-        memset(line_str, 0, sizeof(line_str));
         n = snprintf(line_str, sizeof(line_str)-1, "PID:%d ", getpid());
-        mln_log_write(log, (void *)line_str, n);
+        mln_log_line_append(l, line_str, n);
     }
 
     int cnt = 0;
@@ -414,7 +936,7 @@ _mln_sys_log_process(mln_log_t *log, \
             ++msg;
             continue;
         }
-        mln_log_write(log, (void *)p, cnt);
+        mln_log_line_append(l, p, cnt);
         cnt = 0;
         ++msg;
         p = msg + 1;
@@ -422,18 +944,17 @@ _mln_sys_log_process(mln_log_t *log, \
             case 's':
             {
                 char *s = va_arg(arg, char *);
-                mln_log_write(log, (void *)s, strlen(s));
+                mln_log_line_append(l, s, strlen(s));
                 break;
             }
             case 'S':
             {
                 mln_string_t *s = va_arg(arg, mln_string_t *);
-                mln_log_write(log, s->data, s->len);
+                mln_log_line_append(l, s->data, s->len);
                 break;
             }
             case 'l':
             {
-                memset(line_str, 0, sizeof(line_str));
                 mln_sauto_t num = va_arg(arg, long);
 #if defined(WIN32)
   #if defined(i386) || defined(__arm__)
@@ -444,66 +965,59 @@ _mln_sys_log_process(mln_log_t *log, \
 #else
                 int n = snprintf(line_str, sizeof(line_str)-1, "%ld", num);
 #endif
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'd':
             {
-                memset(line_str, 0, sizeof(line_str));
                 int num = va_arg(arg, int);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%d", num);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'c':
             {
-                int ch = va_arg(arg, int);
-                mln_log_write(log, (void *)&ch, 1);
+                char ch = (char)va_arg(arg, int);
+                mln_log_line_append(l, &ch, 1);
                 break;
             }
             case 'f':
             {
                 double f = va_arg(arg, double);
-                memset(line_str, 0, sizeof(line_str));
                 int n = snprintf(line_str, sizeof(line_str)-1, "%f", f);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'x':
             {
-                memset(line_str, 0, sizeof(line_str));
                 int num = va_arg(arg, int);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%x", num);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'X':
             {
-                memset(line_str, 0, sizeof(line_str));
                 long num = va_arg(arg, long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%lx", num);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'u':
             {
-                memset(line_str, 0, sizeof(line_str));
                 unsigned int num = va_arg(arg, unsigned int);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%u", num);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'U':
             {
-                memset(line_str, 0, sizeof(line_str));
                 unsigned long num = va_arg(arg, unsigned long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%lu", num);
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'i':
             {
-                memset(line_str, 0, sizeof(line_str));
 #if defined(WIN32)
                 long long num = va_arg(arg, long long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%I64d", num);
@@ -514,12 +1028,11 @@ _mln_sys_log_process(mln_log_t *log, \
                 long num = va_arg(arg, long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%ld", num);
 #endif
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             case 'I':
             {
-                memset(line_str, 0, sizeof(line_str));
 #if defined(WIN32)
                 unsigned long long num = va_arg(arg, unsigned long long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%I64u", num);
@@ -530,18 +1043,18 @@ _mln_sys_log_process(mln_log_t *log, \
                 unsigned long num = va_arg(arg, unsigned long);
                 int n = snprintf(line_str, sizeof(line_str)-1, "%lu", num);
 #endif
-                mln_log_write(log, (void *)line_str, n);
+                mln_log_line_append(l, line_str, n);
                 break;
             }
             default:
-                mln_log_write(log, (void *)log_err_fmt, sizeof(log_err_fmt)-1);
-                mln_log_write(log, (void *)"\n", 1);
+                mln_log_line_append(l, log_err_fmt, sizeof(log_err_fmt)-1);
+                mln_log_line_append(l, "\n", 1);
                 return;
         }
         ++msg;
     }
     if (cnt)
-        mln_log_write(log, (void *)p, cnt);
+        mln_log_line_append(l, p, cnt);
 }
 
 /*
@@ -567,3 +1080,11 @@ char *mln_log_get_pid_path(void)
     return g_log.pid_path;
 }
 
+#if !defined(WIN32)
+MLN_CHAIN_FUNC_DEFINE(mln_log_buf, \
+                      mln_log_buf_t, \
+                      static inline void, \
+                      prev, \
+                      next);
+#endif
+
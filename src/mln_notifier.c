@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include "mln_notifier.h"
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#elif defined(WIN32)
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#if !defined(__linux__)
+static inline void mln_notifier_nonblock_set(int fd)
+{
+#if defined(WIN32)
+    u_long opt = 1;
+    ioctlsocket(fd, FIONBIO, &opt);
+#else
+    int flg = fcntl(fd, F_GETFL, NULL);
+    fcntl(fd, F_SETFL, flg | O_NONBLOCK);
+#endif
+}
+#endif
+
+int mln_notifier_init(int *rfd, int *wfd)
+{
+#if defined(__linux__)
+    if ((*rfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        return -1;
+    }
+    *wfd = *rfd;
+#else
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        return -1;
+    }
+    mln_notifier_nonblock_set(fds[0]);
+    mln_notifier_nonblock_set(fds[1]);
+    *rfd = fds[0];
+    *wfd = fds[1];
+#endif
+    return 0;
+}
+
+void mln_notifier_destroy(int rfd, int wfd)
+{
+    mln_socket_close(rfd);
+    if (wfd != rfd) mln_socket_close(wfd);
+}
+
+/*
+ * Pairs with mln_notifier_drain(), either the consumer sees the message
+ * after it clears the flag, or we see the flag cleared and notify it again.
+ */
+int mln_notifier_arm(mln_u32_t *notified)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return !__atomic_load_n(notified, __ATOMIC_RELAXED) && !__atomic_exchange_n(notified, 1, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * The message is already visible, the consumer will get it at next notification.
+ */
+void mln_notifier_disarm(mln_u32_t *notified)
+{
+    __atomic_store_n(notified, 0, __ATOMIC_RELEASE);
+}
+
+int mln_notifier_wake(int wfd)
+{
+#if defined(__linux__)
+    mln_u64_t v = 1;
+    return write(wfd, &v, sizeof(v)) < 0? -1: 0;
+#else
+    return send(wfd, " ", 1, 0) != 1? -1: 0;
+#endif
+}
+
+void mln_notifier_notify(mln_u32_t *notified, int wfd)
+{
+    if (mln_notifier_arm(notified) && mln_notifier_wake(wfd) < 0)
+        mln_notifier_disarm(notified);
+}
+
+/*
+ * Consume the notification first, then clear the flag, so that any
+ * message sent after the ring is drained will notify us again.
+ */
+void mln_notifier_drain(mln_u32_t *notified, int rfd)
+{
+    if (rfd >= 0) {
+#if defined(__linux__)
+        mln_u64_t v;
+        (void)read(rfd, &v, sizeof(v));
+#else
+        char buf[64];
+        while (recv(rfd, buf, sizeof(buf), 0) == sizeof(buf))
+            ;
+#endif
+    }
+    if (notified == NULL) return;
+    __atomic_store_n(notified, 0, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,376 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mln_ohash.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline mln_u64_t mln_ohash_calc(mln_ohash_t *h, void *key) __NONNULL2(1,2);
+static inline mln_u32_t mln_ohash_group_match(mln_u8ptr_t g, mln_u8_t c);
+static inline mln_u32_t mln_ohash_group_match_free(mln_u8ptr_t g);
+static inline int mln_ohash_bit_first(mln_u32_t mask);
+static inline int mln_ohash_leading_zeros(mln_u32_t mask);
+static inline void mln_ohash_ctrl_set(mln_ohash_t *h, mln_u64_t i, mln_u8_t c);
+static inline mln_s64_t mln_ohash_find(mln_ohash_t *h, void *key, mln_u64_t hv) __NONNULL2(1,2);
+static inline mln_u64_t mln_ohash_find_free(mln_ohash_t *h, mln_u64_t hv) __NONNULL1(1);
+static inline int mln_ohash_tbl_new(mln_ohash_t *h, mln_u64_t len) __NONNULL1(1);
+static inline int mln_ohash_rehash(mln_ohash_t *h, mln_u64_t len) __NONNULL1(1);
+static inline void mln_ohash_slot_free(mln_ohash_t *h, mln_ohash_slot_t *s, mln_hash_flag_t flg) __NONNULL2(1,2);
+static inline int mln_ohash_insert_hv(mln_ohash_t *h, void *key, void *val, mln_u64_t hv) __NONNULL2(1,2);
+
+#define mln_ohash_capacity(len) ((len) - ((len) >> 3))
+#define mln_ohash_h1(hv)        ((hv) >> 7)
+#define mln_ohash_h2(hv)        ((mln_u8_t)((hv) & 0x7f))
+
+mln_ohash_t *
+mln_ohash_init(struct mln_ohash_attr *attr)
+{
+    mln_ohash_t *h;
+    mln_u64_t len;
+
+    if (attr->hash == NULL || attr->cmp == NULL) return NULL;
+
+    if (attr->pool != NULL) {
+        h = (mln_ohash_t *)attr->pool_alloc(attr->pool, sizeof(mln_ohash_t));
+    } else {
+        h = (mln_ohash_t *)malloc(sizeof(mln_ohash_t));
+    }
+    if (h == NULL) return NULL;
+
+    h->pool = attr->pool;
+    h->pool_alloc = attr->pool_alloc;
+    h->pool_free = attr->pool_free;
+    h->hash = attr->hash;
+    h->cmp = attr->cmp;
+    h->free_key = attr->free_key;
+    h->free_val = attr->free_val;
+    h->expandable = attr->expandable;
+
+    for (len = M_OHASH_MIN_LEN; mln_ohash_capacity(len) < attr->len_base; len <<= 1)
+        ;
+    if (mln_ohash_tbl_new(h, len) < 0) {
+        if (h->pool != NULL) h->pool_free(h);
+        else free(h);
+        return NULL;
+    }
+    return h;
+}
+
+void
+mln_ohash_destroy(mln_ohash_t *h, mln_hash_flag_t flg)
+{
+    mln_ohash_reset(h, flg);
+    if (h->pool != NULL) {
+        h->pool_free(h->slots);
+        h->pool_free(h);
+    } else {
+        free(h->slots);
+        free(h);
+    }
+}
+
+/*
+ * Slots and control bytes share one allocation.
+ * The first M_OHASH_GROUP_SIZE control bytes are mirrored
+ * after the last one, so a group can be loaded at any position
+ * without wrapping around.
+ */
+static inline int mln_ohash_tbl_new(mln_ohash_t *h, mln_u64_t len)
+{
+    mln_u8ptr_t ptr;
+    mln_size_t size = len * sizeof(mln_ohash_slot_t) + len + M_OHASH_GROUP_SIZE;
+
+    if (h->pool != NULL) {
+        ptr = (mln_u8ptr_t)h->pool_alloc(h->pool, size);
+    } else {
+        ptr = (mln_u8ptr_t)malloc(size);
+    }
+    if (ptr == NULL) return -1;
+
+    h->slots = (mln_ohash_slot_t *)ptr;
+    h->ctrl = ptr + len * sizeof(mln_ohash_slot_t);
+    memset(h->ctrl, M_OHASH_CTRL_EMPTY, len + M_OHASH_GROUP_SIZE);
+    h->len = len;
+    h->nr_nodes = 0;
+    h->nr_deleted = 0;
+    h->growth_left = mln_ohash_capacity(len);
+    return 0;
+}
+
+static inline int mln_ohash_rehash(mln_ohash_t *h, mln_u64_t len)
+{
+    mln_u64_t i, old_len = h->len, nr_nodes = h->nr_nodes, idx, hv;
+    mln_u8ptr_t old_ctrl = h->ctrl;
+    mln_ohash_slot_t *old_slots = h->slots;
+
+    if (mln_ohash_tbl_new(h, len) < 0) return -1;
+    for (i = 0; i < old_len; ++i) {
+        if (old_ctrl[i] & M_OHASH_CTRL_EMPTY) continue;
+        hv = mln_ohash_calc(h, old_slots[i].key);
+        idx = mln_ohash_find_free(h, hv);
+        mln_ohash_ctrl_set(h, idx, mln_ohash_h2(hv));
+        h->slots[idx] = old_slots[i];
+    }
+    h->nr_nodes = nr_nodes;
+    h->growth_left -= nr_nodes;
+    if (h->pool != NULL) h->pool_free(old_slots);
+    else free(old_slots);
+    return 0;
+}
+
+/*
+ * Bucket index style hash functions leave the high bits empty,
+ * so the value is mixed before it is split into h1 and h2.
+ */
+static inline mln_u64_t mln_ohash_calc(mln_ohash_t *h, void *key)
+{
+    mln_u64_t hv = h->hash(h, key);
+    hv ^= hv >> 33;
+    hv *= (mln_u64_t)0xff51afd7ed558ccdULL;
+    hv ^= hv >> 33;
+    return hv;
+}
+
+static inline mln_u32_t mln_ohash_group_match(mln_u8ptr_t g, mln_u8_t c)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+    return (mln_u32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+#else
+    mln_u32_t i, mask = 0;
+    for (i = 0; i < M_OHASH_GROUP_SIZE; ++i) {
+        if (g[i] == c) mask |= ((mln_u32_t)1 << i);
+    }
+    return mask;
+#endif
+}
+
+/*
+ * Empty and deleted slots are the only ones with the high bit set.
+ */
+static inline mln_u32_t mln_ohash_group_match_free(mln_u8ptr_t g)
+{
+#if defined(__SSE2__)
+    return (mln_u32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+    mln_u32_t i, mask = 0;
+    for (i = 0; i < M_OHASH_GROUP_SIZE; ++i) {
+        if (g[i] & M_OHASH_CTRL_EMPTY) mask |= ((mln_u32_t)1 << i);
+    }
+    return mask;
+#endif
+}
+
+static inline int mln_ohash_bit_first(mln_u32_t mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i;
+    for (i = 0; !(mask & 1); ++i) mask >>= 1;
+    return i;
+#endif
+}
+
+static inline int mln_ohash_leading_zeros(mln_u32_t mask)
+{
+    int n = 0;
+    mln_u32_t bit = (mln_u32_t)1 << (M_OHASH_GROUP_SIZE - 1);
+    for (; bit && !(mask & bit); bit >>= 1) ++n;
+    return n;
+}
+
+static inline void mln_ohash_ctrl_set(mln_ohash_t *h, mln_u64_t i, mln_u8_t c)
+{
+    h->ctrl[i] = c;
+    if (i < M_OHASH_GROUP_SIZE) h->ctrl[h->len + i] = c;
+}
+
+static inline mln_s64_t mln_ohash_find(mln_ohash_t *h, void *key, mln_u64_t hv)
+{
+    mln_u64_t mask = h->len - 1, pos = mln_ohash_h1(hv) & mask, step = 0, idx;
+    mln_u8_t h2 = mln_ohash_h2(hv);
+    mln_u32_t m;
+    mln_u8ptr_t g;
+
+    while (1) {
+        g = h->ctrl + pos;
+        for (m = mln_ohash_group_match(g, h2); m; m &= m - 1) {
+            idx = (pos + mln_ohash_bit_first(m)) & mask;
+            if (h->cmp(h, key, h->slots[idx].key)) return (mln_s64_t)idx;
+        }
+        if (mln_ohash_group_match(g, M_OHASH_CTRL_EMPTY)) return -1;
+        step += M_OHASH_GROUP_SIZE;
+        pos = (pos + step) & mask;
+    }
+    return -1;
+}
+
+static inline mln_u64_t mln_ohash_find_free(mln_ohash_t *h, mln_u64_t hv)
+{
+    mln_u64_t mask = h->len - 1, pos = mln_ohash_h1(hv) & mask, step = 0;
+    mln_u32_t m;
+
+    while (!(m = mln_ohash_group_match_free(h->ctrl + pos))) {
+        step += M_OHASH_GROUP_SIZE;
+        pos = (pos + step) & mask;
+    }
+    return (pos + mln_ohash_bit_first(m)) & mask;
+}
+
+void *mln_ohash_search(mln_ohash_t *h, void *key)
+{
+    mln_s64_t idx = mln_ohash_find(h, key, mln_ohash_calc(h, key));
+    if (idx < 0) return NULL;
+    return h->slots[idx].val;
+}
+
+int mln_ohash_key_exist(mln_ohash_t *h, void *key)
+{
+    return mln_ohash_find(h, key, mln_ohash_calc(h, key)) >= 0;
+}
+
+void *mln_ohash_change_value(mln_ohash_t *h, void *key, void *new_value)
+{
+    void *retval;
+    mln_s64_t idx = mln_ohash_find(h, key, mln_ohash_calc(h, key));
+    if (idx < 0) return NULL;
+    retval = h->slots[idx].val;
+    h->slots[idx].val = new_value;
+    return retval;
+}
+
+static inline int mln_ohash_insert_hv(mln_ohash_t *h, void *key, void *val, mln_u64_t hv)
+{
+    mln_u64_t idx = mln_ohash_find_free(h, hv);
+
+    if (!h->growth_left && h->ctrl[idx] == M_OHASH_CTRL_EMPTY) {
+        /*
+         * Purge tombstones if at least half of the table is free,
+         * otherwise double it.
+         */
+        if (h->nr_nodes < (mln_ohash_capacity(h->len) >> 1)) {
+            if (mln_ohash_rehash(h, h->len) < 0) return -1;
+        } else {
+            if (!h->expandable || mln_ohash_rehash(h, h->len << 1) < 0) return -1;
+        }
+        idx = mln_ohash_find_free(h, hv);
+    }
+
+    if (h->ctrl[idx] == M_OHASH_CTRL_DEL) --(h->nr_deleted);
+    else --(h->growth_left);
+    mln_ohash_ctrl_set(h, idx, mln_ohash_h2(hv));
+    h->slots[idx].key = key;
+    h->slots[idx].val = val;
+    ++(h->nr_nodes);
+    return 0;
+}
+
+int mln_ohash_insert(mln_ohash_t *h, void *key, void *val)
+{
+    return mln_ohash_insert_hv(h, key, val, mln_ohash_calc(h, key));
+}
+
+int mln_ohash_replace(mln_ohash_t *h, void *key, void *val)
+{
+    void **k = (void **)key;
+    void **v = (void **)val;
+    mln_u64_t hv = mln_ohash_calc(h, *k);
+    mln_s64_t idx = mln_ohash_find(h, *k, hv);
+
+    if (idx >= 0) {
+        void *save_key = h->slots[idx].key;
+        void *save_val = h->slots[idx].val;
+        h->slots[idx].key = *k;
+        h->slots[idx].val = *v;
+        *k = save_key;
+        *v = save_val;
+        return 0;
+    }
+    if (mln_ohash_insert_hv(h, *k, *v, hv) < 0) return -1;
+    *k = *v = NULL;
+    return 0;
+}
+
+void mln_ohash_remove(mln_ohash_t *h, void *key, mln_hash_flag_t flg)
+{
+    mln_u32_t before, after;
+    mln_s64_t idx = mln_ohash_find(h, key, mln_ohash_calc(h, key));
+
+    if (idx < 0) return;
+
+    mln_ohash_slot_free(h, &(h->slots[idx]), flg);
+    --(h->nr_nodes);
+
+    /*
+     * If no group-wide window around the slot was ever full,
+     * no probe sequence has passed it, so it can become empty again.
+     */
+    before = mln_ohash_group_match(h->ctrl + ((idx - M_OHASH_GROUP_SIZE) & (h->len - 1)), M_OHASH_CTRL_EMPTY);
+    after = mln_ohash_group_match(h->ctrl + idx, M_OHASH_CTRL_EMPTY);
+    if (before && after && \
+        mln_ohash_bit_first(after) + mln_ohash_leading_zeros(before) < M_OHASH_GROUP_SIZE)
+    {
+        mln_ohash_ctrl_set(h, idx, M_OHASH_CTRL_EMPTY);
+        ++(h->growth_left);
+    } else {
+        mln_ohash_ctrl_set(h, idx, M_OHASH_CTRL_DEL);
+        ++(h->nr_deleted);
+    }
+}
+
+static inline void
+mln_ohash_slot_free(mln_ohash_t *h, mln_ohash_slot_t *s, mln_hash_flag_t flg)
+{
+    switch (flg) {
+        case M_HASH_F_VAL:
+            if (h->free_val != NULL)
+                h->free_val(s->val);
+            break;
+        case M_HASH_F_KEY:
+            if (h->free_key != NULL)
+                h->free_key(s->key);
+            break;
+        case M_HASH_F_KV:
+            if (h->free_val != NULL)
+                h->free_val(s->val);
+            if (h->free_key != NULL)
+                h->free_key(s->key);
+            break;
+        default: break;
+    }
+}
+
+int mln_ohash_scan_all(mln_ohash_t *h, hash_scan_handler handler, void *udata)
+{
+    mln_u64_t i;
+
+    for (i = 0; i < h->len; ++i) {
+        if (h->ctrl[i] & M_OHASH_CTRL_EMPTY) continue;
+        if (handler != NULL && handler(h->slots[i].key, h->slots[i].val, udata) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void mln_ohash_reset(mln_ohash_t *h, mln_hash_flag_t flg)
+{
+    mln_u64_t i;
+
+    if (flg != M_HASH_F_NONE) {
+        for (i = 0; i < h->len; ++i) {
+            if (h->ctrl[i] & M_OHASH_CTRL_EMPTY) continue;
+            mln_ohash_slot_free(h, &(h->slots[i]), flg);
+        }
+    }
+    memset(h->ctrl, M_OHASH_CTRL_EMPTY, h->len + M_OHASH_GROUP_SIZE);
+    h->nr_nodes = 0;
+    h->nr_deleted = 0;
+    h->growth_left = mln_ohash_capacity(h->len);
+}
+
@@ -145,22 +145,6 @@ int mln_pg_token_rbtree_cmp(const void *data1, const void *data2)
     return ((mln_pg_token_t *)data1)->type - ((mln_pg_token_t *)data2)->type;
 }
 
-mln_u64_t mln_pg_map_hash_calc(mln_hash_t *h, void *key)
-{
-    mln_u64_t sum = 0;
-    char *p = (char *)key;
-    for (; *p != 0; ++p) {
-        sum += (*p * 65599);
-        sum %= h->len;
-    }
-    return sum;
-}
-
-int mln_pg_map_hash_cmp(mln_hash_t *h, void *key1, void *key2)
-{
-    return !strcmp((char *)key1, (char *)key2);
-}
-
 void mln_pg_map_hash_free(void *data)
 {
     if (data == NULL) return;
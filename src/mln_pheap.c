@@ -0,0 +1,195 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+
+#include <stdlib.h>
+#include "mln_pheap.h"
+
+static inline mln_pheap_node_t *
+mln_pheap_link(mln_pheap_t *ph, mln_pheap_node_t *a, mln_pheap_node_t *b) __NONNULL3(1,2,3);
+static inline void
+mln_pheap_cut(mln_pheap_node_t *pn) __NONNULL1(1);
+static inline mln_pheap_node_t *
+mln_pheap_merge_pairs(mln_pheap_t *ph, mln_pheap_node_t *first) __NONNULL2(1,2);
+
+
+mln_pheap_t *mln_pheap_init(struct mln_pheap_attr *attr)
+{
+    mln_pheap_t *ph;
+    if (attr->pool != NULL)
+        ph = (mln_pheap_t *)attr->pool_alloc(attr->pool, sizeof(mln_pheap_t));
+    else
+        ph = (mln_pheap_t *)malloc(sizeof(mln_pheap_t));
+    if (ph == NULL) return NULL;
+
+    ph->pool = attr->pool;
+    ph->pool_alloc = attr->pool_alloc;
+    ph->pool_free = attr->pool_free;
+    ph->cmp = attr->cmp;
+    ph->copy = attr->copy;
+    ph->key_free = attr->key_free;
+    ph->root = NULL;
+    ph->num = 0;
+    return ph;
+}
+
+void mln_pheap_destroy(mln_pheap_t *ph)
+{
+    if (ph == NULL) return;
+
+    /*
+     * Children are pushed in front of their parents through next,
+     * so the whole tree is freed without recursion.
+     */
+    mln_pheap_node_t *pn = ph->root, *c;
+    while (pn != NULL) {
+        if ((c = pn->child) != NULL) {
+            pn->child = c->next;
+            c->next = pn;
+            pn = c;
+        } else {
+            c = pn->next;
+            mln_pheap_node_destroy(ph, pn);
+            pn = c;
+        }
+    }
+    if (ph->pool != NULL) ph->pool_free(ph);
+    else free(ph);
+}
+
+/*
+ * Both a and b are roots, the one with the smaller key becomes
+ * the root and the other one becomes its first child.
+ */
+static inline mln_pheap_node_t *
+mln_pheap_link(mln_pheap_t *ph, mln_pheap_node_t *a, mln_pheap_node_t *b)
+{
+    mln_pheap_node_t *tmp;
+    if (!ph->cmp(b->key, a->key)) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->prev = a;
+    b->next = a->child;
+    if (a->child != NULL) a->child->prev = b;
+    a->child = b;
+    a->prev = a->next = NULL;
+    return a;
+}
+
+static inline void mln_pheap_cut(mln_pheap_node_t *pn)
+{
+    if (pn->prev->child == pn) pn->prev->child = pn->next;
+    else pn->prev->next = pn->next;
+    if (pn->next != NULL) pn->next->prev = pn->prev;
+    pn->prev = pn->next = NULL;
+}
+
+/*
+ * Two-pass pairing: link the siblings in pairs from left to right,
+ * then link the results from right to left.
+ */
+static inline mln_pheap_node_t *
+mln_pheap_merge_pairs(mln_pheap_t *ph, mln_pheap_node_t *first)
+{
+    mln_pheap_node_t *a = first, *b, *n, *list = NULL;
+
+    while (a != NULL) {
+        if ((b = a->next) == NULL) {
+            a->next = list;
+            list = a;
+            break;
+        }
+        n = b->next;
+        a = mln_pheap_link(ph, a, b);
+        a->next = list;
+        list = a;
+        a = n;
+    }
+
+    a = list;
+    list = list->next;
+    while (list != NULL) {
+        n = list->next;
+        a = mln_pheap_link(ph, a, list);
+        list = n;
+    }
+    a->prev = a->next = NULL;
+    return a;
+}
+
+void mln_pheap_insert(mln_pheap_t *ph, mln_pheap_node_t *pn)
+{
+    pn->prev = pn->next = NULL;
+    ph->root = ph->root == NULL? pn: mln_pheap_link(ph, ph->root, pn);
+    ++(ph->num);
+}
+
+mln_pheap_node_t *mln_pheap_extract_min(mln_pheap_t *ph)
+{
+    mln_pheap_node_t *min = ph->root;
+    if (min == NULL) return NULL;
+
+    ph->root = min->child == NULL? NULL: mln_pheap_merge_pairs(ph, min->child);
+    min->child = NULL;
+    --(ph->num);
+    return min;
+}
+
+int mln_pheap_decrease_key(mln_pheap_t *ph, mln_pheap_node_t *pn, void *key)
+{
+    if (!ph->cmp(pn->key, key)) return -1;
+    ph->copy(pn->key, key);
+    if (pn != ph->root) {
+        mln_pheap_cut(pn);
+        ph->root = mln_pheap_link(ph, ph->root, pn);
+    }
+    return 0;
+}
+
+void mln_pheap_delete(mln_pheap_t *ph, mln_pheap_node_t *pn)
+{
+    mln_pheap_node_t *sub;
+
+    if (pn == ph->root) {
+        mln_pheap_extract_min(ph);
+        return;
+    }
+    mln_pheap_cut(pn);
+    if (pn->child != NULL) {
+        sub = mln_pheap_merge_pairs(ph, pn->child);
+        pn->child = NULL;
+        ph->root = mln_pheap_link(ph, ph->root, sub);
+    }
+    --(ph->num);
+}
+
+/*mln_pheap_node_t*/
+mln_pheap_node_t *mln_pheap_node_init(mln_pheap_t *ph, void *key)
+{
+    mln_pheap_node_t *pn;
+
+    if (ph->pool != NULL)
+        pn = (mln_pheap_node_t *)ph->pool_alloc(ph->pool, sizeof(mln_pheap_node_t));
+    else
+        pn = (mln_pheap_node_t *)malloc(sizeof(mln_pheap_node_t));
+    if (pn == NULL) return NULL;
+
+    pn->key = key;
+    pn->prev = NULL;
+    pn->next = NULL;
+    pn->child = NULL;
+    return pn;
+}
+
+void mln_pheap_node_destroy(mln_pheap_t *ph, mln_pheap_node_t *pn)
+{
+    if (pn == NULL) return;
+    if (ph->key_free != NULL && pn->key != NULL)
+        ph->key_free(pn->key);
+    if (ph->pool != NULL) ph->pool_free(pn);
+    else free(pn);
+}
+
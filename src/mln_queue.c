@@ -4,6 +4,9 @@
  */
 #include "mln_queue.h"
 
+static inline mln_uauto_t
+mln_queue_ring_claim(mln_queue_ring_t *r, mln_uauto_t *cursor, mln_uauto_t off, mln_uauto_t n, mln_uauto_t *start) __NONNULL3(1,2,5);
+
 mln_queue_t *mln_queue_init(struct mln_queue_attr *attr)
 {
     mln_queue_t *q = (mln_queue_t *)malloc(sizeof(mln_queue_t));
@@ -106,3 +109,134 @@ void mln_queue_free_index(mln_queue_t *q, mln_uauto_t index)
         q->free_handler(save);
 }
 
+
+/*
+ * mln_queue_ring_t
+ */
+mln_queue_ring_t *mln_queue_ring_init(struct mln_queue_ring_attr *attr)
+{
+    mln_queue_ring_t *r;
+    mln_uauto_t i, n;
+
+    if (!attr->qlen) return NULL;
+    for (n = 1; n < attr->qlen; n <<= 1)
+        ;
+
+    if (posix_memalign((void **)&r, M_CACHELINE_SIZE, sizeof(mln_queue_ring_t)) != 0)
+        return NULL;
+    if (posix_memalign((void **)&(r->cells), M_CACHELINE_SIZE, n * sizeof(mln_queue_cell_t)) != 0) {
+        free(r);
+        return NULL;
+    }
+    for (i = 0; i < n; ++i) {
+        r->cells[i].seq = i;
+        r->cells[i].data = NULL;
+    }
+    r->mask = n - 1;
+    r->free_handler = attr->free_handler;
+    r->mode = attr->mode;
+    r->tail = 0;
+    r->head = 0;
+    return r;
+}
+
+void mln_queue_ring_destroy(mln_queue_ring_t *r)
+{
+    void *data;
+
+    if (r == NULL) return;
+    if (r->free_handler != NULL) {
+        while ((data = mln_queue_ring_pop(r)) != NULL)
+            r->free_handler(data);
+    }
+    free(r->cells);
+    free(r);
+}
+
+/*
+ * Claim at most n continuous cells from cursor (tail or head).
+ * A cell at position pos is ready for producers if its seq is pos,
+ * and ready for consumers if its seq is pos + 1, off tells which one.
+ */
+static inline mln_uauto_t
+mln_queue_ring_claim(mln_queue_ring_t *r, mln_uauto_t *cursor, mln_uauto_t off, mln_uauto_t n, mln_uauto_t *start)
+{
+    mln_uauto_t i, seq, pos = __atomic_load_n(cursor, __ATOMIC_RELAXED);
+    mln_queue_cell_t *cells = r->cells;
+
+    while (1) {
+        seq = __atomic_load_n(&(cells[pos & r->mask].seq), __ATOMIC_ACQUIRE);
+        if (seq != pos + off) {
+            /*full or empty*/
+            if ((mln_sauto_t)(seq - (pos + off)) < 0) return 0;
+            /*taken by others*/
+            pos = __atomic_load_n(cursor, __ATOMIC_RELAXED);
+            continue;
+        }
+        for (i = 1; i < n; ++i) {
+            if (__atomic_load_n(&(cells[(pos + i) & r->mask].seq), __ATOMIC_ACQUIRE) != pos + i + off)
+                break;
+        }
+        if (r->mode == M_QUEUE_RING_SPSC) {
+            __atomic_store_n(cursor, pos + i, __ATOMIC_RELEASE);
+            break;
+        }
+        if (__atomic_compare_exchange_n(cursor, &pos, pos + i, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            break;
+    }
+    *start = pos;
+    return i;
+}
+
+int mln_queue_ring_push(mln_queue_ring_t *r, void *data)
+{
+    mln_uauto_t pos;
+    mln_queue_cell_t *cell;
+
+    if (!mln_queue_ring_claim(r, &(r->tail), 0, 1, &pos)) return -1;
+    cell = &(r->cells[pos & r->mask]);
+    cell->data = data;
+    __atomic_store_n(&(cell->seq), pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void *mln_queue_ring_pop(mln_queue_ring_t *r)
+{
+    void *data;
+    mln_uauto_t pos;
+    mln_queue_cell_t *cell;
+
+    if (!mln_queue_ring_claim(r, &(r->head), 1, 1, &pos)) return NULL;
+    cell = &(r->cells[pos & r->mask]);
+    data = cell->data;
+    __atomic_store_n(&(cell->seq), pos + r->mask + 1, __ATOMIC_RELEASE);
+    return data;
+}
+
+mln_uauto_t mln_queue_ring_push_batch(mln_queue_ring_t *r, void **data, mln_uauto_t n)
+{
+    mln_uauto_t i, pos, cnt;
+    mln_queue_cell_t *cell;
+
+    if (!n || !(cnt = mln_queue_ring_claim(r, &(r->tail), 0, n, &pos))) return 0;
+    for (i = 0; i < cnt; ++i) {
+        cell = &(r->cells[(pos + i) & r->mask]);
+        cell->data = data[i];
+        __atomic_store_n(&(cell->seq), pos + i + 1, __ATOMIC_RELEASE);
+    }
+    return cnt;
+}
+
+mln_uauto_t mln_queue_ring_pop_batch(mln_queue_ring_t *r, void **data, mln_uauto_t n)
+{
+    mln_uauto_t i, pos, cnt;
+    mln_queue_cell_t *cell;
+
+    if (!n || !(cnt = mln_queue_ring_claim(r, &(r->head), 1, n, &pos))) return 0;
+    for (i = 0; i < cnt; ++i) {
+        cell = &(r->cells[(pos + i) & r->mask]);
+        data[i] = cell->data;
+        __atomic_store_n(&(cell->seq), pos + i + r->mask + 1, __ATOMIC_RELEASE);
+    }
+    return cnt;
+}
@@ -30,6 +30,16 @@ static inline void
 rbtree_transplant(mln_rbtree_t *t, mln_rbtree_node_t *u, mln_rbtree_node_t *v) __NONNULL3(1,2,3);
 static inline void
 rbtree_delete_fixup(mln_rbtree_t *t, mln_rbtree_node_t *n) __NONNULL2(1,2);
+static inline void
+rbtree_ileft_rotate(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n) __NONNULL2(1,2);
+static inline void
+rbtree_iright_rotate(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n) __NONNULL2(1,2);
+static inline void
+rbtree_itransplant(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *u, mln_rbtree_inode_t *v) __NONNULL2(1,2);
+static inline void
+rbtree_iinsert_fixup(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n) __NONNULL2(1,2);
+static inline void
+rbtree_ierase_fixup(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n, mln_rbtree_inode_t *parent) __NONNULL1(1);
 
 /*rbtree_init*/
 mln_rbtree_t *
@@ -49,6 +59,7 @@ mln_rbtree_init(struct mln_rbtree_attr *attr)
     t->nil.parent = &(t->nil);
     t->nil.left = &(t->nil);
     t->nil.right = &(t->nil);
+    t->nil.size = 0;
     t->nil.color = M_RB_BLACK;
     t->root = &(t->nil);
     t->min = &(t->nil);
@@ -145,6 +156,7 @@ mln_rbtree_node_new(mln_rbtree_t *t, void *data)
     n->parent = &(t->nil);
     n->left = &(t->nil);
     n->right = &(t->nil);
+    n->size = 1;
     return n;
 }
 
@@ -177,6 +189,8 @@ left_rotate(mln_rbtree_t *t, mln_rbtree_node_t *n)
     else n->parent->right = tmp;
     tmp->left = n;
     n->parent = tmp;
+    tmp->size = n->size;
+    n->size = n->left->size + n->right->size + 1;
 }
 
 /*Right rotate*/
@@ -193,6 +207,8 @@ right_rotate(mln_rbtree_t *t, mln_rbtree_node_t *n)
     else n->parent->left = tmp;
     tmp->right = n;
     n->parent = tmp;
+    tmp->size = n->size;
+    n->size = n->left->size + n->right->size + 1;
 }
 
 /*Insert*/
@@ -203,6 +219,7 @@ mln_rbtree_insert(mln_rbtree_t *t, mln_rbtree_node_t *n)
     mln_rbtree_node_t *x = t->root;
     while (x != &(t->nil)) {
         y = x;
+        ++(x->size);
         if (t->cmp(n->data, x->data) < 0) x = x->left;
         else x = x->right;
     }
@@ -212,6 +229,7 @@ mln_rbtree_insert(mln_rbtree_t *t, mln_rbtree_node_t *n)
     else y->right = n;
     n->left = &(t->nil);
     n->right = &(t->nil);
+    n->size = 1;
     n->color = M_RB_RED;
     rbtree_insert_fixup(t, n);
     if (t->min == &(t->nil)) t->min = n;
@@ -287,6 +305,12 @@ mln_rbtree_delete(mln_rbtree_t *t, mln_rbtree_node_t *n)
         t->min = mln_rbtree_successor(t, n);
     enum rbtree_color y_original_color;
     mln_rbtree_node_t *x, *y;
+    /*
+     * The node actually unlinked is n, or n's successor if n has two children,
+     * all its ancestors lose one node.
+     */
+    y = (n->left == &(t->nil) || n->right == &(t->nil))? n: rbtree_minimum(t, n->right);
+    for (x = y->parent; x != &(t->nil); x = x->parent) --(x->size);
     y = n;
     y_original_color = y->color;
     if (n->left == &(t->nil)) {
@@ -309,6 +333,7 @@ mln_rbtree_delete(mln_rbtree_t *t, mln_rbtree_node_t *n)
         y->left = n->left;
         y->left->parent = y;
         y->color = n->color;
+        y->size = n->size;
     }
     if (y_original_color == M_RB_BLACK) rbtree_delete_fixup(t, x);
     n->parent = n->left = n->right = &(t->nil);
@@ -412,3 +437,306 @@ int mln_rbtree_scan_all(mln_rbtree_t *t, rbtree_act act, void *udata)
     return 0;
 }
 
+/*
+ * intrusive rbtree
+ */
+#define rbtree_iblack(n) ((n) == NULL || (n)->color == M_RB_BLACK)
+
+static inline void
+rbtree_ileft_rotate(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n)
+{
+    mln_rbtree_inode_t *tmp = n->right;
+    n->right = tmp->left;
+    if (tmp->left != NULL) tmp->left->parent = n;
+    tmp->parent = n->parent;
+    if (n->parent == NULL) r->root = tmp;
+    else if (n == n->parent->left) n->parent->left = tmp;
+    else n->parent->right = tmp;
+    tmp->left = n;
+    n->parent = tmp;
+}
+
+static inline void
+rbtree_iright_rotate(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n)
+{
+    mln_rbtree_inode_t *tmp = n->left;
+    n->left = tmp->right;
+    if (tmp->right != NULL) tmp->right->parent = n;
+    tmp->parent = n->parent;
+    if (n->parent == NULL) r->root = tmp;
+    else if (n == n->parent->right) n->parent->right = tmp;
+    else n->parent->left = tmp;
+    tmp->right = n;
+    n->parent = tmp;
+}
+
+void mln_rbtree_inode_link(mln_rbtree_iroot_t *r, \
+                           mln_rbtree_inode_t *parent, \
+                           mln_rbtree_inode_t **link, \
+                           mln_rbtree_inode_t *n)
+{
+    n->parent = parent;
+    n->left = n->right = NULL;
+    n->color = M_RB_RED;
+    *link = n;
+    if (r->min == NULL || (parent == r->min && link == &(parent->left)))
+        r->min = n;
+    ++(r->nr_node);
+    rbtree_iinsert_fixup(r, n);
+}
+
+static inline void
+rbtree_iinsert_fixup(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n)
+{
+    mln_rbtree_inode_t *tmp;
+    while (n->parent != NULL && n->parent->color == M_RB_RED) {
+        if (n->parent == n->parent->parent->left) {
+            tmp = n->parent->parent->right;
+            if (!rbtree_iblack(tmp)) {
+                n->parent->color = M_RB_BLACK;
+                tmp->color = M_RB_BLACK;
+                n->parent->parent->color = M_RB_RED;
+                n = n->parent->parent;
+                continue;
+            } else if (n == n->parent->right) {
+                n = n->parent;
+                rbtree_ileft_rotate(r, n);
+            }
+            n->parent->color = M_RB_BLACK;
+            n->parent->parent->color = M_RB_RED;
+            rbtree_iright_rotate(r, n->parent->parent);
+        } else {
+            tmp = n->parent->parent->left;
+            if (!rbtree_iblack(tmp)) {
+                n->parent->color = M_RB_BLACK;
+                tmp->color = M_RB_BLACK;
+                n->parent->parent->color = M_RB_RED;
+                n = n->parent->parent;
+                continue;
+            } else if (n == n->parent->left) {
+                n = n->parent;
+                rbtree_iright_rotate(r, n);
+            }
+            n->parent->color = M_RB_BLACK;
+            n->parent->parent->color = M_RB_RED;
+            rbtree_ileft_rotate(r, n->parent->parent);
+        }
+    }
+    r->root->color = M_RB_BLACK;
+}
+
+static inline void
+rbtree_itransplant(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *u, mln_rbtree_inode_t *v)
+{
+    if (u->parent == NULL) r->root = v;
+    else if (u == u->parent->left) u->parent->left = v;
+    else u->parent->right = v;
+    if (v != NULL) v->parent = u->parent;
+}
+
+void mln_rbtree_inode_erase(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n)
+{
+    enum rbtree_color color;
+    mln_rbtree_inode_t *x, *parent, *y;
+
+    if (n == r->min) r->min = mln_rbtree_inode_next(n);
+    if (n->left == NULL || n->right == NULL) {
+        x = n->left == NULL? n->right: n->left;
+        parent = n->parent;
+        color = n->color;
+        rbtree_itransplant(r, n, x);
+    } else {
+        for (y = n->right; y->left != NULL; y = y->left)
+            ;
+        color = y->color;
+        x = y->right;
+        if (y->parent == n) {
+            parent = y;
+        } else {
+            parent = y->parent;
+            rbtree_itransplant(r, y, x);
+            y->right = n->right;
+            y->right->parent = y;
+        }
+        rbtree_itransplant(r, n, y);
+        y->left = n->left;
+        y->left->parent = y;
+        y->color = n->color;
+    }
+    if (color == M_RB_BLACK) rbtree_ierase_fixup(r, x, parent);
+    n->parent = n->left = n->right = NULL;
+    --(r->nr_node);
+}
+
+/*
+ * n may be NULL, so its parent is passed in.
+ */
+static inline void
+rbtree_ierase_fixup(mln_rbtree_iroot_t *r, mln_rbtree_inode_t *n, mln_rbtree_inode_t *parent)
+{
+    mln_rbtree_inode_t *tmp;
+    while (n != r->root && rbtree_iblack(n)) {
+        if (n == parent->left) {
+            tmp = parent->right;
+            if (tmp->color == M_RB_RED) {
+                tmp->color = M_RB_BLACK;
+                parent->color = M_RB_RED;
+                rbtree_ileft_rotate(r, parent);
+                tmp = parent->right;
+            }
+            if (rbtree_iblack(tmp->left) && rbtree_iblack(tmp->right)) {
+                tmp->color = M_RB_RED;
+                n = parent;
+                parent = n->parent;
+                continue;
+            } else if (rbtree_iblack(tmp->right)) {
+                tmp->left->color = M_RB_BLACK;
+                tmp->color = M_RB_RED;
+                rbtree_iright_rotate(r, tmp);
+                tmp = parent->right;
+            }
+            tmp->color = parent->color;
+            parent->color = M_RB_BLACK;
+            tmp->right->color = M_RB_BLACK;
+            rbtree_ileft_rotate(r, parent);
+            n = r->root;
+        } else {
+            tmp = parent->left;
+            if (tmp->color == M_RB_RED) {
+                tmp->color = M_RB_BLACK;
+                parent->color = M_RB_RED;
+                rbtree_iright_rotate(r, parent);
+                tmp = parent->left;
+            }
+            if (rbtree_iblack(tmp->right) && rbtree_iblack(tmp->left)) {
+                tmp->color = M_RB_RED;
+                n = parent;
+                parent = n->parent;
+                continue;
+            } else if (rbtree_iblack(tmp->left)) {
+                tmp->right->color = M_RB_BLACK;
+                tmp->color = M_RB_RED;
+                rbtree_ileft_rotate(r, tmp);
+                tmp = parent->left;
+            }
+            tmp->color = parent->color;
+            parent->color = M_RB_BLACK;
+            tmp->left->color = M_RB_BLACK;
+            rbtree_iright_rotate(r, parent);
+            n = r->root;
+        }
+    }
+    if (n != NULL) n->color = M_RB_BLACK;
+}
+
+mln_rbtree_inode_t *mln_rbtree_inode_next(mln_rbtree_inode_t *n)
+{
+    mln_rbtree_inode_t *tmp;
+    if (n->right != NULL) {
+        for (n = n->right; n->left != NULL; n = n->left)
+            ;
+        return n;
+    }
+    for (tmp = n->parent; tmp != NULL && n == tmp->right; tmp = tmp->parent)
+        n = tmp;
+    return tmp;
+}
+
+mln_rbtree_inode_t *mln_rbtree_inode_prev(mln_rbtree_inode_t *n)
+{
+    mln_rbtree_inode_t *tmp;
+    if (n->left != NULL) {
+        for (n = n->left; n->right != NULL; n = n->right)
+            ;
+        return n;
+    }
+    for (tmp = n->parent; tmp != NULL && n == tmp->left; tmp = tmp->parent)
+        n = tmp;
+    return tmp;
+}
+
+mln_rbtree_inode_t *mln_rbtree_inode_last(mln_rbtree_iroot_t *r)
+{
+    mln_rbtree_inode_t *n = r->root;
+    if (n == NULL) return NULL;
+    while (n->right != NULL) n = n->right;
+    return n;
+}
+
+/*select*/
+mln_rbtree_node_t *
+mln_rbtree_select(mln_rbtree_t *t, mln_uauto_t k)
+{
+    mln_rbtree_node_t *n = t->root;
+    while (n != &(t->nil)) {
+        if (k < n->left->size) {
+            n = n->left;
+        } else if (k == n->left->size) {
+            break;
+        } else {
+            k -= n->left->size + 1;
+            n = n->right;
+        }
+    }
+    return n;
+}
+
+/*rank*/
+mln_uauto_t
+mln_rbtree_rank(mln_rbtree_t *t, const void *key)
+{
+    mln_uauto_t rank = 0;
+    mln_rbtree_node_t *n = t->root;
+    while (n != &(t->nil)) {
+        if (t->cmp(n->data, key) < 0) {
+            rank += n->left->size + 1;
+            n = n->right;
+        } else {
+            n = n->left;
+        }
+    }
+    return rank;
+}
+
+/*lower bound*/
+mln_rbtree_node_t *
+mln_rbtree_lower_bound(mln_rbtree_t *t, const void *key)
+{
+    mln_rbtree_node_t *n = t->root, *ret = &(t->nil);
+    while (n != &(t->nil)) {
+        if (t->cmp(n->data, key) < 0) {
+            n = n->right;
+        } else {
+            ret = n;
+            n = n->left;
+        }
+    }
+    return ret;
+}
+
+/*upper bound*/
+mln_rbtree_node_t *
+mln_rbtree_upper_bound(mln_rbtree_t *t, const void *key)
+{
+    mln_rbtree_node_t *n = t->root, *ret = &(t->nil);
+    while (n != &(t->nil)) {
+        if (t->cmp(n->data, key) <= 0) {
+            n = n->right;
+        } else {
+            ret = n;
+            n = n->left;
+        }
+    }
+    return ret;
+}
+
+/*range scan*/
+int mln_rbtree_range_scan(mln_rbtree_t *t, const void *low, const void *high, rbtree_act act, void *udata)
+{
+    mln_rbtree_node_t *n = low == NULL? t->min: mln_rbtree_lower_bound(t, low);
+    for (; n != &(t->nil); n = mln_rbtree_successor(t, n)) {
+        if (high != NULL && t->cmp(n->data, high) >= 0) break;
+        if (act(n, n->data, udata) < 0) return -1;
+    }
+    return 0;
+}
@@ -4,45 +4,55 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "mln_stack.h"
 
 /*
  * declarations
  */
-MLN_CHAIN_FUNC_DECLARE(mln_stack, \
-                       mln_stack_node_t, \
-                       static inline void,);
-static mln_stack_node_t *
-mln_stack_node_init(void *data);
-static void
-mln_stack_node_destroy(mln_stack_t *st, stack_free free_handler, mln_stack_node_t *sn);
+static inline void **
+mln_stack_elems_alloc(mln_stack_t *st, mln_uauto_t len) __NONNULL1(1);
+static inline void
+mln_stack_elems_free(mln_stack_t *st, void **elems) __NONNULL1(1);
+static int
+mln_stack_resize(mln_stack_t *st, mln_uauto_t len) __NONNULL1(1);
 
 /*
- * stack_node
+ * elements
  */
-static mln_stack_node_t *
-mln_stack_node_init(void *data)
+static inline void **
+mln_stack_elems_alloc(mln_stack_t *st, mln_uauto_t len)
 {
-    mln_stack_node_t *sn = (mln_stack_node_t *)malloc(sizeof(mln_stack_node_t));
-    if (sn == NULL) return NULL;
-    sn->prev = NULL;
-    sn->next = NULL;
-    sn->data = data;
-    return sn;
+    if (st->pool != NULL)
+        return (void **)st->pool_alloc(st->pool, len * sizeof(void *));
+    return (void **)malloc(len * sizeof(void *));
 }
 
-static void
-mln_stack_node_destroy(mln_stack_t *st, stack_free free_handler, mln_stack_node_t *sn)
+static inline void
+mln_stack_elems_free(mln_stack_t *st, void **elems)
 {
-    if (sn == NULL) return;
-    if (free_handler != NULL)
-        free_handler(sn->data);
-    if (st->cache) {
-        sn->prev = sn->next = NULL;
-        mln_stack_chain_add(&(st->free_head), &(st->free_tail), sn);
+    if (elems == NULL) return;
+    if (st->pool != NULL) st->pool_free(elems);
+    else free(elems);
+}
+
+static int
+mln_stack_resize(mln_stack_t *st, mln_uauto_t len)
+{
+    void **elems;
+
+    if (st->pool == NULL) {
+        if ((elems = (void **)realloc(st->elems, len * sizeof(void *))) == NULL)
+            return -1;
     } else {
-        free(sn);
+        if ((elems = mln_stack_elems_alloc(st, len)) == NULL)
+            return -1;
+        memcpy(elems, st->elems, st->nr_node * sizeof(void *));
+        mln_stack_elems_free(st, st->elems);
     }
+    st->elems = elems;
+    st->len = len;
+    return 0;
 }
 
 /*
@@ -50,12 +60,19 @@ mln_stack_node_destroy(mln_stack_t *st, stack_free free_handler, mln_stack_node_
  */
 mln_stack_t *mln_stack_init(struct mln_stack_attr *attr)
 {
-    mln_stack_t *st = (mln_stack_t *)malloc(sizeof(mln_stack_t));
+    mln_stack_t *st;
+
+    if (attr->pool != NULL)
+        st = (mln_stack_t *)attr->pool_alloc(attr->pool, sizeof(mln_stack_t));
+    else
+        st = (mln_stack_t *)malloc(sizeof(mln_stack_t));
     if (st == NULL) return NULL;
-    st->bottom = NULL;
-    st->top = NULL;
-    st->free_head = st->free_tail = NULL;
+    st->elems = NULL;
     st->nr_node = 0;
+    st->len = 0;
+    st->pool = attr->pool;
+    st->pool_alloc = attr->pool_alloc;
+    st->pool_free = attr->pool_free;
     st->free_handler = attr->free_handler;
     st->copy_handler = attr->copy_handler;
     st->cache = attr->cache;
@@ -66,45 +83,32 @@ void mln_stack_destroy(mln_stack_t *st)
 {
     if (st == NULL) return;
 
-    mln_stack_node_t *sn;
-
-    st->cache = 0;
-    while ((sn = st->bottom) != NULL) {
-        mln_stack_chain_del(&(st->bottom), &(st->top), sn);
-        mln_stack_node_destroy(st, st->free_handler, sn);
+    if (st->free_handler != NULL) {
+        while (st->nr_node)
+            st->free_handler(st->elems[--(st->nr_node)]);
     }
-    while ((sn = st->free_head) != NULL) {
-        mln_stack_chain_del(&(st->free_head), &(st->free_tail), sn);
-        mln_stack_node_destroy(st, NULL, sn);
-    }
-    free(st);
+    mln_stack_elems_free(st, st->elems);
+    if (st->pool != NULL) st->pool_free(st);
+    else free(st);
 }
 
-/*
- * chain
- */
-MLN_CHAIN_FUNC_DEFINE(mln_stack, \
-                      mln_stack_node_t, \
-                      static inline void, \
-                      prev, \
-                      next);
+int mln_stack_reserve(mln_stack_t *st, mln_uauto_t n)
+{
+    mln_uauto_t len = st->len? st->len: M_STACK_LEN_BASE;
 
+    if (st->len - st->nr_node >= n) return 0;
+    while (len - st->nr_node < n) len <<= 1;
+    return mln_stack_resize(st, len);
+}
 
 /*
  * push
  */
 int mln_stack_push(mln_stack_t *st, void *data)
 {
-    mln_stack_node_t *sn;
-    if ((sn = st->free_head) != NULL) {
-        mln_stack_chain_del(&(st->free_head), &(st->free_tail), sn);
-        sn->data = data;
-    } else {
-        sn = mln_stack_node_init(data);
-        if (sn == NULL) return -1;
-    }
-    mln_stack_chain_add(&(st->bottom), &(st->top), sn);
-    ++(st->nr_node);
+    if (st->nr_node >= st->len && mln_stack_reserve(st, 1) < 0)
+        return -1;
+    st->elems[(st->nr_node)++] = data;
     return 0;
 }
 
@@ -113,12 +117,12 @@ int mln_stack_push(mln_stack_t *st, void *data)
  */
 void *mln_stack_pop(mln_stack_t *st)
 {
-    mln_stack_node_t *sn = st->top;
-    if (sn == NULL) return NULL;
-    mln_stack_chain_del(&(st->bottom), &(st->top), sn);
-    --(st->nr_node);
-    void *ptr = sn->data;
-    mln_stack_node_destroy(st, NULL, sn);
+    if (!st->nr_node) return NULL;
+    void *ptr = st->elems[--(st->nr_node)];
+    if (!st->cache && st->len > M_STACK_LEN_BASE && st->nr_node < (st->len >> 2)) {
+        /*failing to shrink is harmless*/
+        (void)mln_stack_resize(st, st->len >> 1);
+    }
     return ptr;
 }
 
@@ -129,29 +133,31 @@ void *mln_stack_pop(mln_stack_t *st)
 mln_stack_t *mln_stack_dup(mln_stack_t *st, void *udata)
 {
     struct mln_stack_attr sattr;
+    sattr.pool = st->pool;
+    sattr.pool_alloc = st->pool_alloc;
+    sattr.pool_free = st->pool_free;
     sattr.free_handler = st->free_handler;
     sattr.copy_handler = st->copy_handler;
     sattr.cache = st->cache;
     mln_stack_t *new_st = mln_stack_init(&sattr);
     if (new_st == NULL) return NULL;
-    mln_stack_node_t *scan;
-    void *data;
-    for (scan = st->bottom; scan != NULL; scan = scan->next) {
-        if (new_st->copy_handler == NULL) {
-            data = scan->data;
-        } else {
-            data = new_st->copy_handler(scan->data, udata);
-            if (data == NULL) {
-                mln_stack_destroy(new_st);
-                return NULL;
-            }
-        }
-        if (mln_stack_push(new_st, data) < 0) {
-            if (new_st->free_handler != NULL)
-                new_st->free_handler(data);
+    if (!st->nr_node) return new_st;
+    if (mln_stack_reserve(new_st, st->nr_node) < 0) {
+        mln_stack_destroy(new_st);
+        return NULL;
+    }
+    if (new_st->copy_handler == NULL) {
+        memcpy(new_st->elems, st->elems, st->nr_node * sizeof(void *));
+        new_st->nr_node = st->nr_node;
+        return new_st;
+    }
+    void **scan, **end = st->elems + st->nr_node;
+    for (scan = st->elems; scan < end; ++scan) {
+        if ((new_st->elems[new_st->nr_node] = new_st->copy_handler(*scan, udata)) == NULL) {
             mln_stack_destroy(new_st);
             return NULL;
         }
+        ++(new_st->nr_node);
     }
     return new_st;
 }
@@ -161,9 +167,9 @@ mln_stack_t *mln_stack_dup(mln_stack_t *st, void *udata)
  */
 int mln_stack_scan_all(mln_stack_t *st, stack_scan scanner, void *data)
 {
-    mln_stack_node_t *sn;
-    for (sn = st->top; sn != NULL; sn = sn->prev) {
-        if (scanner(sn->data, data) < 0) return -1;
+    void **scan = st->elems + st->nr_node;
+    while (scan > st->elems) {
+        if (scanner(*--scan, data) < 0) return -1;
     }
     return 0;
 }
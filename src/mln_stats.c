@@ -0,0 +1,264 @@
+
+/*
+ * Copyright (C) Niklaus F.Schen.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#if !defined(WIN32)
+#include <sys/mman.h>
+#endif
+#include "mln_stats.h"
+#include "mln_log.h"
+
+mln_u64_t *mln_stats_cur = NULL;
+mln_stats_item_t *mln_stats_items = NULL;
+static mln_u32_t mln_stats_n_items = 0;
+static mln_u32_t mln_stats_n_vals = 0;
+static mln_u32_t mln_stats_n_workers = 0;
+static mln_size_t mln_stats_slot_size = 0;/*in mln_u64_t*/
+static mln_u64_t *mln_stats_shm = NULL;
+
+static int mln_stats_register(char *name, enum mln_stats_type type, mln_u64_t *bounds, mln_u32_t n);
+static int mln_stats_write(int fd, char *buf, int len) __NONNULL1(2);
+
+#define mln_stats_slot(i) (mln_stats_shm + (i) * mln_stats_slot_size)
+
+
+static int mln_stats_register(char *name, enum mln_stats_type type, mln_u64_t *bounds, mln_u32_t n)
+{
+    mln_u32_t i;
+    mln_stats_item_t *items, *it;
+
+    if (mln_stats_shm != NULL) {
+        mln_log(error, "Statistics '%s' should be registered before the segment created.\n", name);
+        return -1;
+    }
+    if (strlen(name) > M_STATS_NAME_MAX) return -1;
+    if (type == M_STATS_HISTOGRAM) {
+        if (!n || n > M_STATS_BUCKET_MAX) return -1;
+        for (i = 1; i < n; ++i) {
+            if (bounds[i] <= bounds[i-1]) return -1;
+        }
+    }
+
+    items = (mln_stats_item_t *)realloc(mln_stats_items, (mln_stats_n_items + 1) * sizeof(mln_stats_item_t));
+    if (items == NULL) return -1;
+    mln_stats_items = items;
+    it = &items[mln_stats_n_items];
+    if ((it->name = strdup(name)) == NULL) return -1;
+    it->bounds = NULL;
+    it->n_bounds = 0;
+    if (type == M_STATS_HISTOGRAM) {
+        if ((it->bounds = (mln_u64_t *)malloc(n * sizeof(mln_u64_t))) == NULL) {
+            free(it->name);
+            return -1;
+        }
+        memcpy(it->bounds, bounds, n * sizeof(mln_u64_t));
+        it->n_bounds = n;
+    }
+    it->type = type;
+    it->off = mln_stats_n_vals;
+    /*a histogram has n+1 buckets and a sum*/
+    mln_stats_n_vals += type == M_STATS_HISTOGRAM? n + 2: 1;
+    return mln_stats_n_items++;
+}
+
+int mln_stats_counter_register(char *name)
+{
+    return mln_stats_register(name, M_STATS_COUNTER, NULL, 0);
+}
+
+int mln_stats_gauge_register(char *name)
+{
+    return mln_stats_register(name, M_STATS_GAUGE, NULL, 0);
+}
+
+int mln_stats_histogram_register(char *name, mln_u64_t *bounds, mln_u32_t n)
+{
+    return mln_stats_register(name, M_STATS_HISTOGRAM, bounds, n);
+}
+
+/*
+ * Slots are cacheline aligned, so processes never write the same cacheline.
+ */
+int mln_stats_init(mln_u32_t n_workers)
+{
+    mln_size_t size;
+    mln_u32_t per_line = M_CACHELINE_SIZE / sizeof(mln_u64_t);
+
+    if (mln_stats_shm != NULL || !mln_stats_n_vals) return 0;
+
+    mln_stats_slot_size = (mln_stats_n_vals + per_line - 1) / per_line * per_line;
+    size = (n_workers + 1) * mln_stats_slot_size * sizeof(mln_u64_t);
+#if defined(WIN32)
+    if (posix_memalign((void **)&mln_stats_shm, M_CACHELINE_SIZE, size) != 0) {
+        mln_stats_shm = NULL;
+        mln_log(error, "No memory.\n");
+        return -1;
+    }
+    memset(mln_stats_shm, 0, size);
+#else
+    mln_stats_shm = (mln_u64_t *)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if (mln_stats_shm == MAP_FAILED) {
+        mln_stats_shm = NULL;
+        mln_log(error, "mmap() failed. %s\n", strerror(errno));
+        return -1;
+    }
+#endif
+    mln_stats_n_workers = n_workers;
+    mln_stats_cur = mln_stats_slot(n_workers);
+    return 0;
+}
+
+void mln_stats_destroy(void)
+{
+    mln_u32_t i;
+
+    if (mln_stats_shm != NULL) {
+#if defined(WIN32)
+        free(mln_stats_shm);
+#else
+        munmap(mln_stats_shm, (mln_stats_n_workers + 1) * mln_stats_slot_size * sizeof(mln_u64_t));
+#endif
+        mln_stats_shm = NULL;
+    }
+    mln_stats_cur = NULL;
+    for (i = 0; i < mln_stats_n_items; ++i) {
+        free(mln_stats_items[i].name);
+        if (mln_stats_items[i].bounds != NULL) free(mln_stats_items[i].bounds);
+    }
+    free(mln_stats_items);
+    mln_stats_items = NULL;
+    mln_stats_n_items = mln_stats_n_vals = mln_stats_n_workers = 0;
+}
+
+void mln_stats_worker_set(mln_sauto_t worker_id)
+{
+    mln_u32_t i;
+    mln_stats_item_t *it;
+
+    if (mln_stats_shm == NULL || worker_id < 0) return;
+
+    /*
+     * Processes forked by mln_fork_restart() get ids beyond n_workers,
+     * they have no slot and must not share the slot of a live worker.
+     */
+    if (worker_id >= (mln_sauto_t)mln_stats_n_workers) {
+        mln_stats_cur = NULL;
+        return;
+    }
+
+    mln_stats_cur = mln_stats_slot(worker_id);
+    /*gauges of the replaced worker process are meaningless*/
+    for (i = 0, it = mln_stats_items; i < mln_stats_n_items; ++i, ++it) {
+        if (it->type == M_STATS_GAUGE)
+            __atomic_store_n(&mln_stats_cur[it->off], 0, __ATOMIC_RELAXED);
+    }
+}
+
+void mln_stats_observe(int id, mln_u64_t v)
+{
+    mln_u32_t lo, hi, mid;
+    mln_stats_item_t *it;
+
+    if (mln_stats_cur == NULL || id < 0 || (mln_u32_t)id >= mln_stats_n_items) return;
+    it = &mln_stats_items[id];
+    if (it->type != M_STATS_HISTOGRAM) return;
+
+    lo = 0;
+    hi = it->n_bounds;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (it->bounds[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    __atomic_add_fetch(&mln_stats_cur[it->off + lo], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mln_stats_cur[it->off + it->n_bounds + 1], v, __ATOMIC_RELAXED);
+}
+
+static inline mln_u64_t mln_stats_val(mln_u32_t off, mln_sauto_t slot)
+{
+    mln_u32_t i;
+    mln_u64_t sum = 0;
+
+    if (slot >= 0)
+        return __atomic_load_n(&(mln_stats_slot(slot)[off]), __ATOMIC_RELAXED);
+    for (i = 0; i <= mln_stats_n_workers; ++i)
+        sum += __atomic_load_n(&(mln_stats_slot(i)[off]), __ATOMIC_RELAXED);
+    return sum;
+}
+
+mln_u64_t mln_stats_get(int id, mln_sauto_t slot)
+{
+    mln_u32_t i;
+    mln_u64_t sum = 0;
+    mln_stats_item_t *it;
+
+    if (mln_stats_shm == NULL || id < 0 || (mln_u32_t)id >= mln_stats_n_items) return 0;
+    if (slot > (mln_sauto_t)mln_stats_n_workers) return 0;
+    it = &mln_stats_items[id];
+    if (it->type != M_STATS_HISTOGRAM) return mln_stats_val(it->off, slot);
+    for (i = 0; i <= it->n_bounds; ++i)
+        sum += mln_stats_val(it->off + i, slot);
+    return sum;
+}
+
+static int mln_stats_write(int fd, char *buf, int len)
+{
+    int n;
+    while (len > 0) {
+        if ((n = write(fd, buf, len)) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Format:
+ *     name value
+ *     name_bucket{le="bound"} cumulative count
+ *     name_sum value
+ *     name_count value
+ */
+int mln_stats_dump(int fd)
+{
+    int len;
+    mln_u32_t i, j;
+    mln_u64_t cnt;
+    mln_stats_item_t *it;
+    char buf[512];
+
+    if (mln_stats_shm == NULL) return 0;
+
+    for (i = 0, it = mln_stats_items; i < mln_stats_n_items; ++i, ++it) {
+        if (it->type != M_STATS_HISTOGRAM) {
+            len = snprintf(buf, sizeof(buf), "%s %llu\n", it->name, \
+                           (unsigned long long)mln_stats_val(it->off, -1));
+            if (mln_stats_write(fd, buf, len) < 0) return -1;
+            continue;
+        }
+        for (cnt = 0, j = 0; j <= it->n_bounds; ++j) {
+            cnt += mln_stats_val(it->off + j, -1);
+            if (j < it->n_bounds)
+                len = snprintf(buf, sizeof(buf), "%s_bucket{le=\"%llu\"} %llu\n", \
+                               it->name, (unsigned long long)it->bounds[j], (unsigned long long)cnt);
+            else
+                len = snprintf(buf, sizeof(buf), "%s_bucket{le=\"+Inf\"} %llu\n", \
+                               it->name, (unsigned long long)cnt);
+            if (mln_stats_write(fd, buf, len) < 0) return -1;
+        }
+        len = snprintf(buf, sizeof(buf), "%s_sum %llu\n%s_count %llu\n", \
+                       it->name, (unsigned long long)mln_stats_val(it->off + it->n_bounds + 1, -1), \
+                       it->name, (unsigned long long)cnt);
+        if (mln_stats_write(fd, buf, len) < 0) return -1;
+    }
+    return 0;
+}
+
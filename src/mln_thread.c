@@ -13,9 +13,11 @@
 #include <unistd.h>
 #include <pthread.h>
 #include "mln_thread.h"
+#include "mln_notifier.h"
 #include "mln_rbtree.h"
 #include "mln_conf.h"
 #include "mln_log.h"
+#include "mln_affinity.h"
 
 /*
  * global variables
@@ -34,6 +36,19 @@ char thread_start_func[] = "thread_main";
  */
 static mln_thread_module_t *module_array = NULL;
 static mln_size_t module_array_num = 0;
+/*
+ * In thread mode, 'worker_cpu_affinity' is applied to
+ * the threads in 'thread_exec' in order.
+ */
+static mln_affinity_t *thread_affinity = NULL;
+static mln_u32_t n_thread_affinity = 0;
+static mln_u32_t thread_id_seq = 0;
+/*
+ * Channels are only locked when opened, looked up or closed.
+ */
+static mln_thread_chan_t *thread_chan_head = NULL;
+static mln_thread_chan_t *thread_chan_tail = NULL;
+static pthread_mutex_t thread_chan_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
  * declarations
@@ -44,6 +59,13 @@ MLN_CHAIN_FUNC_DECLARE(msg_dest, \
 MLN_CHAIN_FUNC_DECLARE(msg_local, \
                        mln_thread_msgq_t, \
                        static inline void,);
+MLN_CHAIN_FUNC_DECLARE(thread_chan, \
+                       mln_thread_chan_t, \
+                       static inline void,);
+static inline mln_thread_chan_t *
+mln_thread_chan_search(mln_string_t *name) __NONNULL1(1);
+static void
+mln_thread_chan_recv_handler(mln_event_t *ev, int fd, void *data);
 static mln_thread_msgq_t *
 mln_thread_msgq_init(mln_thread_t *sender, mln_thread_msg_t *msg);
 static void
@@ -95,6 +117,7 @@ mln_thread_init(struct mln_thread_attr *attr)
     t->argv = attr->argv;
     t->argc = attr->argc;
     t->peerfd = attr->peerfd;
+    t->id = attr->id;
     t->is_created = 0;
     t->stype = attr->stype;
     if (mln_tcp_conn_init(&(t->conn), attr->sockfd) < 0) {
@@ -202,6 +225,12 @@ int mln_load_thread(mln_event_t *ev)
     mln_u32_t nr_cmds = mln_conf_get_ncmd(cf, thread_domain);
     if (nr_cmds == 0) return 0;
 
+    if (mln_affinity_conf_load("worker_cpu_affinity", &thread_affinity, &n_thread_affinity) < 0) {
+        mln_rbtree_destroy(thread_tree);
+        thread_tree = NULL;
+        return -1;
+    }
+
     mln_conf_cmd_t **v = (mln_conf_cmd_t **)calloc(nr_cmds, sizeof(mln_conf_cmd_t *));
     if (v == NULL) {
         mln_log(error, "No memory.\n");
@@ -270,6 +299,7 @@ mln_loada_thread(mln_event_t *ev, mln_conf_cmd_t *cc)
     }
     thattr.sockfd = fds[0];
     thattr.peerfd = fds[1];
+    thattr.id = thread_id_seq++;
     t = mln_thread_init(&thattr);
     if (t == NULL) {
         mln_log(error, "No memory.\n");
@@ -630,6 +660,9 @@ mln_thread_launcher(void *args)
 {
     mln_thread_t *t = (mln_thread_t *)args;
     m_thread = t;
+    if (n_thread_affinity && mln_affinity_bind(&thread_affinity[t->id % n_thread_affinity]) < 0) {
+        mln_log(error, "Bind thread '%s' failed. %s\n", t->argv[0], strerror(errno));
+    }
     int ret = t->thread_main(t->argc, t->argv);
     if (thread_cleanup != NULL)
         thread_cleanup(thread_data);
@@ -702,6 +735,148 @@ void mln_thread_cleanup_set(void (*tcleanup)(void *), void *data)
     thread_data = data;
 }
 
+/*
+ * channel
+ */
+static inline mln_thread_chan_t *mln_thread_chan_search(mln_string_t *name)
+{
+    mln_thread_chan_t *chan;
+    for (chan = thread_chan_head; chan != NULL; chan = chan->next) {
+        if (!mln_string_strcmp(chan->name, name)) break;
+    }
+    return chan;
+}
+
+mln_thread_chan_t *mln_thread_chan_open(mln_string_t *name, mln_u32_t qlen)
+{
+    mln_thread_chan_t *chan;
+    struct mln_queue_ring_attr rattr;
+
+    pthread_mutex_lock(&thread_chan_lock);
+    if ((chan = mln_thread_chan_search(name)) != NULL) {
+        pthread_mutex_unlock(&thread_chan_lock);
+        return chan;
+    }
+
+    if ((chan = (mln_thread_chan_t *)malloc(sizeof(mln_thread_chan_t))) == NULL) {
+        pthread_mutex_unlock(&thread_chan_lock);
+        return NULL;
+    }
+    if ((chan->name = mln_string_dup(name)) == NULL) {
+        pthread_mutex_unlock(&thread_chan_lock);
+        free(chan);
+        return NULL;
+    }
+    rattr.qlen = qlen? qlen: M_THREAD_CHAN_QLEN;
+    rattr.free_handler = NULL;
+    rattr.mode = M_QUEUE_RING_MPMC;
+    if ((chan->ring = mln_queue_ring_init(&rattr)) == NULL) {
+        pthread_mutex_unlock(&thread_chan_lock);
+        mln_string_free(chan->name);
+        free(chan);
+        return NULL;
+    }
+    if (mln_notifier_init(&(chan->rfd), &(chan->wfd)) < 0) {
+        pthread_mutex_unlock(&thread_chan_lock);
+        mln_queue_ring_destroy(chan->ring);
+        mln_string_free(chan->name);
+        free(chan);
+        return NULL;
+    }
+    chan->ev = NULL;
+    chan->handler = NULL;
+    chan->data = NULL;
+    chan->prev = chan->next = NULL;
+    chan->notified = 0;
+    thread_chan_chain_add(&thread_chan_head, &thread_chan_tail, chan);
+    pthread_mutex_unlock(&thread_chan_lock);
+    return chan;
+}
+
+mln_thread_chan_t *mln_thread_chan_get(mln_string_t *name)
+{
+    mln_thread_chan_t *chan;
+
+    pthread_mutex_lock(&thread_chan_lock);
+    chan = mln_thread_chan_search(name);
+    pthread_mutex_unlock(&thread_chan_lock);
+    return chan;
+}
+
+void mln_thread_chan_close(mln_thread_chan_t *chan)
+{
+    if (chan == NULL) return;
+
+    pthread_mutex_lock(&thread_chan_lock);
+    thread_chan_chain_del(&thread_chan_head, &thread_chan_tail, chan);
+    pthread_mutex_unlock(&thread_chan_lock);
+
+    mln_notifier_destroy(chan->rfd, chan->wfd);
+    mln_queue_ring_destroy(chan->ring);
+    mln_string_free(chan->name);
+    free(chan);
+}
+
+/*
+ * The event of the last receiver is never touched here, it may be freed
+ * with its thread. The last receiver removes chan from its event
+ * by mln_thread_chan_unset_event() before it exits.
+ */
+int mln_thread_chan_set_event(mln_thread_chan_t *chan, mln_event_t *ev, mln_thread_chan_handler handler, void *data)
+{
+    chan->ev = ev;
+    chan->handler = handler;
+    chan->data = data;
+    if (mln_event_set_fd(ev, \
+                         chan->rfd, \
+                         M_EV_RECV|M_EV_NONBLOCK, \
+                         M_EV_UNLIMITED, \
+                         chan, \
+                         mln_thread_chan_recv_handler) < 0)
+    {
+        chan->ev = NULL;
+        return -1;
+    }
+    /*
+     * The notification of the messages sent before may be consumed by the
+     * last receiver, e.g. a thread restarted, so notify the new one.
+     */
+    __atomic_store_n(&(chan->notified), 1, __ATOMIC_SEQ_CST);
+    (void)mln_notifier_wake(chan->wfd);
+    return 0;
+}
+
+void mln_thread_chan_unset_event(mln_thread_chan_t *chan, mln_event_t *ev)
+{
+    mln_event_set_fd(ev, chan->rfd, M_EV_CLR, M_EV_UNLIMITED, NULL, NULL);
+    if (chan->ev != ev) return;
+    chan->ev = NULL;
+    chan->handler = NULL;
+    chan->data = NULL;
+}
+
+int mln_thread_chan_send(mln_thread_chan_t *chan, void *msg)
+{
+    if (mln_queue_ring_push(chan->ring, msg) < 0)
+        return -1;
+
+    mln_notifier_notify(&(chan->notified), chan->wfd);
+    return 0;
+}
+
+static void mln_thread_chan_recv_handler(mln_event_t *ev, int fd, void *data)
+{
+    void *msg;
+    mln_thread_chan_t *chan = (mln_thread_chan_t *)data;
+
+    mln_notifier_drain(&(chan->notified), fd);
+
+    while ((msg = mln_queue_ring_pop(chan->ring)) != NULL) {
+        if (chan->handler != NULL)
+            chan->handler(ev, chan, msg, chan->data);
+    }
+}
+
 /*
  * chain
  */
@@ -715,6 +890,11 @@ MLN_CHAIN_FUNC_DEFINE(msg_local, \
                       static inline void, \
                       local_prev, \
                       local_next);
+MLN_CHAIN_FUNC_DEFINE(thread_chan, \
+                      mln_thread_chan_t, \
+                      static inline void, \
+                      prev, \
+                      next);
 
 static mln_thread_msgq_t *
 mln_thread_msgq_init(mln_thread_t *sender, mln_thread_msg_t *msg)
@@ -8,7 +8,10 @@
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <sched.h>
+#include <unistd.h>
 #include "mln_log.h"
+#include "mln_notifier.h"
 
 /*
  * There is a problem in linux.
@@ -38,7 +41,14 @@
 __thread mln_thread_pool_member_t *m_thread_pool_self = NULL;
 
 static void *child_thread_launcher(void *arg);
+static void *ws_thread_launcher(void *arg);
 static void mln_thread_pool_free(mln_thread_pool_t *tp);
+static int mln_thread_pool_deques_init(mln_thread_pool_t *tp);
+static void mln_thread_pool_deques_free(mln_thread_pool_t *tp);
+static int mln_thread_pool_ws_resource_add(void **data, mln_size_t n);
+static int mln_thread_pool_ws_start(mln_thread_pool_t *tpool);
+static void mln_thread_pool_future_ev_handler(mln_event_t *ev, int fd, void *data);
+static int mln_thread_pool_min_start(mln_thread_pool_t *tpool);
 
 MLN_CHAIN_FUNC_DECLARE(mln_child, \
                        mln_thread_pool_member_t, \
@@ -56,6 +66,9 @@ mln_thread_pool_member_new(mln_thread_pool_t *tpool, mln_u32_t child)
     }
     tpm->data = NULL;
     tpm->pool = tpool;
+    tpm->deque = NULL;
+    tpm->affinity = NULL;
+    tpm->seed = 0;
     tpm->idle = 1;
     tpm->locked = 0;
     tpm->forked = 0;
@@ -78,7 +91,8 @@ mln_thread_pool_member_join(mln_thread_pool_t *tp, mln_u32_t child)
     /*
      * @ mutex must be locked by caller.
      * and m_thread_pool_self will be set later.
-     * This function only can be called by main thread.
+     * This function can be called by child threads
+     * only if the pool is growing by latency.
      */
     mln_thread_pool_member_t *tpm;
     if ((tpm = mln_thread_pool_member_new(tp, child)) == NULL) {
@@ -106,6 +120,7 @@ static void mln_thread_pool_member_exit(void *arg)
     mln_child_chain_del(&(tpool->child_head), &(tpool->child_tail), tpm);
     --(tpool->counter);
     if (tpm->idle) --(tpool->idle);
+    if (tpool->counter <= 1) pthread_cond_signal(&(tpool->exit_cond));
     pthread_mutex_unlock(&(tpool->mutex));
     mln_thread_pool_member_free(tpm);
     if (forked && child) {
@@ -168,7 +183,15 @@ mln_thread_pool_new(struct mln_thread_pool_attr *tpattr, int *err)
         *err = rc;
         return NULL;
     }
+    if ((rc = pthread_cond_init(&(tp->exit_cond), NULL)) != 0) {
+        pthread_cond_destroy(&(tp->cond));
+        pthread_mutex_destroy(&(tp->mutex));
+        free(tp);
+        *err = rc;
+        return NULL;
+    }
     if ((rc = pthread_attr_init(&(tp->attr))) != 0) {
+        pthread_cond_destroy(&(tp->exit_cond));
         pthread_cond_destroy(&(tp->cond));
         pthread_mutex_destroy(&(tp->mutex));
         free(tp);
@@ -177,6 +200,7 @@ mln_thread_pool_new(struct mln_thread_pool_attr *tpattr, int *err)
     }
     if ((rc = pthread_attr_setdetachstate(&(tp->attr), PTHREAD_CREATE_DETACHED)) != 0) {
         pthread_attr_destroy(&(tp->attr));
+        pthread_cond_destroy(&(tp->exit_cond));
         pthread_cond_destroy(&(tp->cond));
         pthread_mutex_destroy(&(tp->mutex));
         free(tp);
@@ -188,10 +212,28 @@ mln_thread_pool_new(struct mln_thread_pool_attr *tpattr, int *err)
     tp->idle = tp->counter = 0;
     tp->quit = 0;
     tp->cond_timeout = tpattr->cond_timeout;
+    tp->latency = tpattr->latency * 1000;
+    tp->shrink_tm = 0;
     tp->n_res = 0;
     tp->process_handler = tpattr->child_process_handler;
     tp->free_handler = tpattr->free_handler;
     tp->max = tpattr->max;
+    tp->min = tpattr->min;
+    tp->work_stealing = tpattr->work_stealing? 1: 0;
+    tp->sleepers = 0;
+    tp->deques = NULL;
+    tp->affinity = tpattr->n_affinity? tpattr->affinity: NULL;
+    tp->n_affinity = tp->affinity == NULL? 0: tpattr->n_affinity;
+    tp->affinity_seq = 0;
+    if (tp->work_stealing && (rc = mln_thread_pool_deques_init(tp)) != 0) {
+        pthread_attr_destroy(&(tp->attr));
+        pthread_cond_destroy(&(tp->exit_cond));
+        pthread_cond_destroy(&(tp->cond));
+        pthread_mutex_destroy(&(tp->mutex));
+        free(tp);
+        *err = rc;
+        return NULL;
+    }
 #ifdef MLN_USE_UNIX98
     if (tpattr->concurrency) pthread_setconcurrency(tpattr->concurrency);
 #endif
@@ -200,7 +242,9 @@ mln_thread_pool_new(struct mln_thread_pool_attr *tpattr, int *err)
                              mln_thread_pool_parent, \
                              mln_thread_pool_child)) != 0)
     {
+        mln_thread_pool_deques_free(tp);
         pthread_attr_destroy(&(tp->attr));
+        pthread_cond_destroy(&(tp->exit_cond));
         pthread_cond_destroy(&(tp->cond));
         pthread_mutex_destroy(&(tp->mutex));
         free(tp);
@@ -209,13 +253,16 @@ mln_thread_pool_new(struct mln_thread_pool_attr *tpattr, int *err)
     }
 #endif
     if ((m_thread_pool_self = mln_thread_pool_member_join(tp, 0)) == NULL) {
+        mln_thread_pool_deques_free(tp);
         pthread_attr_destroy(&(tp->attr));
+        pthread_cond_destroy(&(tp->exit_cond));
         pthread_cond_destroy(&(tp->cond));
         pthread_mutex_destroy(&(tp->mutex));
         free(tp);
         *err = ENOMEM;
         return NULL;
     }
+    if (tp->work_stealing) m_thread_pool_self->deque = &(tp->deques[tp->max]);
     return tp;
 }
 
@@ -229,12 +276,14 @@ static void mln_thread_pool_free(mln_thread_pool_t *tp)
         if (tp->free_handler != NULL) tp->free_handler(tpr->data);
         free(tpr);
     }
+    mln_thread_pool_deques_free(tp);
     if (tp->child_head != NULL || tp->counter || tp->idle) {
         mln_log(error, "fatal error, thread pool messed up.\n");
         abort();
     }
     pthread_mutex_destroy(&(tp->mutex));
     pthread_cond_destroy(&(tp->cond));
+    pthread_cond_destroy(&(tp->exit_cond));
     pthread_attr_destroy(&(tp->attr));
     free(tp);
 }
@@ -243,58 +292,155 @@ static void mln_thread_pool_free(mln_thread_pool_t *tp)
 /*
  * resource
  */
+static inline mln_u64_t mln_thread_pool_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mln_u64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void mln_thread_pool_deadline(struct timespec *ts, mln_u64_t ms)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    if ((ts->tv_nsec += (ms % 1000) * 1000000) >= 1000000000) {
+        ts->tv_nsec -= 1000000000;
+        ++(ts->tv_sec);
+    }
+}
+
+/*
+ * Child threads are pinned to the affinities in turn,
+ * and bind themselves at the beginning of the launchers.
+ */
+static inline void mln_thread_pool_affinity_choose(mln_thread_pool_t *tpool, mln_thread_pool_member_t *tpm)
+{
+    if (!tpool->n_affinity) return;
+    tpm->affinity = &(tpool->affinity[tpool->affinity_seq++ % tpool->n_affinity]);
+}
+
+static inline void mln_thread_pool_affinity_bind(mln_thread_pool_member_t *tpm)
+{
+    if (tpm->affinity != NULL && mln_affinity_bind(tpm->affinity) < 0) {
+        mln_log(error, "Bind child thread failed. %s\n", strerror(errno));
+    }
+}
+
+/*
+ * Create a child thread if there are not enough idle threads.
+ * @ the lock will be locked by caller.
+ */
+static inline int mln_thread_pool_child_create(mln_thread_pool_t *tpool)
+{
+    int rc;
+    pthread_t threadid;
+    mln_thread_pool_member_t *tpm;
+
+    if ((tpm = mln_thread_pool_member_join(tpool, 1)) == NULL) {
+        return ENOMEM;
+    }
+    mln_thread_pool_affinity_choose(tpool, tpm);
+    if ((rc = pthread_create(&threadid, &(tpool->attr), child_thread_launcher, tpm)) != 0) {
+        mln_child_chain_del(&(tpool->child_head), &(tpool->child_tail), tpm);
+        --(tpool->counter);
+        --(tpool->idle);
+        mln_thread_pool_member_free(tpm);
+        return rc;
+    }
+    return 0;
+}
+
 int mln_thread_pool_resource_add(void *data)
+{
+    return mln_thread_pool_resource_add_batch(&data, 1);
+}
+
+int mln_thread_pool_resource_add_batch(void **data, mln_size_t n)
 {
     /*
-     * Only main thread can call this function
+     * Only threads of the pool can call this function, that is the main thread,
+     * or any of them in work stealing mode.
      */
     if (m_thread_pool_self == NULL) {
         mln_log(error, "Fatal error, thread messed up.\n");
         abort();
     }
-    mln_thread_pool_resource_t *tpr;
+    int rc = 0;
+    mln_size_t i;
+    mln_u64_t tm;
+    mln_thread_pool_resource_t *tpr, *head = NULL, *tail = NULL;
     mln_thread_pool_t *tpool = m_thread_pool_self->pool;
 
-    if ((tpr = (mln_thread_pool_resource_t *)malloc(sizeof(mln_thread_pool_resource_t))) == NULL) {
-        return ENOMEM;
+    if (!n) return 0;
+    if (tpool->work_stealing) return mln_thread_pool_ws_resource_add(data, n);
+
+    tm = tpool->latency? mln_thread_pool_now(): 0;
+
+    for (i = 0; i < n; ++i) {
+        if ((tpr = (mln_thread_pool_resource_t *)malloc(sizeof(mln_thread_pool_resource_t))) == NULL) {
+            while ((tpr = head) != NULL) {
+                head = head->next;
+                free(tpr);
+            }
+            return ENOMEM;
+        }
+        tpr->data = data[i];
+        tpr->tm = tm;
+        tpr->next = NULL;
+        if (head == NULL) head = tail = tpr;
+        else {
+            tail->next = tpr;
+            tail = tpr;
+        }
     }
-    tpr->data = data;
-    tpr->next = NULL;
 
     m_thread_pool_self->locked = 1;
     pthread_mutex_lock(&(tpool->mutex));
 
     if (tpool->res_chain_head == NULL) {
-        tpool->res_chain_head = tpool->res_chain_tail = tpr;
+        tpool->res_chain_head = head;
     } else {
-        tpool->res_chain_tail->next = tpr;
-        tpool->res_chain_tail = tpr;
+        tpool->res_chain_tail->next = head;
     }
-    ++(tpool->n_res);
+    tpool->res_chain_tail = tail;
+    tpool->n_res += n;
 
-    if (tpool->idle <= 1 && tpool->counter < tpool->max+1) {
-        int rc;
-        pthread_t threadid;
-        mln_thread_pool_member_t *tpm;
-        if ((tpm = mln_thread_pool_member_join(tpool, 1)) == NULL) {
-            pthread_mutex_unlock(&(tpool->mutex));
-            m_thread_pool_self->locked = 0;
-            return ENOMEM;
-        }
-        if ((rc = pthread_create(&threadid, &(tpool->attr), child_thread_launcher, tpm)) != 0) {
-            pthread_mutex_unlock(&(tpool->mutex));
-            m_thread_pool_self->locked = 0;
-            return rc;
+    /*
+     * The main thread is also counted in idle, so idle - 1 child threads
+     * are waiting for resources. Create threads until all queued
+     * resources, including the earlier ones, have a waiting thread.
+     */
+    while (tpool->idle - 1 < tpool->n_res && tpool->counter < tpool->max+1) {
+        if ((rc = mln_thread_pool_child_create(tpool)) != 0) break;
+    }
+    /*
+     * Resources are queued even if no more threads can be created,
+     * the existing threads will process them.
+     */
+    if (rc != 0 && tpool->counter <= 1) {
+        mln_thread_pool_resource_t *prev = NULL;
+        for (tpr = tpool->res_chain_head; tpr != head; tpr = tpr->next) prev = tpr;
+        if (prev == NULL) tpool->res_chain_head = NULL;
+        else prev->next = NULL;
+        tpool->res_chain_tail = prev;
+        tpool->n_res -= n;
+        pthread_mutex_unlock(&(tpool->mutex));
+        m_thread_pool_self->locked = 0;
+        while ((tpr = head) != NULL) {
+            head = head->next;
+            free(tpr);
         }
+        return rc;
     }
-    pthread_cond_signal(&(tpool->cond));
+    if (n > 1) pthread_cond_broadcast(&(tpool->cond));
+    else pthread_cond_signal(&(tpool->cond));
 
     pthread_mutex_unlock(&(tpool->mutex));
     m_thread_pool_self->locked = 0;
     return 0;
 }
 
-static void *mln_thread_pool_resource_remove(void)
+static void *mln_thread_pool_resource_remove(mln_u64_t *tm)
 {
     /*
      * Only child threads can call this function
@@ -312,6 +458,7 @@ again:
     if (tpool->res_chain_head == NULL) tpool->res_chain_tail = NULL;
     --(tpool->n_res);
     m_thread_pool_self->data = tpr->data;
+    *tm = tpr->tm;
     free(tpr);
     if (m_thread_pool_self->data == NULL) goto again;
 
@@ -320,6 +467,250 @@ again:
     return m_thread_pool_self->data;
 }
 
+/*
+ * work stealing
+ */
+static inline mln_thread_pool_array_t *mln_thread_pool_array_new(mln_sauto_t len)
+{
+    mln_thread_pool_array_t *a;
+    a = (mln_thread_pool_array_t *)malloc(sizeof(mln_thread_pool_array_t) + len * sizeof(void *));
+    if (a == NULL) return NULL;
+    a->mask = len - 1;
+    a->retired = NULL;
+    return a;
+}
+
+static int mln_thread_pool_deques_init(mln_thread_pool_t *tp)
+{
+    mln_u32_t i, n = tp->max + 1;
+    mln_thread_pool_deque_t *d;
+
+    if (posix_memalign((void **)&(tp->deques), M_CACHELINE_SIZE, n * sizeof(mln_thread_pool_deque_t)) != 0)
+        return ENOMEM;
+    for (i = 0; i < n; ++i) {
+        d = &(tp->deques[i]);
+        d->top = d->bottom = 0;
+        if ((d->array = mln_thread_pool_array_new(M_THREAD_POOL_DEQUE_LEN)) == NULL) {
+            while (i-- > 0) free(tp->deques[i].array);
+            free(tp->deques);
+            tp->deques = NULL;
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+static void mln_thread_pool_deques_free(mln_thread_pool_t *tp)
+{
+    mln_u32_t i;
+    mln_sauto_t j;
+    mln_thread_pool_deque_t *d;
+    mln_thread_pool_array_t *a, *fr;
+
+    if (tp->deques == NULL) return;
+    for (i = 0; i <= tp->max; ++i) {
+        d = &(tp->deques[i]);
+        a = d->array;
+        if (tp->free_handler != NULL) {
+            for (j = d->top; j < d->bottom; ++j)
+                tp->free_handler(a->buf[j & a->mask]);
+        }
+        while ((fr = a) != NULL) {
+            a = a->retired;
+            free(fr);
+        }
+    }
+    free(tp->deques);
+    tp->deques = NULL;
+}
+
+/*
+ * Only the owner can push to and take from the bottom of its deque,
+ * others steal from the top.
+ * Arrays replaced by larger ones are kept in the retired chain until
+ * the pool is freed, since thieves may still be reading them.
+ */
+static int mln_thread_pool_deque_push(mln_thread_pool_deque_t *d, void **data, mln_size_t n)
+{
+    mln_size_t j;
+    mln_sauto_t i, len, b = __atomic_load_n(&(d->bottom), __ATOMIC_RELAXED);
+    mln_sauto_t t = __atomic_load_n(&(d->top), __ATOMIC_ACQUIRE);
+    mln_thread_pool_array_t *a = __atomic_load_n(&(d->array), __ATOMIC_RELAXED), *na;
+
+    if (b - t + (mln_sauto_t)n > a->mask + 1) {
+        for (len = (a->mask + 1) << 1; len < b - t + (mln_sauto_t)n; len <<= 1)
+            ;
+        if ((na = mln_thread_pool_array_new(len)) == NULL)
+            return ENOMEM;
+        for (i = t; i < b; ++i)
+            na->buf[i & na->mask] = __atomic_load_n(&(a->buf[i & a->mask]), __ATOMIC_RELAXED);
+        na->retired = a;
+        __atomic_store_n(&(d->array), na, __ATOMIC_RELEASE);
+        a = na;
+    }
+    for (j = 0; j < n; ++j)
+        __atomic_store_n(&(a->buf[(b + j) & a->mask]), data[j], __ATOMIC_RELAXED);
+    /*all n resources are published by one store of bottom*/
+    __atomic_store_n(&(d->bottom), b + n, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void *mln_thread_pool_deque_take(mln_thread_pool_deque_t *d)
+{
+    void *data = NULL;
+    mln_sauto_t t, b = __atomic_load_n(&(d->bottom), __ATOMIC_RELAXED) - 1;
+    mln_thread_pool_array_t *a = __atomic_load_n(&(d->array), __ATOMIC_RELAXED);
+
+    __atomic_store_n(&(d->bottom), b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&(d->top), __ATOMIC_RELAXED);
+    if (t <= b) {
+        data = __atomic_load_n(&(a->buf[b & a->mask]), __ATOMIC_RELAXED);
+        if (t == b) {
+            /*the last one, race with thieves*/
+            if (!__atomic_compare_exchange_n(&(d->top), &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                data = NULL;
+            __atomic_store_n(&(d->bottom), b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&(d->bottom), b + 1, __ATOMIC_RELAXED);
+    }
+    return data;
+}
+
+/*
+ * return value: 1 - got one, 0 - empty, -1 - lost the race with others
+ */
+static int mln_thread_pool_deque_steal(mln_thread_pool_deque_t *d, void **data)
+{
+    mln_thread_pool_array_t *a;
+    mln_sauto_t b, t = __atomic_load_n(&(d->top), __ATOMIC_ACQUIRE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&(d->bottom), __ATOMIC_ACQUIRE);
+    if (t >= b) return 0;
+    a = __atomic_load_n(&(d->array), __ATOMIC_ACQUIRE);
+    *data = __atomic_load_n(&(a->buf[t & a->mask]), __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&(d->top), &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return -1;
+    return 1;
+}
+
+static inline int mln_thread_pool_ws_has_resource(mln_thread_pool_t *tpool)
+{
+    mln_thread_pool_deque_t *d, *end = tpool->deques + tpool->max + 1;
+    for (d = tpool->deques; d < end; ++d) {
+        if (__atomic_load_n(&(d->top), __ATOMIC_ACQUIRE) < __atomic_load_n(&(d->bottom), __ATOMIC_ACQUIRE))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Take from its own deque first, then steal from others
+ * beginning at a random victim.
+ */
+static void *mln_thread_pool_ws_resource_remove(mln_thread_pool_member_t *tpm)
+{
+    void *data;
+    int rc, retry;
+    mln_thread_pool_t *tpool = tpm->pool;
+    mln_u32_t i, victim, n = tpool->max + 1;
+
+    if ((data = mln_thread_pool_deque_take(tpm->deque)) != NULL) return data;
+
+    do {
+        retry = 0;
+        tpm->seed ^= tpm->seed << 13;
+        tpm->seed ^= tpm->seed >> 17;
+        tpm->seed ^= tpm->seed << 5;
+        for (i = 0, victim = tpm->seed % n; i < n; ++i, victim = victim + 1 < n? victim + 1: 0) {
+            if (&(tpool->deques[victim]) == tpm->deque) continue;
+            if ((rc = mln_thread_pool_deque_steal(&(tpool->deques[victim]), &data)) > 0)
+                return data;
+            if (rc < 0) retry = 1;
+        }
+    } while (retry);
+    return NULL;
+}
+
+static int mln_thread_pool_ws_resource_add(void **data, mln_size_t n)
+{
+    int rc;
+    mln_thread_pool_t *tpool = m_thread_pool_self->pool;
+
+    if ((rc = mln_thread_pool_deque_push(m_thread_pool_self->deque, data, n)) != 0)
+        return rc;
+    __atomic_add_fetch(&(tpool->n_res), n, __ATOMIC_RELAXED);
+
+    /*
+     * Pairs with the fence in ws_thread_launcher, either the sleeper
+     * sees the new resource or we see the sleeper.
+     */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(tpool->sleepers), __ATOMIC_RELAXED)) {
+        m_thread_pool_self->locked = 1;
+        pthread_mutex_lock(&(tpool->mutex));
+        if (n > 1) pthread_cond_broadcast(&(tpool->cond));
+        else pthread_cond_signal(&(tpool->cond));
+        pthread_mutex_unlock(&(tpool->mutex));
+        m_thread_pool_self->locked = 0;
+    }
+    return 0;
+}
+
+/*
+ * All child threads are created at the beginning in work stealing mode.
+ */
+static int mln_thread_pool_ws_start(mln_thread_pool_t *tpool)
+{
+    int rc = 0;
+    mln_u32_t i;
+    pthread_t threadid;
+    mln_thread_pool_member_t *tpm;
+
+    m_thread_pool_self->locked = 1;
+    pthread_mutex_lock(&(tpool->mutex));
+    for (i = 0; i < tpool->max; ++i) {
+        if ((tpm = mln_thread_pool_member_join(tpool, 1)) == NULL) {
+            rc = ENOMEM;
+            break;
+        }
+        tpm->deque = &(tpool->deques[i]);
+        tpm->seed = i + 1;
+        mln_thread_pool_affinity_choose(tpool, tpm);
+        if ((rc = pthread_create(&threadid, &(tpool->attr), ws_thread_launcher, tpm)) != 0) {
+            mln_child_chain_del(&(tpool->child_head), &(tpool->child_tail), tpm);
+            --(tpool->counter);
+            --(tpool->idle);
+            mln_thread_pool_member_free(tpm);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(tpool->mutex));
+    m_thread_pool_self->locked = 0;
+    return rc;
+}
+
+/*
+ * The min child threads are created at the beginning,
+ * so that bursts do not wait for thread creation.
+ */
+static int mln_thread_pool_min_start(mln_thread_pool_t *tpool)
+{
+    int rc = 0;
+    mln_u32_t i;
+
+    m_thread_pool_self->locked = 1;
+    pthread_mutex_lock(&(tpool->mutex));
+    for (i = 0; i < tpool->min; ++i) {
+        if ((rc = mln_thread_pool_child_create(tpool)) != 0) break;
+    }
+    pthread_mutex_unlock(&(tpool->mutex));
+    m_thread_pool_self->locked = 0;
+    return rc;
+}
+
 /*
  * launcher
  */
@@ -334,24 +725,28 @@ int mln_thread_pool_run(struct mln_thread_pool_attr *tpattr)
         return EINVAL;
     }
 
+    if (tpattr->work_stealing && !tpattr->max) return EINVAL;
+    if (!tpattr->work_stealing && tpattr->min > tpattr->max) return EINVAL;
+
     if ((tpool = mln_thread_pool_new(tpattr, &rc)) == NULL) {
         return rc;
     }
-    rc = tpattr->main_process_handler(tpattr->main_data);
-    tpool->quit = 1;
-    while (1) {
-        m_thread_pool_self->locked = 1;
-        pthread_mutex_lock(&(tpool->mutex));
-        if (tpool->counter <= 1) {
-            pthread_mutex_unlock(&(tpool->mutex));
-            m_thread_pool_self->locked = 0;
-            break;
-        }
-        pthread_cond_broadcast(&(tpool->cond));
-        pthread_mutex_unlock(&(tpool->mutex));
-        m_thread_pool_self->locked = 0;
-        usleep(50000);
-    }
+    if (tpool->work_stealing) rc = mln_thread_pool_ws_start(tpool);
+    else rc = mln_thread_pool_min_start(tpool);
+    if (rc == 0)
+        rc = tpattr->main_process_handler(tpattr->main_data);
+
+    /*
+     * The last exiting child thread signals exit_cond.
+     */
+    m_thread_pool_self->locked = 1;
+    pthread_mutex_lock(&(tpool->mutex));
+    __atomic_store_n(&(tpool->quit), 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&(tpool->cond));
+    while (tpool->counter > 1)
+        pthread_cond_wait(&(tpool->exit_cond), &(tpool->mutex));
+    pthread_mutex_unlock(&(tpool->mutex));
+    m_thread_pool_self->locked = 0;
     mln_thread_pool_member_exit(m_thread_pool_self);
     m_thread_pool_self = NULL;
     mln_thread_pool_free(tpool);
@@ -365,11 +760,13 @@ static void *child_thread_launcher(void *arg)
     pthread_cleanup_push(mln_thread_pool_member_exit, arg);
 
     struct timespec ts;
+    mln_u64_t tm = 0, now;
     mln_u32_t timeout = 0;
     mln_thread_pool_member_t *tpm = (mln_thread_pool_member_t *)arg;
     mln_thread_pool_t *tpool = tpm->pool;
 
     m_thread_pool_self = tpm;
+    mln_thread_pool_affinity_bind(tpm);
 
     while (1) {
         tpm->locked = 1;
@@ -382,11 +779,21 @@ again:
         }
         if (tpool->quit) break;
 
-        if (mln_thread_pool_resource_remove() == NULL) {
-            if (timeout) break;
+        if (mln_thread_pool_resource_remove(&tm) == NULL) {
+            /*
+             * Idle threads exit one by one, at most one per cond_timeout,
+             * and the min threads are kept. So the pool shrinks slowly
+             * after a burst, in case another burst comes.
+             */
+            if (timeout && tpool->counter - 1 > tpool->min) {
+                now = mln_thread_pool_now();
+                if (now - tpool->shrink_tm >= tpool->cond_timeout * 1000) {
+                    tpool->shrink_tm = now;
+                    break;
+                }
+            }
 
-            ts.tv_sec = time(NULL) + tpool->cond_timeout / 1000;
-            ts.tv_nsec = (tpool->cond_timeout % 1000) * 1000000;
+            mln_thread_pool_deadline(&ts, tpool->cond_timeout);
             if ((rc = pthread_cond_timedwait(&(tpool->cond), &(tpool->mutex), &ts)) != 0) {
                 if (rc == ETIMEDOUT) {
                     timeout = 1;
@@ -399,6 +806,16 @@ again:
             }
         }
 
+        /*
+         * The resource waited too long and there is still a backlog
+         * without any idle thread, add one more.
+         */
+        if (tpool->latency && tpool->n_res && tpool->idle <= 1 && \
+            tpool->counter < tpool->max+1 && mln_thread_pool_now() - tm > tpool->latency)
+        {
+            (void)mln_thread_pool_child_create(tpool);
+        }
+
         pthread_mutex_unlock(&(tpool->mutex));
         tpm->locked = 0;
         timeout = 0;
@@ -415,6 +832,54 @@ again:
     return (void *)rc;
 }
 
+static void *ws_thread_launcher(void *arg)
+{
+    mln_sptr_t rc = 0;
+    mln_u32_t forked = 0, spin = 0;
+    pthread_cleanup_push(mln_thread_pool_member_exit, arg);
+
+    mln_thread_pool_member_t *tpm = (mln_thread_pool_member_t *)arg;
+    mln_thread_pool_t *tpool = tpm->pool;
+
+    m_thread_pool_self = tpm;
+    mln_thread_pool_affinity_bind(tpm);
+
+    while (!__atomic_load_n(&(tpool->quit), __ATOMIC_ACQUIRE)) {
+        if ((tpm->data = mln_thread_pool_ws_resource_remove(tpm)) != NULL) {
+            __atomic_sub_fetch(&(tpool->n_res), 1, __ATOMIC_RELAXED);
+            spin = 0;
+            if ((rc = tpool->process_handler(tpm->data)) != 0) {
+                mln_log(error, "child process return %d, %s\n", rc, strerror(rc));
+            }
+            tpm->data = NULL;
+            continue;
+        }
+
+        if (++spin < M_THREAD_POOL_SPIN) {
+            if (spin < (M_THREAD_POOL_SPIN >> 1)) mln_cpu_pause();
+            else sched_yield();
+            continue;
+        }
+        spin = 0;
+
+        tpm->locked = 1;
+        pthread_mutex_lock(&(tpool->mutex));
+        __atomic_add_fetch(&(tpool->sleepers), 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&(tpool->quit), __ATOMIC_ACQUIRE) && !mln_thread_pool_ws_has_resource(tpool))
+            pthread_cond_wait(&(tpool->cond), &(tpool->mutex));
+        __atomic_sub_fetch(&(tpool->sleepers), 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&(tpool->mutex));
+        tpm->locked = 0;
+    }
+
+    forked = m_thread_pool_self->forked;
+    pthread_cleanup_pop(1);
+    m_thread_pool_self = NULL;
+    if (forked) exit(rc);
+    return (void *)rc;
+}
+
 void mln_thread_quit(void)
 {
     if (m_thread_pool_self == NULL) {
@@ -424,7 +889,8 @@ void mln_thread_quit(void)
     mln_thread_pool_t *tpool = m_thread_pool_self->pool;
     m_thread_pool_self->locked = 1;
     pthread_mutex_lock(&(tpool->mutex));
-    tpool->quit = 1;
+    __atomic_store_n(&(tpool->quit), 1, __ATOMIC_RELEASE);
+    if (tpool->work_stealing) pthread_cond_broadcast(&(tpool->cond));
     pthread_mutex_unlock(&(tpool->mutex));
     m_thread_pool_self->locked = 0;
 }
@@ -440,13 +906,105 @@ void mln_thread_resource_info(struct mln_thread_pool_info *info)
     m_thread_pool_self->locked = 1;
     pthread_mutex_lock(&(tpool->mutex));
     info->max_num = tpool->max;
-    info->idle_num = tpool->idle;
+    info->idle_num = tpool->work_stealing? __atomic_load_n(&(tpool->sleepers), __ATOMIC_RELAXED): tpool->idle;
     info->cur_num = tpool->counter;
-    info->res_num = tpool->n_res;
+    info->res_num = tpool->work_stealing? __atomic_load_n(&(tpool->n_res), __ATOMIC_RELAXED): tpool->n_res;
     pthread_mutex_unlock(&(tpool->mutex));
     m_thread_pool_self->locked = 0;
 }
 
+/*
+ * future
+ */
+static inline void mln_thread_pool_future_notify(mln_thread_pool_future_t *f)
+{
+    if (mln_notifier_wake(f->wfd) < 0)
+        mln_log(error, "Notify future failed, %s\n", strerror(errno));
+}
+
+mln_thread_pool_future_t *mln_thread_pool_future_new(mln_u32_t n)
+{
+    mln_thread_pool_future_t *f;
+
+    if ((f = (mln_thread_pool_future_t *)malloc(sizeof(mln_thread_pool_future_t))) == NULL)
+        return NULL;
+    if (mln_notifier_init(&(f->rfd), &(f->wfd)) < 0) {
+        free(f);
+        return NULL;
+    }
+    f->pending = n;
+    f->completed = n? 0: 1;
+    pthread_mutex_init(&(f->lock), NULL);
+    pthread_cond_init(&(f->cond), NULL);
+    f->ev = NULL;
+    f->handler = NULL;
+    f->data = NULL;
+    /*an empty group is completed at once*/
+    if (!n) mln_thread_pool_future_notify(f);
+    return f;
+}
+
+void mln_thread_pool_future_free(mln_thread_pool_future_t *f)
+{
+    if (f == NULL) return;
+    if (f->ev != NULL) mln_event_set_fd(f->ev, f->rfd, M_EV_CLR, M_EV_UNLIMITED, NULL, NULL);
+    mln_notifier_destroy(f->rfd, f->wfd);
+    pthread_cond_destroy(&(f->cond));
+    pthread_mutex_destroy(&(f->lock));
+    free(f);
+}
+
+void mln_thread_pool_future_add(mln_thread_pool_future_t *f, mln_u32_t n)
+{
+    __atomic_add_fetch(&(f->pending), n, __ATOMIC_RELAXED);
+}
+
+/*
+ * Only the last one takes the lock, so waiters can not see
+ * the completion and free the future before the notification is done.
+ */
+void mln_thread_pool_future_done(mln_thread_pool_future_t *f)
+{
+    if (__atomic_sub_fetch(&(f->pending), 1, __ATOMIC_ACQ_REL)) return;
+
+    pthread_mutex_lock(&(f->lock));
+    f->completed = 1;
+    pthread_cond_broadcast(&(f->cond));
+    mln_thread_pool_future_notify(f);
+    pthread_mutex_unlock(&(f->lock));
+}
+
+void mln_thread_pool_future_wait(mln_thread_pool_future_t *f)
+{
+    pthread_mutex_lock(&(f->lock));
+    while (!f->completed)
+        pthread_cond_wait(&(f->cond), &(f->lock));
+    pthread_mutex_unlock(&(f->lock));
+}
+
+int mln_thread_pool_future_set_event(mln_thread_pool_future_t *f, \
+                                     mln_event_t *ev, \
+                                     mln_thread_pool_future_handler handler, \
+                                     void *data)
+{
+    f->handler = handler;
+    f->data = data;
+    if (mln_event_set_fd(ev, f->rfd, M_EV_RECV|M_EV_ONESHOT|M_EV_NONBLOCK, M_EV_UNLIMITED, f, mln_thread_pool_future_ev_handler) < 0)
+        return -1;
+    f->ev = ev;
+    return 0;
+}
+
+static void mln_thread_pool_future_ev_handler(mln_event_t *ev, int fd, void *data)
+{
+    mln_thread_pool_future_t *f = (mln_thread_pool_future_t *)data;
+
+    mln_notifier_drain(NULL, fd);
+    /*wait for mln_thread_pool_future_done() to release the lock*/
+    mln_thread_pool_future_wait(f);
+    f->handler(ev, f, f->data);
+}
+
 MLN_CHAIN_FUNC_DEFINE(mln_child, \
                       mln_thread_pool_member_t, \
                       static inline void, \
@@ -28,6 +28,8 @@ static int
 mln_boot_reload(const char *boot_str, const char *alias);
 static int
 mln_boot_stop(const char *boot_str, const char *alias);
+static int
+mln_boot_upgrade(const char *boot_str, const char *alias);
 #endif
 static int mln_sys_core_modify(void);
 static int mln_sys_nofile_modify(void);
@@ -41,7 +43,8 @@ mln_boot_t boot_params[] = {
 {"--version", "-v", mln_boot_version, 0},
 #if !defined(WIN32)
 {"--reload", "-r", mln_boot_reload, 0},
-{"--stop", "-s", mln_boot_stop, 0}
+{"--stop", "-s", mln_boot_stop, 0},
+{"--upgrade", "-u", mln_boot_upgrade, 0}
 #endif
 };
 char mln_core_file_cmd[] = "core_file_size";
@@ -313,6 +316,7 @@ mln_boot_help(const char *boot_str, const char *alias)
     printf("\t--version -v\t\t\tshow version\n");
     printf("\t--reload  -r\t\t\treload configuration\n");
     printf("\t--stop    -s\t\t\tstop melon service.\n");
+    printf("\t--upgrade -u\t\t\tupgrade melon binary without stopping service.\n");
     exit(0);
     return 0;
 }
@@ -376,6 +380,31 @@ mln_boot_stop(const char *boot_str, const char *alias)
 
     exit(0);
 }
+
+static int
+mln_boot_upgrade(const char *boot_str, const char *alias)
+{
+    char buf[1024] = {0};
+    int fd, n, pid;
+
+    snprintf(buf, sizeof(buf)-1, "%s", mln_path_pid());
+    fd = open(buf, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "'melon.pid' not existent.\n");
+        exit(1);
+    }
+    n = read(fd, buf, sizeof(buf)-1);
+    if (n <= 0) {
+        fprintf(stderr, "Invalid file 'melon.pid'.\n");
+        exit(1);
+    }
+    buf[n] = 0;
+
+    pid = atoi(buf);
+    kill(pid, SIGHUP);
+
+    exit(0);
+}
 #endif
 
 /*
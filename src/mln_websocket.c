@@ -12,8 +12,6 @@
 #include "mln_base64.h"
 #include <sys/time.h>
 
-static mln_u64_t mln_websocket_hash_calc(mln_hash_t *h, void *key);
-static int mln_websocket_hash_cmp(mln_hash_t *h, void *key1, void *key2);
 static void mln_websocket_hash_free(void *data);
 static int mln_websocket_match_scan(void *key, void *val, void *data);
 static int mln_websocket_validate_accept(mln_http_t *http, mln_string_t *wskey);
@@ -29,14 +27,17 @@ int mln_websocket_init(mln_websocket_t *ws, mln_http_t *http)
     hattr.pool = mln_http_get_pool(http);
     hattr.pool_alloc = (hash_pool_alloc_handler)mln_alloc_m;
     hattr.pool_free = (hash_pool_free_handler)mln_alloc_free;
-    hattr.hash = mln_websocket_hash_calc;
-    hattr.cmp = mln_websocket_hash_cmp;
+    hattr.hash = NULL;
+    hattr.cmp = NULL;
     hattr.free_key = mln_websocket_hash_free;
     hattr.free_val = mln_websocket_hash_free;
     hattr.len_base = 37;
     hattr.expandable = 0;
     hattr.calc_prime = 0;
     hattr.cache = 0;
+    hattr.progressive = 0;
+    hattr.key_type = M_HASH_KEY_STRING;
+    hattr.nocase = 1;
 
     ws->http = http;
     ws->pool = mln_http_get_pool(http);
@@ -59,24 +60,6 @@ int mln_websocket_init(mln_websocket_t *ws, mln_http_t *http)
     return 0;
 }
 
-static mln_u64_t mln_websocket_hash_calc(mln_hash_t *h, void *key)
-{
-    mln_string_t *k = (mln_string_t *)key;
-    mln_u64_t index = 0;
-    mln_u8ptr_t p, end = k->data + k->len;
-
-    for (p = k->data; p < end; ++p) {
-        index += (*p * 3);
-    }
-
-    return index % h->len;
-}
-
-static int mln_websocket_hash_cmp(mln_hash_t *h, void *key1, void *key2)
-{
-    return !mln_string_strcasecmp((mln_string_t *)key1, (mln_string_t *)key2);
-}
-
 static void mln_websocket_hash_free(void *data)
 {
     if (data == NULL) return;